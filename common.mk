@@ -82,7 +82,8 @@ COMMON_FLAGS              = -Wall -Wextra -Werror \
                             -mlittle-endian -mthumb -mthumb-interwork \
                             -mfloat-abi=hard -mfpu=fpv4-sp-d16 -mcpu=$(MCU) -D$(BOARD) -D$(DEVICE_NAME)
 
-COMMON_LDFLAGS            = -lc -lm -lnosys --specs=nano.specs -Wl,--gc-sections
+COMMON_LDFLAGS            = -lc -lm -lnosys --specs=nano.specs -Wl,--gc-sections \
+                            -Wl,-Map=$(@:.elf=.map)
 LDFLAGS                   = -T $(LD_SCRIPT) $(COMMON_LDFLAGS)
 
 GIT_HASH                  = $(shell git describe --dirty=+ --always)
@@ -100,7 +101,9 @@ RIGHT_FLAG = -DRIGHT -DUSBD_PID=$(DEVICE_RIGHT_PID)
         debug debug-left debug-right \
         release release-left release-right \
         stflash-left stflash-right dfuflash-left dfuflash-right \
-        bootloader \
+        bootloader sim bench replay client-bench tap-hold-test frame-test \
+        memory memory-bootloader memory-debug-left memory-debug-right \
+        memory-release-left memory-release-right \
 		debug-right-full debug-left-full release-right-full release-left-full
 
 help:
@@ -119,6 +122,13 @@ help:
 	@echo "  stflash       Flash the built release-right binary by default"
 	@echo "  dfuflash      Flash the built release-right binary by default"
 	@echo "  size          Show the size of release-right ELF by default"
+	@echo "  memory        Flash and RAM per module of release-right by default"
+	@echo "  sim           Build the firmware core for the host (mock HAL)"
+	@echo "  bench         Build and run the host benchmarks"
+	@echo "  replay        Replay an ADC trace, REPLAY_ARGS=\"-h\" for usage"
+	@echo "  client-bench  Run the protocol client against the device emulator"
+	@echo "  tap-hold-test Check the tap-hold resolver against scripted events"
+	@echo "  frame-test    Check the split link framing round trip and resync"
 
 ###############################################################################
 # Aggregate Targets
@@ -291,6 +301,99 @@ $(RELEASE_LEFT_FULL_BIN): $(RELEASE_LEFT_FULL_HEX)
 	srec_cat $< -Intel -o $@ -Binary
 
 
+###############################################################################
+# Host Simulation
+###############################################################################
+# Firmware core built for the development machine against the mock HAL in
+# hw/host. Right (primary) half, so the split link is received. Every program
+# in hw/host/app is linked against it on its own.
+HOST_CC                  ?= cc
+
+SIM_HW_DIR               = $(ROOT_DIR)/hw/host
+SIM_APP_DIR              = $(SIM_HW_DIR)/app
+SIM_DIR                  = $(BUILD_DIR)/sim/device
+SIM_BENCH_ELF            = $(BUILD_OUTPUTS_DIR)/$(PROJECT_NAME)-bench
+SIM_REPLAY_ELF           = $(BUILD_OUTPUTS_DIR)/$(PROJECT_NAME)-replay
+SIM_EMULATOR_ELF         = $(BUILD_OUTPUTS_DIR)/$(PROJECT_NAME)-emulator
+SIM_CLIENT_ELF           = $(BUILD_OUTPUTS_DIR)/$(PROJECT_NAME)-client
+SIM_TAP_HOLD_TEST_ELF    = $(BUILD_OUTPUTS_DIR)/$(PROJECT_NAME)-tap_hold_test
+SIM_FRAME_TEST_ELF       = $(BUILD_OUTPUTS_DIR)/$(PROJECT_NAME)-frame_test
+SIM_APPS                 = $(SIM_BENCH_ELF) $(SIM_REPLAY_ELF) \
+                           $(SIM_EMULATOR_ELF) $(SIM_TAP_HOLD_TEST_ELF) \
+                           $(SIM_FRAME_TEST_ELF)
+
+REPLAY_ARGS              ?= synthetic
+
+SIM_COMMON_SRCS          = adc.c capture.c combo.c dks.c eeprom.c frame.c \
+                           fw_update_handler.c gamepad.c interface_handler.c \
+                           keyboard.c macro.c mux.c postmortem.c predict.c \
+                           socd.c sof_sync.c split_link.c tap_hold.c \
+                           telemetry.c transport.c transport_loopback.c usb.c \
+                           usb/usbd_core.c usb/usbd_ctlreq.c usb/usbd_desc.c \
+                           usb/usbd_hid.c usb/usbd_ioreq.c watchdog.c
+
+SIM_SRCS                 = $(addprefix $(COMMON_SRC_DIR)/,$(SIM_COMMON_SRCS))
+SIM_SRCS                += $(shell find $(DEVICE_SRC_DIR) -type f -name '*.c')
+SIM_SRCS                += $(shell find $(SIM_HW_DIR)/src -type f -name '*.c')
+
+SIM_OBJS                 = $(SIM_SRCS:%.c=$(SIM_DIR)/%.o)
+
+# The client is host only, none of the firmware is linked in
+SIM_CLIENT_OBJS          = $(SIM_DIR)/$(SIM_HW_DIR)/client/ykb_client.o \
+                           $(SIM_DIR)/$(SIM_APP_DIR)/client.o
+
+SIM_HEADERS              = $(HEADERS)
+SIM_HEADERS             += $(shell find $(SIM_HW_DIR)/include -type f -name '*.h')
+SIM_HEADERS             += $(shell find $(SIM_HW_DIR)/client -type f -name '*.h')
+
+# Host stand-ins for the CMSIS headers go first
+SIM_INCLUDES             = -I$(SIM_HW_DIR)/include \
+                           -I$(SIM_HW_DIR)/client \
+                           -I$(COMMON_INC_DIR) \
+                           -I$(DEVICE_INC_DIR) \
+                           -I$(HAL_INC_DIR) \
+                           -I$(CONFIG_INC_DIR) \
+                           -I$(YKB_PROTOCOL_INC_DIR)
+
+# Flash addresses are 32 bit, the fake flash is mapped at the same address
+SIM_FLAGS                = -Wall -Wextra -Werror -std=gnu2x -O2 \
+                           -Wno-int-to-pointer-cast -Wno-pointer-to-int-cast \
+                           -fmacro-prefix-map=$(abspath $(ROOT_DIR))=. \
+                           -D_GNU_SOURCE -DSIM -D$(BOARD) -D$(DEVICE_NAME) \
+                           -DGIT_HASH=\"$(GIT_HASH)\" $(RIGHT_FLAG)
+
+sim: $(SIM_APPS) $(SIM_CLIENT_ELF)
+
+bench: $(SIM_BENCH_ELF)
+	@$(SIM_BENCH_ELF)
+
+replay: $(SIM_REPLAY_ELF)
+	@$(SIM_REPLAY_ELF) $(REPLAY_ARGS)
+
+client-bench: $(SIM_CLIENT_ELF) $(SIM_EMULATOR_ELF)
+	@$(SIM_CLIENT_ELF) -e $(SIM_EMULATOR_ELF) bench
+
+tap-hold-test: $(SIM_TAP_HOLD_TEST_ELF)
+	@$(SIM_TAP_HOLD_TEST_ELF)
+
+frame-test: $(SIM_FRAME_TEST_ELF)
+	@$(SIM_FRAME_TEST_ELF)
+
+$(SIM_DIR)/%.o: %.c $(SIM_HEADERS)
+	@mkdir -p $(dir $@)
+	$(HOST_CC) $(SIM_FLAGS) $(SIM_INCLUDES) -c $< -o $@
+
+$(SIM_APPS): $(BUILD_OUTPUTS_DIR)/$(PROJECT_NAME)-%: \
+             $(SIM_OBJS) $(SIM_DIR)/$(SIM_APP_DIR)/%.o
+	@mkdir -p $(dir $@)
+	@echo "Linking Simulation $*..."
+	$(HOST_CC) $(SIM_FLAGS) $^ -o $@
+
+$(SIM_CLIENT_ELF): $(SIM_CLIENT_OBJS)
+	@mkdir -p $(dir $@)
+	@echo "Linking Client..."
+	$(HOST_CC) $(SIM_FLAGS) $^ -o $@
+
 ###############################################################################
 # Size
 ###############################################################################
@@ -310,6 +413,30 @@ size-release-left: $(RELEASE_LEFT_ELF)
 size-release-right: $(RELEASE_RIGHT_ELF)
 	@$(SIZE) $<
 
+###############################################################################
+# Memory
+###############################################################################
+# Breakdown of the linker map per module, the link itself fails when the RAM
+# budget of the linker script is exceeded
+MEMORY_REPORT = $(HW_DIR)/ld/memory_report.awk
+
+memory: memory-release-right
+
+memory-bootloader: $(RELEASE_BOOTLOADER_ELF)
+	@awk -f $(MEMORY_REPORT) $(<:.elf=.map)
+
+memory-debug-left: $(DEBUG_LEFT_ELF)
+	@awk -f $(MEMORY_REPORT) $(<:.elf=.map)
+
+memory-debug-right: $(DEBUG_RIGHT_ELF)
+	@awk -f $(MEMORY_REPORT) $(<:.elf=.map)
+
+memory-release-left: $(RELEASE_LEFT_ELF)
+	@awk -f $(MEMORY_REPORT) $(<:.elf=.map)
+
+memory-release-right: $(RELEASE_RIGHT_ELF)
+	@awk -f $(MEMORY_REPORT) $(<:.elf=.map)
+
 ###############################################################################
 # Clean
 ###############################################################################
@@ -0,0 +1,75 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "hal_err.h"
+#include "keyboard.h"
+
+#include <stdint.h>
+
+// Raw ADC traces for tuning. Once armed, every scan's values go into a RAM
+// ring. When the trigger key crosses the trigger level the ring keeps
+// `post_frames` more frames and freezes, so it holds the frames leading up to
+// the trigger as well. The frozen ring is read out with `capture_read`.
+
+#define ERR_CAPTURE_ARM_BADKEY -1601
+#define ERR_CAPTURE_ARM_BADTRIGGER -1602
+
+// 76 bytes each
+#ifndef CAPTURE_FRAME_COUNT
+#define CAPTURE_FRAME_COUNT 128U
+#endif // CAPTURE_FRAME_COUNT
+
+typedef enum {
+    CAPTURE_STATE_IDLE = 0U,
+    // Recording, waiting for the trigger
+    CAPTURE_STATE_ARMED = 1U,
+    // Recording the frames after the trigger
+    CAPTURE_STATE_TRIGGERED = 2U,
+    // Frozen, ready to be read
+    CAPTURE_STATE_DONE = 3U,
+} capture_state;
+
+typedef enum {
+    // Stops capturing
+    CAPTURE_TRIGGER_NONE = 0U,
+    // On the first frame
+    CAPTURE_TRIGGER_IMMEDIATE = 1U,
+    CAPTURE_TRIGGER_RISING = 2U,
+    CAPTURE_TRIGGER_FALLING = 3U,
+    CAPTURE_TRIGGER_BOTH = 4U,
+} capture_trigger;
+
+typedef struct {
+
+    // systick_get_us at the end of the scan
+    uint32_t time;
+    uint16_t values[KB_KEY_COUNT];
+
+} capture_frame_t;
+
+typedef struct {
+
+    capture_state state;
+
+    // Frames in the ring, oldest first when read
+    uint16_t frame_count;
+    // Position of the trigger frame among them
+    uint16_t trigger_frame;
+
+} capture_status_t;
+
+// Starts over, frames before the arming are dropped. `post_frames` is capped
+// so at least the trigger frame fits. Idle until the next scan applies it.
+hal_err capture_arm(uint8_t key_index, uint16_t level, capture_trigger trigger,
+                    uint16_t post_frames);
+
+// Once per scan, right after the values are updated
+void capture_frame(const uint16_t *values);
+
+capture_status_t capture_get_status();
+
+// `size` bytes of the frames starting at byte `offset`, oldest frame first.
+// Only while the ring is frozen, returns the amount copied.
+uint16_t capture_read(uint32_t offset, uint8_t *buffer, uint16_t size);
+
+#endif // CAPTURE_H
@@ -0,0 +1,46 @@
+#ifndef COMBO_H
+#define COMBO_H
+
+#include "keyboard.h"
+
+#include <stdint.h>
+
+// Combos are reported as virtual keys after the physical ones
+#ifndef KB_COMBO_MAX
+#define KB_COMBO_MAX 16U
+#endif // KB_COMBO_MAX
+
+// Combo keys have to be pressed within this time, otherwise they are pressed
+// as separate keys
+#ifndef KB_COMBO_TERM
+#define KB_COMBO_TERM 30U // ms
+#endif // KB_COMBO_TERM
+
+typedef struct {
+
+    kb_key_set_t keys;
+    uint16_t action;
+
+} kb_combo_t;
+
+// Key masks are packed at compile time, so matching is a couple of word-wide
+// AND and compare operations
+#define KB_COMBO2(combo_action, key1, key2)                                    \
+    {.keys = KB_KEY_SET(key1, key2, KB_KEY_NONE, KB_KEY_NONE),                 \
+     .action = (combo_action)}
+#define KB_COMBO3(combo_action, key1, key2, key3)                              \
+    {.keys = KB_KEY_SET(key1, key2, key3, KB_KEY_NONE),                        \
+     .action = (combo_action)}
+#define KB_COMBO4(combo_action, key1, key2, key3, key4)                        \
+    {.keys = KB_KEY_SET(key1, key2, key3, key4), .action = (combo_action)}
+
+void combo_init(const kb_combo_t *combos, uint8_t amount);
+
+// Action of the combo with virtual key index `KB_TOTAL_KEY_COUNT + combo`
+uint16_t combo_get_action(uint8_t combo);
+
+// Turns the pressed keys of the scan into key events. Keys which are part of
+// a combo are held back until the combo is either matched or broken.
+void combo_scan(kb_key_set_t pressed, uint32_t now);
+
+#endif // COMBO_H
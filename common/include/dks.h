@@ -0,0 +1,62 @@
+#ifndef DKS_H
+#define DKS_H
+
+#include "settings.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Dynamic keystroke: a key emits a different action at every depth point of
+// one press cycle instead of its mapping.
+#define KB_DKS_POINTS 4U
+
+// Keys with DKS per profile
+#ifndef KB_DKS_MAX
+#define KB_DKS_MAX 8U
+#endif // KB_DKS_MAX
+
+// Points in the order they are reached within a press cycle. Bottom out can
+// repeat after release from bottom as long as the key isn't fully released.
+typedef enum {
+    DKS_POINT_PRESS = 0U,               // Going down
+    DKS_POINT_BOTTOM_OUT = 1U,          // Going down
+    DKS_POINT_RELEASE_FROM_BOTTOM = 2U, // Going up
+    DKS_POINT_RELEASE = 3U,             // Going up, ends the cycle
+} dks_point;
+
+typedef struct __attribute__((__packed__)) {
+
+    uint8_t key_index;
+
+    // % of travel for each `dks_point`
+    uint8_t depths[KB_DKS_POINTS];
+
+    // Bit per point: its action is held until DKS_POINT_RELEASE, otherwise
+    // it's pressed for a single report
+    uint8_t hold;
+
+    // KEY_NOKEY for points without an action
+    uint16_t actions[KB_DKS_POINTS];
+
+} kb_dks_t;
+
+typedef void (*dks_process_fp)(uint16_t action);
+
+// Depths have to keep the points in their order within a press cycle
+bool dks_valid(const kb_dks_t *dks);
+
+// Converts the depths into raw ADC breakpoints with the calibration of each
+// key, has to be called again after the thresholds change. `dks` has to stay
+// valid while it's in use.
+void dks_compile(const kb_dks_t *dks, uint8_t amount,
+                 const uint16_t *min_thresholds,
+                 const uint16_t *max_thresholds);
+
+// Detects the points crossed since the last scan, `values` are the ADC values
+// of all keys. Integer compares only.
+void dks_scan(const uint16_t *values);
+
+// Processes the actions which are active for the current report
+void dks_task(dks_process_fp process);
+
+#endif // DKS_H
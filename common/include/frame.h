@@ -0,0 +1,52 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Packet framing for byte streams (the split link UART). The payload and its
+// CRC16 (little endian) are COBS encoded, so the frame contains no zeros and
+// is terminated by a single zero. Receiver resynchronizes on the next zero
+// after any corruption. Nothing here depends on the HAL.
+
+#define FRAME_DELIMITER 0x00U
+
+#ifndef FRAME_PAYLOAD_MAX
+#define FRAME_PAYLOAD_MAX 128U
+#endif // FRAME_PAYLOAD_MAX
+
+_Static_assert(FRAME_PAYLOAD_MAX + 2U < 254U,
+               "COBS overhead of a frame is assumed to be a single byte");
+
+// Code byte + payload + CRC + delimiter
+#define FRAME_ENCODED_MAX (1U + FRAME_PAYLOAD_MAX + 2U + 1U)
+
+typedef enum {
+    FRAME_DECODE_INCOMPLETE = 0U,
+    FRAME_DECODE_OK = 1U,
+    // Malformed, too long or bad CRC. The frame is dropped.
+    FRAME_DECODE_ERROR = 2U,
+} frame_decode_result;
+
+typedef struct {
+
+    // Encoded bytes, decoded in place once the delimiter arrives
+    uint8_t buffer[FRAME_ENCODED_MAX];
+    uint8_t length;
+    bool overflow;
+
+} frame_decoder_t;
+
+// Returns the encoded size including the delimiter, `out` has to hold
+// FRAME_ENCODED_MAX bytes. 0 if the payload doesn't fit into a frame.
+size_t frame_encode(const uint8_t *payload, size_t length, uint8_t *out);
+
+void frame_decoder_reset(frame_decoder_t *decoder);
+
+// Feeds one received byte. On FRAME_DECODE_OK the payload is at
+// `decoder->buffer`, valid until the next call.
+frame_decode_result frame_decoder_push(frame_decoder_t *decoder, uint8_t byte,
+                                       size_t *payload_length);
+
+#endif // FRAME_H
@@ -0,0 +1,63 @@
+#ifndef GAMEPAD_H
+#define GAMEPAD_H
+
+#include "settings.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Axes of the gamepad report in report order, each one is driven by the
+// travel of up to two keys
+typedef enum {
+    GAMEPAD_AXIS_X = 0U,
+    GAMEPAD_AXIS_Y = 1U,
+    GAMEPAD_AXIS_Z = 2U,
+    GAMEPAD_AXIS_RX = 3U,
+    GAMEPAD_AXIS_RY = 4U,
+    GAMEPAD_AXIS_RZ = 5U,
+    GAMEPAD_AXIS_COUNT,
+} gamepad_axis;
+
+#define GAMEPAD_AXIS_MAX 32767
+
+// Fractional bits of the per-key scale factors
+#define GAMEPAD_SCALE_SHIFT 16U
+
+typedef struct {
+
+    gamepad_axis axis;
+
+    // Key indices in scan order, KB_KEY_COUNT if the direction is unused
+    uint8_t negative_key;
+    uint8_t positive_key;
+
+} kb_gamepad_axis_t;
+
+#define KB_GAMEPAD_AXIS(gamepad_axis, negative, positive)                      \
+    {.axis = (gamepad_axis),                                                   \
+     .negative_key = (negative),                                               \
+     .positive_key = (positive)}
+
+typedef struct {
+
+    int16_t axes[GAMEPAD_AXIS_COUNT];
+
+} gamepad_report_t;
+
+void gamepad_init(const kb_gamepad_axis_t *axes, uint8_t amount);
+
+// Precomputes the fixed point factor which scales the travel of every key to
+// 0..GAMEPAD_AXIS_MAX, has to be called again after the thresholds change
+void gamepad_compile(const uint16_t *min_thresholds,
+                     const uint16_t *max_thresholds);
+
+// Builds the report from the ADC values of one scan. Returns true if it
+// differs from the last report which was sent.
+bool gamepad_update(const uint16_t *values);
+
+const gamepad_report_t *gamepad_get_report();
+
+// Report was accepted by the transport
+void gamepad_report_sent();
+
+#endif // GAMEPAD_H
@@ -1,22 +1,96 @@
 #ifndef INTERFACE_HANDLER_H
 #define INTERFACE_HANDLER_H
 
+#include "hal_err.h"
+#include "transport.h"
 #include "ykb_protocol.h"
 
 #include <stdint.h>
 
+#define ERR_INTERFACE_TX_BUSY -1401
+#define ERR_INTERFACE_TX_FAIL -1402
+
+// Request code for everything not covered by the base ykb protocol requests.
+// `data[0]` selects the extended request, replies start with the same byte.
+#define YKB_EXTENDED_REQUEST 0xA0
+
 typedef enum {
-    COMMUNICATION_SOURCE_USB,
-    COMMUNICATION_SOURCE_BT,
-} communication_source;
+    // Reply: hash of every config section (uint32_t each)
+    YKB_EXT_GET_CONFIG_HASHES = 0x00U,
+    // Request: host's hash of every config section
+    // Reply: bitmask of changed sections, current hashes, then the data of
+    // every changed section in section order. Burst like other long replies,
+    // the packets the transport has no room for follow from the main loop, so
+    // a single request brings the host up to date.
+    YKB_EXT_GET_CONFIG_IF_CHANGED = 0x01U,
+    // Request: amount of updates, then `kb_key_field_update_t` for each one
+    // Reply: amount of applied updates (0 if rejected)
+    YKB_EXT_SET_KEY_FIELDS = 0x02U,
+    // Reply: profile count, active profile, default profile
+    YKB_EXT_GET_PROFILE = 0x03U,
+    // Request: profile, 1 to also make it the default one
+    // Reply: 1 if switched, then same as YKB_EXT_GET_PROFILE
+    YKB_EXT_SET_PROFILE = 0x04U,
+    // Request: `macro_step_t`s after `data[0]`, split into packets like the
+    // set mappings request (last packet is shorter than a full one)
+    // Reply: 1 if applied (always 0 before the last packet)
+    YKB_EXT_SET_MACROS = 0x05U,
+    // Request: `kb_dks_t` of a single key in the active profile
+    // Reply: 1 if applied
+    YKB_EXT_SET_DKS = 0x06U,
+    // Request: 1 to clear the histogram after it's read
+    // Reply: 1 if synchronized to SOF, then `sof_sync_stats_t` fields (LE):
+    // IN offset, scan duration, scan phase, bucket width (uint16_t each),
+    // bucket count (uint8_t), histogram (uint32_t each)
+    YKB_EXT_GET_SCAN_TIMING = 0x07U,
+    // Request: key, level (uint16_t), `capture_trigger`, frames kept after
+    // the trigger (uint16_t), trigger 0 stops the capture
+    // Reply: 1 if applied
+    YKB_EXT_CAPTURE_ARM = 0x08U,
+    // Reply: `capture_state`, key count, frame size (uint8_t each), frame
+    // count, trigger frame, ring capacity (uint16_t each)
+    YKB_EXT_CAPTURE_STATUS = 0x09U,
+    // Reply: the frozen `capture_frame_t`s oldest first, `data[0]` of every
+    // packet is the request byte and the rest continues the frames. Burst
+    // like other long replies, empty if nothing is captured.
+    YKB_EXT_CAPTURE_READ = 0x0AU,
+    // Request: 1 to restart the scan time min, max and average after they
+    // are read
+    // Reply: `telemetry_snapshot_t` fields (uint32_t each, LE). Dropped
+    // reports were given up on, refused ones found the endpoint busy and
+    // were tried again.
+    YKB_EXT_GET_TELEMETRY = 0x0BU,
+    // Reply: 1 if the watchdog is enabled, then `watchdog_report_t` fields
+    // (uint32_t each, LE): reset flags, overruns, last overrun and its time,
+    // last feed time of the previous boot, then overruns, last overrun and
+    // its time of this boot
+    YKB_EXT_GET_RESET_INFO = 0x0CU,
+    // Request: 1 to drop the record after this reply, once every packet of
+    // it arrived
+    // Reply: 1 if the previous boot left a record, then `postmortem_record_t`
+    // (LE, 0 if there is none). Burst like other long replies.
+    YKB_EXT_GET_POSTMORTEM = 0x0DU,
+    // Reply: `stack_usage_t` fields (uint32_t each, LE): .data and .bss size,
+    // their budget, stack budget, painted stack size, stack high-water mark
+    YKB_EXT_GET_MEMORY_USAGE = 0x0EU,
+} ykb_ext_request;
 
-void interface_handle_new_packet(communication_source source, uint8_t *packet,
-                                 uint8_t packet_length);
+// Receive callback of every transport the protocol is served on (see
+// `transport_register`). Replies go back over the same transport.
+void interface_handle_new_packet(transport_t *transport, const uint8_t *packet,
+                                 uint16_t packet_length);
 
 void interface_send_error(uint8_t request_error, uint8_t error_description);
 
-void interface_handle_get_values_response(communication_source source,
-                                          ykb_protocol_t *packet,
-                                          uint16_t *values);
+// Main loop, sends the rest of a long reply the transport had no room for
+void interface_handler_task();
+
+// Replies longer than one packet are sent as a burst starting from
+// `packet->packet_number` up to the last packet. If the transport runs out of
+// room, `ERR_INTERFACE_TX_BUSY` is returned and `packet->packet_number` points
+// to the first packet which was not sent, so the call can be repeated later.
+hal_err interface_handle_get_values_response(transport_t *transport,
+                                             ykb_protocol_t *packet,
+                                             uint16_t *values);
 
 #endif // INTERFACE_HANDLER_H
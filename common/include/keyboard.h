@@ -1,16 +1,134 @@
 #ifndef KEYBOARD_H
 #define KEYBOARD_H
 
+#include "dks.h"
 #include "hal_adc.h"
 #include "hal_err.h"
 #include "interface_handler.h"
+#include "macro.h"
 #include "settings.h"
+#include "tap_hold.h"
 #include "ykb_protocol.h"
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #define HID_BUFFER_SIZE 8
 
+// Keys of the other half of a split keyboard (see split_link.h), handled like
+// the local ones with the indices after them
+#ifndef KB_REMOTE_KEY_COUNT
+#define KB_REMOTE_KEY_COUNT 0U
+#endif // KB_REMOTE_KEY_COUNT
+
+#define KB_REMOTE_KEY(index) (KB_KEY_COUNT + (index))
+
+// Keys with a mapping, local then remote
+#define KB_TOTAL_KEY_COUNT (KB_KEY_COUNT + KB_REMOTE_KEY_COUNT)
+
+// Bit per key of one half, in scan order
+typedef uint64_t kb_key_mask_t;
+#define KB_KEY_BIT(index) ((kb_key_mask_t)1U << (index))
+
+_Static_assert(KB_KEY_COUNT <= 64, "Keys don't fit into kb_key_mask_t");
+
+// Bit per key of both halves, the indices of KB_TOTAL_KEY_COUNT
+#define KB_KEY_SET_WORDS 2U
+
+typedef struct {
+
+    uint64_t words[KB_KEY_SET_WORDS];
+
+} kb_key_set_t;
+
+_Static_assert(KB_TOTAL_KEY_COUNT <= 64U * KB_KEY_SET_WORDS,
+               "Keys don't fit into kb_key_set_t");
+
+// Fills no bit, for the unused keys of KB_KEY_SET
+#define KB_KEY_NONE 0xFFU
+
+#define KB_KEY_SET_WORD(word, key)                                             \
+    ((key) / 64U == (word) ? (uint64_t)1U << ((key) % 64U) : 0U)
+#define KB_KEY_SET_WORD4(word, key1, key2, key3, key4)                         \
+    (KB_KEY_SET_WORD(word, key1) | KB_KEY_SET_WORD(word, key2) |              \
+     KB_KEY_SET_WORD(word, key3) | KB_KEY_SET_WORD(word, key4))
+
+// Packed at compile time, for static tables
+#define KB_KEY_SET(key1, key2, key3, key4)                                     \
+    {.words = {KB_KEY_SET_WORD4(0U, key1, key2, key3, key4),                   \
+               KB_KEY_SET_WORD4(1U, key1, key2, key3, key4)}}
+
+static inline bool kb_key_set_has(kb_key_set_t set, uint8_t key) {
+    return (set.words[key / 64U] >> (key % 64U)) & 1U;
+}
+
+static inline void kb_key_set_add(kb_key_set_t *set, uint8_t key) {
+    set->words[key / 64U] |= (uint64_t)1U << (key % 64U);
+}
+
+static inline void kb_key_set_remove(kb_key_set_t *set, uint8_t key) {
+    set->words[key / 64U] &= ~((uint64_t)1U << (key % 64U));
+}
+
+static inline bool kb_key_set_empty(kb_key_set_t set) {
+    return !(set.words[0] | set.words[1]);
+}
+
+// At least two keys
+static inline bool kb_key_set_several(kb_key_set_t set) {
+    return (set.words[0] & (set.words[0] - 1U)) ||
+           (set.words[1] & (set.words[1] - 1U)) ||
+           (set.words[0] && set.words[1]);
+}
+
+static inline bool kb_key_set_equal(kb_key_set_t a, kb_key_set_t b) {
+    return a.words[0] == b.words[0] && a.words[1] == b.words[1];
+}
+
+static inline kb_key_set_t kb_key_set_and(kb_key_set_t a, kb_key_set_t b) {
+    return (kb_key_set_t){{a.words[0] & b.words[0], a.words[1] & b.words[1]}};
+}
+
+static inline kb_key_set_t kb_key_set_or(kb_key_set_t a, kb_key_set_t b) {
+    return (kb_key_set_t){{a.words[0] | b.words[0], a.words[1] | b.words[1]}};
+}
+
+// `a` without the keys of `b`
+static inline kb_key_set_t kb_key_set_and_not(kb_key_set_t a, kb_key_set_t b) {
+    return (kb_key_set_t){{a.words[0] & ~b.words[0], a.words[1] & ~b.words[1]}};
+}
+
+// Lowest key, `set` mustn't be empty
+static inline uint8_t kb_key_set_first(kb_key_set_t set) {
+    if (set.words[0]) {
+        return __builtin_ctzll(set.words[0]);
+    }
+    return 64U + __builtin_ctzll(set.words[1]);
+}
+
+// Removes the lowest key and returns it, `set` mustn't be empty
+static inline uint8_t kb_key_set_pop(kb_key_set_t *set) {
+    uint8_t key = kb_key_set_first(*set);
+    kb_key_set_remove(set, key);
+    return key;
+}
+
+#ifndef KB_MOUSE_MOVE_STEP
+#define KB_MOUSE_MOVE_STEP 8
+#endif // KB_MOUSE_MOVE_STEP
+
+// ms between relative mouse reports while a movement key is held
+#ifndef KB_MOUSE_MOVE_INTERVAL
+#define KB_MOUSE_MOVE_INTERVAL 10U
+#endif // KB_MOUSE_MOVE_INTERVAL
+
+#define KB_MAPPINGS_SIZE (KB_TOTAL_KEY_COUNT * sizeof(uint16_t))
+
+// key_thresholds + min_thresholds + max_thresholds
+#define KB_THRESHOLDS_SIZE                                                     \
+    (KB_KEY_COUNT * (sizeof(uint8_t) + sizeof(uint16_t) * 2))
+
 // TYPES
 
 #ifdef __GNUC__
@@ -23,7 +141,8 @@
 
 // Default mode: default behavior of keyboard.
 //
-// Race mode: only the key which is pressed the most is activated.
+// Race mode: only the key which is pressed the most is activated. SOCD groups
+// (see socd.h) do the same for a couple of keys only.
 typedef enum PACKED {
     KB_MODE_NORMAL = 0U,
     KB_MODE_RACE = 1U,
@@ -35,8 +154,82 @@ typedef struct PACKED {
     adc_sampling_time adc_sampling_time;
     kb_mode mode;
 
+    uint16_t tapping_term;   // ms
+    uint8_t tap_hold_policy; // tap_hold_policy
+
+    // Actuate keys early from their velocity (see predict.h), normal mode only
+    uint8_t predictive_actuation;
+
 } kb_settings_t;
 
+// Persisted configuration sections. Each one keeps its own hash, so the host
+// is able to tell which of them changed since it last synced.
+typedef enum {
+    KB_CONFIG_SECTION_SETTINGS = 0U,
+    KB_CONFIG_SECTION_MAPPINGS = 1U,
+    KB_CONFIG_SECTION_THRESHOLDS = 2U,
+    KB_CONFIG_SECTION_LAYERS = 3U,
+    KB_CONFIG_SECTION_MACROS = 4U, // Shared by all profiles
+    KB_CONFIG_SECTION_DKS = 5U,
+    KB_CONFIG_SECTION_COUNT,
+} kb_config_section;
+
+// Layer 0 is the base layer (`mappings`), higher layers take precedence
+#ifndef KB_LAYER_COUNT
+#define KB_LAYER_COUNT 4U
+#endif // KB_LAYER_COUNT
+
+#ifndef KB_LAYER_ENTRIES_MAX
+#define KB_LAYER_ENTRIES_MAX 48U
+#endif // KB_LAYER_ENTRIES_MAX
+
+// Keys of the layers above the base one are stored sparsely, missing ones are
+// transparent
+typedef struct PACKED {
+
+    uint8_t layer;
+    uint8_t key_index;
+    uint16_t key_code;
+
+} kb_layer_entry_t;
+
+// layer_entry_count + layer_entries
+#define KB_LAYERS_SIZE                                                         \
+    (sizeof(uint8_t) + sizeof(kb_layer_entry_t) * KB_LAYER_ENTRIES_MAX)
+
+// dks_count + dks
+#define KB_DKS_SIZE (sizeof(uint8_t) + sizeof(kb_dks_t) * KB_DKS_MAX)
+
+#define KB_CONFIG_SECTIONS_MAX_SIZE                                            \
+    (sizeof(kb_settings_t) + KB_MAPPINGS_SIZE + KB_THRESHOLDS_SIZE +          \
+     KB_LAYERS_SIZE + KB_MACROS_SIZE + KB_DKS_SIZE)
+
+#ifndef KB_PROFILE_COUNT
+#define KB_PROFILE_COUNT 4U
+#endif // KB_PROFILE_COUNT
+
+// Persisted part of `kb_state_t`. All profiles are cached in RAM, the active
+// one is copied into `kb_state` so the hot path doesn't change on switching.
+typedef struct PACKED {
+
+    kb_settings_t settings;
+
+    uint8_t key_thresholds[KB_KEY_COUNT];
+
+    uint16_t min_thresholds[KB_KEY_COUNT];
+    uint16_t max_thresholds[KB_KEY_COUNT];
+
+    uint16_t mappings[KB_TOTAL_KEY_COUNT];
+
+    uint8_t layer_entry_count;
+    kb_layer_entry_t layer_entries[KB_LAYER_ENTRIES_MAX];
+
+    // DKS keys ignore their mappings
+    uint8_t dks_count;
+    kb_dks_t dks[KB_DKS_MAX];
+
+} kb_profile_t;
+
 typedef struct {
 
     kb_settings_t settings;
@@ -46,12 +239,37 @@ typedef struct {
     uint16_t min_thresholds[KB_KEY_COUNT];
     uint16_t max_thresholds[KB_KEY_COUNT];
 
-    uint8_t mappings[KB_KEY_COUNT];
+    // Thresholds of the remote keys are applied by the other half
+    uint16_t mappings[KB_TOTAL_KEY_COUNT];
+
+    // `mappings` with the active layers applied, rebuilt on every layer change
+    uint16_t keymap[KB_TOTAL_KEY_COUNT];
 
     uint16_t current_values[KB_KEY_COUNT];
 
 } kb_state_t;
 
+// Single per-key field which can be changed without sending the whole array.
+// Thresholds only exist for the local keys, mappings for the remote ones too.
+typedef enum PACKED {
+    KB_KEY_FIELD_THRESHOLD = 0U,
+    KB_KEY_FIELD_MIN_THRESHOLD = 1U,
+    KB_KEY_FIELD_MAX_THRESHOLD = 2U,
+    KB_KEY_FIELD_MAPPING = 3U,
+    // Mapping on layer 1, next ones are for the layers above it.
+    // KEY_TRANSPARENT removes the key from the layer.
+    KB_KEY_FIELD_LAYER_MAPPING = 4U,
+    KB_KEY_FIELD_COUNT = KB_KEY_FIELD_LAYER_MAPPING + KB_LAYER_COUNT - 1U,
+} kb_key_field;
+
+typedef struct PACKED {
+
+    uint8_t key_index;
+    kb_key_field field;
+    uint16_t value;
+
+} kb_key_field_update_t;
+
 // FUNCTIONS
 
 hal_err kb_init();
@@ -59,22 +277,55 @@ hal_err kb_init();
 void kb_poll_normal();
 void kb_poll_race();
 
-void kb_process_key(uint8_t key_code);
+// Dispatches the action (see keys.h) to the handler of its type
+void kb_process_key(uint16_t action);
+
+// Called by the scan with all pressed keys and `kb_state.current_values` of
+// the same scan. The remote keys are added, SOCD groups are resolved, then
+// state changes are turned into timestamped events. Actions of pressed keys
+// are latched until they are released.
+void kb_update_keys(kb_key_mask_t pressed);
 
 bool kb_load_state_from_eeprom();
 void kb_super_init();
 
 void kb_get_settings(uint8_t *buffer);
 void kb_get_mappings(uint8_t *buffer);
-void kb_request_values(communication_source source, ykb_protocol_t *protocol);
+void kb_request_values(transport_t *transport, ykb_protocol_t *protocol);
 void kb_get_thresholds(uint8_t *buffer);
 
 void kb_set_settings(kb_settings_t *new_settings);
-void kb_set_mappings(uint8_t *new_mappings);
+void kb_set_mappings(uint16_t *new_mappings);
 void kb_set_thresholds(uint8_t *new_thresholds);
 
 void kb_calibrate(uint16_t *min_thresholds, uint16_t *max_thresholds);
 
+// Applies the updates in place and persists only them. Nothing is changed if
+// any of the updates is invalid.
+bool kb_set_key_fields(const kb_key_field_update_t *updates, uint8_t amount);
+
+// `new_macros` are `macro_step_t`s, rest of the macro storage is cleared
+bool kb_set_macros(const uint8_t *new_macros, size_t size);
+
+// Adds or replaces the DKS of `dks->key_index` in the active profile, all
+// actions set to KEY_NOKEY remove it. Local keys only, DKS works on the travel
+// which the other half keeps to itself.
+bool kb_set_dks(const kb_dks_t *dks);
+
+// Activates the default profile. Profiles which were not loaded from EEPROM
+// are initialized with the current `kb_state`.
+void kb_init_profiles();
+
+// Switches to `profile` without writing to flash, unless `make_default` is set
+bool kb_set_profile(uint8_t profile, bool make_default);
+uint8_t kb_get_active_profile();
+uint8_t kb_get_default_profile();
+
+void kb_update_config_hashes();
+uint32_t kb_get_config_hash(kb_config_section section);
+// Copies the section into `buffer` and returns its size
+size_t kb_get_config_section(kb_config_section section, uint8_t *buffer);
+
 void kb_handle();
 
 #endif // KEYBOARD_H
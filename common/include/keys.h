@@ -1,6 +1,8 @@
 #ifndef KB_KEYS_H
 #define KB_KEYS_H
 
+#include <stdint.h>
+
 // Standard
 
 #define KEY_NOKEY 0x00
@@ -231,9 +233,122 @@
 #define KEY_RIGHTWINDOWS KEY_RIGHTGUI
 #define KEY_RIGHTCOMMAND KEY_RIGHTGUI
 
-// Custom
+// Actions
+//
+// Every mapping is a 16-bit action: 4-bit type and 12-bit payload. Keyboard
+// page keys above are actions of type KB_ACTION_TYPE_KEY as they are.
+
+#define KB_ACTION(type, payload)                                               \
+    ((uint16_t)(((type) << 12) | ((payload) & 0x0FFF)))
+#define KB_ACTION_TYPE(action) (((action) >> 12) & 0x0F)
+#define KB_ACTION_PAYLOAD(action) ((action) & 0x0FFF)
+
+#define KB_ACTION_TYPE_KEY 0x0       // Keyboard page usage
+#define KB_ACTION_TYPE_CONSUMER 0x1  // Consumer page usage
+#define KB_ACTION_TYPE_SYSTEM 0x2    // Generic desktop system control usage
+#define KB_ACTION_TYPE_MOUSE 0x3     // KB_MOUSE_*
+#define KB_ACTION_TYPE_LAYER 0x4     // Operation << 8 | layer
+#define KB_ACTION_TYPE_PROFILE 0x5   // Profile or KB_PROFILE_NEXT
+#define KB_ACTION_TYPE_MACRO 0x6     // Macro ID
+#define KB_ACTION_TYPE_MODS 0x7      // Modifier byte of the keyboard report
+#define KB_ACTION_TYPE_MOD_TAP 0x8   // Left modifiers << 8 | key, tap-hold
+#define KB_ACTION_TYPE_LAYER_TAP 0x9 // Layer << 8 | key, tap-hold
+#define KB_ACTION_TYPE_COUNT 0x10
+
+// Consumer
+
+#define KEY_CONSUMER(usage) KB_ACTION(KB_ACTION_TYPE_CONSUMER, usage)
+
+#define KEY_BRIGHTNESS_UP KEY_CONSUMER(0x06F)
+#define KEY_BRIGHTNESS_DOWN KEY_CONSUMER(0x070)
+#define KEY_MEDIA_NEXT KEY_CONSUMER(0x0B5)
+#define KEY_MEDIA_PREVIOUS KEY_CONSUMER(0x0B6)
+#define KEY_MEDIA_STOP KEY_CONSUMER(0x0B7)
+#define KEY_MEDIA_PLAY_PAUSE KEY_CONSUMER(0x0CD)
+#define KEY_MEDIA_MUTE KEY_CONSUMER(0x0E2)
+#define KEY_MEDIA_VOLUME_UP KEY_CONSUMER(0x0E9)
+#define KEY_MEDIA_VOLUME_DOWN KEY_CONSUMER(0x0EA)
+#define KEY_APP_CALCULATOR KEY_CONSUMER(0x192)
+#define KEY_APP_BROWSER KEY_CONSUMER(0x196)
+
+// System
+
+#define KEY_SYSTEM(usage) KB_ACTION(KB_ACTION_TYPE_SYSTEM, usage)
+
+#define KEY_SYSTEM_POWER KEY_SYSTEM(0x81)
+#define KEY_SYSTEM_SLEEP KEY_SYSTEM(0x82)
+#define KEY_SYSTEM_WAKE KEY_SYSTEM(0x83)
+
+// Mouse
+
+#define KB_MOUSE_BUTTON1 0x01
+#define KB_MOUSE_BUTTON2 0x02
+#define KB_MOUSE_BUTTON3 0x03
+#define KB_MOUSE_BUTTON4 0x04
+#define KB_MOUSE_BUTTON5 0x05
+#define KB_MOUSE_UP 0x10
+#define KB_MOUSE_DOWN 0x11
+#define KB_MOUSE_LEFT 0x12
+#define KB_MOUSE_RIGHT 0x13
+#define KB_MOUSE_WHEEL_UP 0x20
+#define KB_MOUSE_WHEEL_DOWN 0x21
+
+#define KEY_MOUSE(op) KB_ACTION(KB_ACTION_TYPE_MOUSE, op)
+
+#define KEY_MOUSE_BUTTON1 KEY_MOUSE(KB_MOUSE_BUTTON1)
+#define KEY_MOUSE_BUTTON2 KEY_MOUSE(KB_MOUSE_BUTTON2)
+#define KEY_MOUSE_BUTTON3 KEY_MOUSE(KB_MOUSE_BUTTON3)
+#define KEY_MOUSE_BUTTON4 KEY_MOUSE(KB_MOUSE_BUTTON4)
+#define KEY_MOUSE_BUTTON5 KEY_MOUSE(KB_MOUSE_BUTTON5)
+#define KEY_MOUSE_UP KEY_MOUSE(KB_MOUSE_UP)
+#define KEY_MOUSE_DOWN KEY_MOUSE(KB_MOUSE_DOWN)
+#define KEY_MOUSE_LEFT KEY_MOUSE(KB_MOUSE_LEFT)
+#define KEY_MOUSE_RIGHT KEY_MOUSE(KB_MOUSE_RIGHT)
+#define KEY_MOUSE_WHEEL_UP KEY_MOUSE(KB_MOUSE_WHEEL_UP)
+#define KEY_MOUSE_WHEEL_DOWN KEY_MOUSE(KB_MOUSE_WHEEL_DOWN)
+
+// Layers
+
+#define KB_LAYER_OP_MOMENTARY 0x0 // Layer is active while the key is held
+#define KB_LAYER_OP_TOGGLE 0x1    // Layer is toggled on every key press
+
+#define KEY_MO(layer)                                                          \
+    KB_ACTION(KB_ACTION_TYPE_LAYER, (KB_LAYER_OP_MOMENTARY << 8) | (layer))
+#define KEY_TG(layer)                                                          \
+    KB_ACTION(KB_ACTION_TYPE_LAYER, (KB_LAYER_OP_TOGGLE << 8) | (layer))
+
+// Layer key, not present on the layer, falls through to the layer below
+#define KEY_TRANSPARENT 0x01
+
+#define KEY_FN KEY_MO(1)
+#define KEY_LAYER KEY_TG(1)
+
+// Profiles
+
+#define KB_PROFILE_NEXT 0xFFF
+
+#define KEY_PROFILE(profile) KB_ACTION(KB_ACTION_TYPE_PROFILE, profile)
+#define KEY_PROFILE_NEXT KEY_PROFILE(KB_PROFILE_NEXT)
+
+// Modifiers
+
+#define KB_MOD_CTRL 0x1
+#define KB_MOD_SHIFT 0x2
+#define KB_MOD_ALT 0x4
+#define KB_MOD_GUI 0x8
+
+// Left modifiers (KB_MOD_*) are the low nibble, right ones the high one
+#define KEY_MODS(mods) KB_ACTION(KB_ACTION_TYPE_MODS, mods)
+
+// Tap-hold: key when tapped, left modifiers or momentary layer when held
+
+#define KEY_MT(mods, key)                                                      \
+    KB_ACTION(KB_ACTION_TYPE_MOD_TAP, ((mods) << 8) | (key))
+#define KEY_LT(layer, key)                                                     \
+    KB_ACTION(KB_ACTION_TYPE_LAYER_TAP, ((layer) << 8) | (key))
+
+// Macros
 
-#define KEY_FN 0xE8
-#define KEY_LAYER 0xE9
+#define KEY_MACRO(id) KB_ACTION(KB_ACTION_TYPE_MACRO, id)
 
 #endif // KB_KEYS_H
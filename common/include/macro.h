@@ -0,0 +1,61 @@
+#ifndef MACRO_H
+#define MACRO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Steps of all macros together, each macro ends with MACRO_STEP_END
+#ifndef KB_MACRO_STEPS_MAX
+#define KB_MACRO_STEPS_MAX 128U
+#endif // KB_MACRO_STEPS_MAX
+
+#ifndef KB_MACRO_MAX
+#define KB_MACRO_MAX 32U
+#endif // KB_MACRO_MAX
+
+// Actions a macro can hold pressed at the same time
+#ifndef KB_MACRO_HELD_MAX
+#define KB_MACRO_HELD_MAX 6U
+#endif // KB_MACRO_HELD_MAX
+
+// Macros triggered while another one is playing
+#ifndef KB_MACRO_QUEUE_LEN
+#define KB_MACRO_QUEUE_LEN 4U
+#endif // KB_MACRO_QUEUE_LEN
+
+typedef enum __attribute__((__packed__)) {
+    MACRO_STEP_END = 0U,
+    MACRO_STEP_PRESS = 1U,   // Action is held until released
+    MACRO_STEP_RELEASE = 2U, // Action held by MACRO_STEP_PRESS
+    MACRO_STEP_TAP = 3U,     // Action is pressed for a single report
+    MACRO_STEP_DELAY = 4U,   // ms
+} macro_step_op;
+
+typedef struct __attribute__((__packed__)) {
+
+    macro_step_op op;
+    uint16_t argument;
+
+} macro_step_t;
+
+#define KB_MACROS_SIZE (sizeof(macro_step_t) * KB_MACRO_STEPS_MAX)
+
+typedef void (*macro_process_fp)(uint16_t action);
+
+// Returns false if any step is invalid or the last macro is not terminated
+bool macro_validate(const macro_step_t *steps, uint16_t amount);
+
+// Indexes the macros in the first `amount` steps, as validated by
+// `macro_validate`. `steps` has to stay valid while they are in use.
+void macro_init(const macro_step_t *steps, uint16_t amount);
+
+// Queues the macro, it starts on the next macro_task
+void macro_play(uint16_t id);
+
+// Executes the steps which are due and processes the actions the playing
+// macro holds, so they end up in the same report as the live keys. Steps
+// never block: delays are scheduled and a release always waits for the
+// next report after the press.
+void macro_task(uint32_t now, macro_process_fp process);
+
+#endif // MACRO_H
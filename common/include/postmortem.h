@@ -0,0 +1,122 @@
+#ifndef POSTMORTEM_H
+#define POSTMORTEM_H
+
+#include "hal_err.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Post-mortem record kept in retained RAM. A fault handler or ERR_H saves the
+// faulting context and the scan timing into it, a trace ring of the last
+// events is written to it all along. The scan timing is also saved every
+// POSTMORTEM_SNAPSHOT_PERIOD, so a watchdog reset leaves it too. The record
+// survives the reset that follows (NVIC_SystemReset, the watchdog or the reset
+// pin, not a power-on or brownout reset), the next boot keeps a copy for
+// YKB_EXT_GET_POSTMORTEM.
+
+#ifndef POSTMORTEM_TRACE_LENGTH
+#define POSTMORTEM_TRACE_LENGTH 16U
+#endif // POSTMORTEM_TRACE_LENGTH
+
+// ms
+#ifndef POSTMORTEM_SNAPSHOT_PERIOD
+#define POSTMORTEM_SNAPSHOT_PERIOD 100U
+#endif // POSTMORTEM_SNAPSHOT_PERIOD
+
+typedef enum {
+    // Software reset without a saved context, a reboot or an update
+    POSTMORTEM_REASON_NONE = 0U,
+    POSTMORTEM_REASON_HARDFAULT = 1U,
+    POSTMORTEM_REASON_MEMMANAGE = 2U,
+    POSTMORTEM_REASON_BUSFAULT = 3U,
+    POSTMORTEM_REASON_USAGEFAULT = 4U,
+    // ERR_H with an error code
+    POSTMORTEM_REASON_ERROR = 5U,
+    // Set by the next boot from the reset flags, the timing is the last
+    // snapshot
+    POSTMORTEM_REASON_WATCHDOG = 6U,
+    // Neither saved nor a software reset, e.g. the reset pin
+    POSTMORTEM_REASON_UNKNOWN = 7U,
+} postmortem_reason;
+
+typedef enum {
+    // Arg: RCC_CSR reset flags >> 24
+    POSTMORTEM_EVENT_BOOT = 1U,
+    // Arg: request and version << 8 | data[0]
+    POSTMORTEM_EVENT_REQUEST = 2U,
+    POSTMORTEM_EVENT_EEPROM_COMMIT = 3U,
+    // Arg: 1 for a bootloader update
+    POSTMORTEM_EVENT_FW_UPDATE = 4U,
+    // Arg: scan duration in us, saturated
+    POSTMORTEM_EVENT_OVERRUN = 5U,
+    // Arg: negated error code
+    POSTMORTEM_EVENT_ERROR = 6U,
+} postmortem_event;
+
+typedef struct {
+
+    // us, wraps
+    uint32_t time;
+    uint16_t event;
+    uint16_t arg;
+
+} postmortem_trace_t;
+
+typedef struct {
+
+    uint32_t magic;
+    uint32_t reason;
+    int32_t error;
+    // ms after boot, of the fault or the last snapshot
+    uint32_t time;
+
+    // Stacked by the exception entry: r0-r3, r12, lr, pc, xpsr. ERR_H only
+    // fills lr with the caller.
+    uint32_t registers[8];
+    uint32_t cfsr;
+    uint32_t hfsr;
+    uint32_t mmfar;
+    uint32_t bfar;
+
+    // Telemetry and SOF sync at that time, in us
+    uint32_t scans;
+    uint32_t scan_time_min;
+    uint32_t scan_time_max;
+    uint32_t scan_time_avg;
+    uint16_t in_offset;
+    uint16_t scan_duration;
+    uint16_t scan_phase;
+    uint16_t reserved;
+
+    // Index of the next event, oldest first from there
+    uint32_t trace_head;
+    postmortem_trace_t trace[POSTMORTEM_TRACE_LENGTH];
+
+} postmortem_record_t;
+
+// Takes over the record of the previous boot. Reads the reset flags and
+// clears them, so they don't add up over the following resets.
+hal_err setup_postmortem();
+
+// RCC_CSR reset flags of this boot, as read by `setup_postmortem`
+uint32_t postmortem_get_reset_flags();
+
+void postmortem_trace(postmortem_event event, uint16_t arg);
+
+// After every scan, saves the scan timing every POSTMORTEM_SNAPSHOT_PERIOD
+void postmortem_scan_complete();
+
+// Fault handlers, `frame` is the stacked exception frame and `fault` CFSR,
+// HFSR, MMFAR and BFAR
+void postmortem_save_fault(postmortem_reason reason, const uint32_t *frame,
+                           const uint32_t *fault);
+
+// ERR_H, `caller` is the return address of the error handler
+void postmortem_save_error(hal_err error_code, uint32_t caller);
+
+// Record of the previous boot, false if there is none
+bool postmortem_get_previous(postmortem_record_t *record);
+
+void postmortem_clear_previous();
+
+#endif // POSTMORTEM_H
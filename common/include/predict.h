@@ -0,0 +1,53 @@
+#ifndef PREDICT_H
+#define PREDICT_H
+
+#include "keyboard.h"
+
+#include <stdint.h>
+
+// Samples of the velocity estimate, one per scan
+#define KB_PREDICT_SAMPLES 4U
+
+// Fractional bits of the velocity
+#define KB_PREDICT_VELOCITY_SHIFT 4U
+
+// Slower keys (raw ADC units per scan) are never actuated early, keeps noise
+// of resting keys from projecting over the threshold
+#ifndef KB_PREDICT_MIN_VELOCITY
+#define KB_PREDICT_MIN_VELOCITY 8U
+#endif // KB_PREDICT_MIN_VELOCITY
+
+// Scans an early actuation may take to cross the threshold before it's
+// considered false
+#ifndef KB_PREDICT_PENDING_MAX
+#define KB_PREDICT_PENDING_MAX 4U
+#endif // KB_PREDICT_PENDING_MAX
+
+typedef struct {
+
+    // Keys actuated before crossing their threshold
+    uint32_t early;
+    // Early actuations which crossed the threshold later on, and the scans
+    // they were ahead in total (times the scan period is the latency saved)
+    uint32_t confirmed;
+    uint32_t scans_saved;
+    // Early actuations released without ever crossing the threshold
+    uint32_t false_actuations;
+
+} predict_stats_t;
+
+// Converts the actuation thresholds (% of travel) into raw ADC values and
+// drops the sample history, has to be called again after they change
+void predict_compile(const uint8_t *key_thresholds,
+                     const uint16_t *min_thresholds,
+                     const uint16_t *max_thresholds);
+
+// Adds the samples of one scan and returns `pressed` (by position) with the
+// keys which will cross their threshold within the next scan added. A key
+// actuated early is released once it stops moving down without crossing its
+// threshold, release is positional otherwise.
+kb_key_mask_t predict_update(kb_key_mask_t pressed, const uint16_t *values);
+
+const predict_stats_t *predict_get_stats();
+
+#endif // PREDICT_H
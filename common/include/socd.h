@@ -0,0 +1,48 @@
+#ifndef SOCD_H
+#define SOCD_H
+
+#include "keyboard.h"
+
+#include <stdint.h>
+
+// Simultaneous opposing cardinal directions: at most one key of a group is
+// pressed at a time, the policy decides which one.
+#ifndef KB_SOCD_GROUP_MAX
+#define KB_SOCD_GROUP_MAX 8U
+#endif // KB_SOCD_GROUP_MAX
+
+typedef enum {
+    // The key pressed last is active, releasing it activates the other key
+    // which is still held
+    SOCD_POLICY_LAST_INPUT_WINS = 0U,
+    // The key pressed the most is active (KB_MODE_RACE within the group)
+    SOCD_POLICY_DEEPEST_PRESS_WINS = 1U,
+    // No key is active while more than one is held
+    SOCD_POLICY_NEUTRAL = 2U,
+} socd_policy;
+
+typedef struct {
+
+    kb_key_set_t keys;
+    socd_policy policy;
+
+} kb_socd_group_t;
+
+#define KB_SOCD2(group_policy, key1, key2)                                     \
+    {.keys = KB_KEY_SET(key1, key2, KB_KEY_NONE, KB_KEY_NONE),                 \
+     .policy = (group_policy)}
+#define KB_SOCD3(group_policy, key1, key2, key3)                               \
+    {.keys = KB_KEY_SET(key1, key2, key3, KB_KEY_NONE),                        \
+     .policy = (group_policy)}
+#define KB_SOCD4(group_policy, key1, key2, key3, key4)                         \
+    {.keys = KB_KEY_SET(key1, key2, key3, key4), .policy = (group_policy)}
+
+// Groups should not share keys
+void socd_init(const kb_socd_group_t *groups, uint8_t amount);
+
+// Resolves every group on the pressed keys of one scan, `values` are the ADC
+// values of the same scan for all KB_TOTAL_KEY_COUNT keys. Keys outside of the
+// groups are passed through.
+kb_key_set_t socd_resolve(kb_key_set_t pressed, const uint16_t *values);
+
+#endif // SOCD_H
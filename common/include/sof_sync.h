@@ -0,0 +1,64 @@
+#ifndef SOF_SYNC_H
+#define SOF_SYNC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Schedules the scan against the USB frame. The SOF is the phase reference,
+// the offset from it to the keyboard report being collected (IN token) is
+// measured, and the scan is started so it completes just before that. Without
+// SOFs (not configured, suspended) the scan runs free. Assumes the keyboard
+// endpoint is polled every frame (HID_KB_FS_BINTERVAL), a report which missed
+// its poll is stale by the next one.
+
+// us
+#define SOF_SYNC_FRAME 1000U
+
+// us left between the scan completing and the report being collected, covers
+// the jitter of the scan duration and the main loop
+#ifndef SOF_SYNC_GUARD
+#define SOF_SYNC_GUARD 50U
+#endif // SOF_SYNC_GUARD
+
+// us without a SOF before falling back to free running
+#define SOF_SYNC_TIMEOUT (SOF_SYNC_FRAME * 3U)
+
+// Scan complete to report collected, the last bucket also counts everything
+// above it
+#define SOF_SYNC_BUCKET_WIDTH 25U
+#define SOF_SYNC_BUCKET_COUNT 24U
+
+typedef struct {
+
+    // us after the SOF, filtered
+    uint16_t in_offset;
+    uint16_t scan_duration;
+    // The scan is started this long after the SOF
+    uint16_t scan_phase;
+
+    uint32_t histogram[SOF_SYNC_BUCKET_COUNT];
+
+} sof_sync_stats_t;
+
+// USB interrupt
+void sof_sync_on_sof();
+void sof_sync_on_report_collected();
+
+bool sof_sync_active();
+
+// Once per frame, true if the scan of this frame should be started now. Right
+// away after a frame went by without one, so a slow main loop can't starve it
+bool sof_sync_scan_due();
+
+// Around every scan, synchronized or not
+void sof_sync_scan_started();
+void sof_sync_scan_complete();
+
+// Has to be called with the USB interrupt masked, right after the report of
+// the last completed scan was handed to the endpoint
+void sof_sync_report_armed();
+
+const sof_sync_stats_t *sof_sync_get_stats();
+void sof_sync_reset_histogram();
+
+#endif // SOF_SYNC_H
@@ -0,0 +1,136 @@
+#ifndef SPLIT_LINK_H
+#define SPLIT_LINK_H
+
+#include "hal_err.h"
+#include "keyboard.h"
+#include "settings.h"
+#include "transport.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Wired link between the halves. The secondary (LEFT) half sends its key
+// changes in frames (see frame.h) over a UART, the primary (RIGHT) one maps
+// them as its remote keys (KB_REMOTE_KEY) like its own ones.
+//
+// Frames:
+//
+// DELTA: [type, seq, key count, key entries, value count, value entries].
+// A key entry is the scan index with the pressed state in bit 7, a value
+// entry is the scan index followed by the int16 (LE) change of its ADC value.
+// Only sent when something changed.
+//
+// SYNC: [type, seq, pressed mask (LE), ADC values (LE)]. Full state, sent
+// every SPLIT_LINK_SYNC_INTERVAL so a lost frame can't leave a key stuck.
+// Values are present only with SPLIT_LINK_ANALOG_ENABLED.
+//
+// PROTOCOL: [type, seq, fragment, part of a vendor protocol packet]. With
+// SPLIT_LINK_PROTOCOL_ENABLED both halves serve the vendor protocol over the
+// link (see `split_link_transport`).
+// A packet is split into parts of SPLIT_LINK_PROTOCOL_CHUNK bytes, one per
+// frame, `fragment` is the index of the part with SPLIT_LINK_PROTOCOL_LAST set
+// on the last one. A packet missing a part is dropped. Every part of a reply
+// has SPLIT_LINK_PROTOCOL_REPLY set, only requests are handed to the protocol
+// handler, so the halves don't take each other's replies for requests.
+//
+// Key entries carry the absolute state, so deltas are still applied after a
+// sequence gap. Value deltas are ignored until the next SYNC instead.
+
+#define ERR_SPLIT_LINK_TX_BUSY -1501
+
+#ifndef SPLIT_LINK_BAUDRATE
+#define SPLIT_LINK_BAUDRATE 1000000U
+#endif // SPLIT_LINK_BAUDRATE
+
+// ms
+#ifndef SPLIT_LINK_SYNC_INTERVAL
+#define SPLIT_LINK_SYNC_INTERVAL 100U
+#endif // SPLIT_LINK_SYNC_INTERVAL
+
+// ms without any frame before the remote keys are released
+#ifndef SPLIT_LINK_TIMEOUT
+#define SPLIT_LINK_TIMEOUT (SPLIT_LINK_SYNC_INTERVAL * 3U)
+#endif // SPLIT_LINK_TIMEOUT
+
+#ifndef SPLIT_LINK_ANALOG_ENABLED
+#define SPLIT_LINK_ANALOG_ENABLED 0
+#endif // SPLIT_LINK_ANALOG_ENABLED
+
+// Smaller ADC value changes are not sent, they still add up until they are
+#ifndef SPLIT_LINK_ANALOG_MIN_DELTA
+#define SPLIT_LINK_ANALOG_MIN_DELTA 4U
+#endif // SPLIT_LINK_ANALOG_MIN_DELTA
+
+// Nothing sends requests over the link yet, without a requester the transport
+// would only cost the scan its queue and flush
+#ifndef SPLIT_LINK_PROTOCOL_ENABLED
+#define SPLIT_LINK_PROTOCOL_ENABLED 0
+#endif // SPLIT_LINK_PROTOCOL_ENABLED
+
+// Bytes of a protocol packet per frame. A key frame queued behind one waits
+// for at most 15 bytes on the wire, 150 us at 1 Mbaud, and takes 90 us itself
+// with a single key, within the 250 us budget of the link.
+#ifndef SPLIT_LINK_PROTOCOL_CHUNK
+#define SPLIT_LINK_PROTOCOL_CHUNK 8U
+#endif // SPLIT_LINK_PROTOCOL_CHUNK
+
+#define SPLIT_LINK_PROTOCOL_LAST 0x80U
+#define SPLIT_LINK_PROTOCOL_REPLY 0x40U
+#define SPLIT_LINK_PROTOCOL_INDEX_MASK 0x3FU
+
+// Has to hold the bytes received between two `split_link_receive` calls
+#ifndef SPLIT_LINK_RX_RING_SIZE
+#define SPLIT_LINK_RX_RING_SIZE 256U
+#endif // SPLIT_LINK_RX_RING_SIZE
+
+#define SPLIT_LINK_MASK_SIZE ((KB_KEY_COUNT + 7U) / 8U)
+
+typedef enum {
+    SPLIT_LINK_FRAME_DELTA = 0x01U,
+    SPLIT_LINK_FRAME_SYNC = 0x02U,
+    SPLIT_LINK_FRAME_PROTOCOL = 0x03U,
+} split_link_frame_type;
+
+typedef struct {
+
+    uint32_t frames_sent;
+    uint32_t frames_received;
+    // Malformed or bad CRC
+    uint32_t frames_dropped;
+    uint32_t sequence_gaps;
+    uint32_t timeouts;
+
+} split_link_stats_t;
+
+// SPLIT_LINK_PROTOCOL_ENABLED. Protocol packets are queued and sent by
+// `split_link_flush`, key frames go first. Everything sent is a reply of the
+// protocol handler, received replies are dropped as no half sends requests of
+// its own. Requests are handled from the main loop with interrupts masked, as
+// USB hands its requests to the same handler from its interrupt.
+extern transport_t split_link_transport;
+
+hal_err split_link_init(bool primary);
+
+// Secondary half. Sends the changes since the last sent frame, nothing is
+// queued if the previous frame is still being transmitted, the next call
+// sends the changes of both.
+void split_link_send_keys(kb_key_mask_t pressed, const uint16_t *values);
+
+// Decodes everything received since the last call
+void split_link_receive();
+
+// SPLIT_LINK_PROTOCOL_ENABLED. Sends the next part of the oldest queued
+// protocol packet if the link is idle and no key changes are waiting for it.
+void split_link_flush();
+
+// Primary half. Pressed remote keys in the secondary half's scan order, also
+// those which were pressed and released again since the last call, so a short
+// tap still makes it into a scan.
+kb_key_mask_t split_link_take_remote_keys();
+
+kb_key_mask_t split_link_get_remote_keys();
+const uint16_t *split_link_get_remote_values();
+
+const split_link_stats_t *split_link_get_stats();
+
+#endif // SPLIT_LINK_H
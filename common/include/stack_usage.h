@@ -0,0 +1,32 @@
+#ifndef STACK_USAGE_H
+#define STACK_USAGE_H
+
+#include <stdint.h>
+
+// Stack high-water mark. The top STACK_PAINT_SIZE bytes of the stack are
+// painted with a pattern at boot, the deepest word which no longer holds it
+// marks the most stack used since. Read by the host with
+// YKB_EXT_GET_MEMORY_USAGE, next to the budgets of the linker script.
+
+#ifndef STACK_PAINT_SIZE
+#define STACK_PAINT_SIZE 0x2000U
+#endif // STACK_PAINT_SIZE
+
+typedef struct {
+
+    // Bytes
+    uint32_t static_ram;
+    uint32_t ram_budget;
+    uint32_t stack_budget;
+    uint32_t stack_painted;
+    // Equal to `stack_painted` once the stack grew past the painted area
+    uint32_t stack_high_water;
+
+} stack_usage_t;
+
+// First thing in main, before the stack gets deep
+void stack_paint();
+
+stack_usage_t stack_get_usage();
+
+#endif // STACK_USAGE_H
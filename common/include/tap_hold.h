@@ -0,0 +1,56 @@
+#ifndef TAP_HOLD_H
+#define TAP_HOLD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Events which can wait for a tap-hold key to be decided
+#ifndef TAP_HOLD_BUFFER_LEN
+#define TAP_HOLD_BUFFER_LEN 16U
+#endif // TAP_HOLD_BUFFER_LEN
+
+#ifndef TAP_HOLD_TERM_DEFAULT
+#define TAP_HOLD_TERM_DEFAULT 200U // ms
+#endif // TAP_HOLD_TERM_DEFAULT
+
+// Default: only releasing the tap-hold key before the tapping term makes it a
+// tap, otherwise it's a hold.
+//
+// Permissive hold: another key pressed and released while the tap-hold key is
+// undecided also makes it a hold.
+//
+// Hold on other key press: any other key pressed while the tap-hold key is
+// undecided makes it a hold.
+typedef enum {
+    TAP_HOLD_POLICY_DEFAULT = 0U,
+    TAP_HOLD_POLICY_PERMISSIVE_HOLD = 1U,
+    TAP_HOLD_POLICY_HOLD_ON_OTHER_KEY_PRESS = 2U,
+} tap_hold_policy;
+
+typedef struct {
+
+    uint8_t key_index;
+    bool pressed;
+    uint32_t time; // us
+
+} key_event_t;
+
+// Action of the key in the current keymap
+typedef uint16_t (*tap_hold_action_fp)(uint8_t key_index);
+
+// Resolved events in the order they happened. `action` is only set for presses:
+// tap-hold keys get their tap or hold action, other ones their own.
+typedef void (*tap_hold_emit_fp)(uint8_t key_index, bool pressed,
+                                 uint16_t action);
+
+void tap_hold_init(tap_hold_action_fp get_action, tap_hold_emit_fp emit);
+
+void tap_hold_configure(uint16_t tapping_term_ms, tap_hold_policy policy);
+
+// Events are passed through right away unless a tap-hold key is undecided
+void tap_hold_event(const key_event_t *event);
+
+// Decides the pending tap-hold key once the tapping term is over
+void tap_hold_task(uint32_t now);
+
+#endif // TAP_HOLD_H
@@ -0,0 +1,94 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "stm32wbxx.h"
+
+#include <stdint.h>
+
+// Always-on counters of the running firmware, read by the host with
+// YKB_EXT_GET_TELEMETRY. They are updated from the main loop and from the USB
+// interrupt, so every update masks interrupts around a plain increment (no
+// branches) and the snapshot taken by the protocol handler is consistent.
+
+typedef struct {
+
+    uint32_t scans;
+    // us, per sweep
+    uint32_t scan_time_min;
+    uint32_t scan_time_max;
+    uint64_t scan_time_sum;
+
+    // Reports handed to USB, indexed by the report being refused because the
+    // endpoint is busy. A refused report is tried again.
+    uint32_t reports[2];
+    // Keyboard reports given up on, a later scan's report took their place
+    uint32_t reports_dropped;
+    // Protocol replies the transport had no room for
+    uint32_t replies_dropped;
+
+    // Pages and double words
+    uint32_t flash_erases;
+    uint32_t flash_programs;
+    uint32_t eeprom_commits;
+    uint32_t log_drops;
+
+} telemetry_t;
+
+// What the host reads, fields in the order of the reply
+typedef struct {
+
+    uint32_t uptime;
+    uint32_t scans;
+    // Since the previous snapshot (since boot for the first)
+    uint32_t scan_rate;
+    uint32_t scan_time_min;
+    uint32_t scan_time_max;
+    uint32_t scan_time_avg;
+    uint32_t reports_sent;
+    uint32_t reports_dropped;
+    uint32_t replies_dropped;
+    uint32_t flash_erases;
+    uint32_t flash_programs;
+    uint32_t eeprom_commits;
+    uint32_t log_drops;
+    uint32_t reports_refused;
+
+} telemetry_snapshot_t;
+
+extern telemetry_t telemetry;
+
+#define TELEMETRY_ADD(counter, amount)                                         \
+    do {                                                                       \
+        uint32_t telemetry_primask = __get_PRIMASK();                          \
+        __disable_irq();                                                       \
+        telemetry.counter += (amount);                                         \
+        __set_PRIMASK(telemetry_primask);                                      \
+    } while (0)
+
+#define TELEMETRY_COUNT(counter) TELEMETRY_ADD(counter, 1U)
+
+// Once per scan, `duration` in us
+static inline void telemetry_scan(uint32_t duration) {
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    telemetry.scans++;
+    telemetry.scan_time_sum += duration;
+    // Selects, not branches
+    telemetry.scan_time_min = duration < telemetry.scan_time_min
+                                  ? duration
+                                  : telemetry.scan_time_min;
+    telemetry.scan_time_max = duration > telemetry.scan_time_max
+                                  ? duration
+                                  : telemetry.scan_time_max;
+
+    __set_PRIMASK(primask);
+}
+
+telemetry_snapshot_t telemetry_get_snapshot();
+
+// Starts the scan time min, max and average over
+void telemetry_reset_scan_times();
+
+#endif // TELEMETRY_H
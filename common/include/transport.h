@@ -0,0 +1,73 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include "hal_err.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Link the vendor protocol (see interface_handler.h) runs over. The protocol
+// handling only talks to this, so adding a transport doesn't touch it.
+
+// Largest packet any transport has to carry, a full vendor HID report
+#define TRANSPORT_PACKET_MAX 64U
+
+#ifndef TRANSPORT_QUEUE_LEN
+#define TRANSPORT_QUEUE_LEN 4U
+#endif // TRANSPORT_QUEUE_LEN
+
+struct __transport_t;
+
+typedef void (*transport_receive_callback)(struct __transport_t *transport,
+                                           const uint8_t *data,
+                                           uint16_t length);
+
+typedef struct __transport_t {
+
+    const char *name;
+
+    // Largest packet `send` accepts
+    uint16_t mtu;
+
+    // Queues a single packet, ERR_INTERFACE_TX_BUSY if there is no room for
+    // it right now
+    hal_err (*send)(const uint8_t *data, uint16_t length);
+
+    // Called by the transport for every received packet, see
+    // `transport_register`
+    transport_receive_callback receive;
+
+} transport_t;
+
+// TX queue for transports which don't have one in their driver
+typedef struct {
+
+    uint8_t packets[TRANSPORT_QUEUE_LEN][TRANSPORT_PACKET_MAX];
+    uint16_t lengths[TRANSPORT_QUEUE_LEN];
+    uint8_t head;
+    uint8_t count;
+
+} transport_queue_t;
+
+void transport_register(transport_t *transport,
+                        transport_receive_callback receive);
+
+static inline void transport_receive(transport_t *transport,
+                                     const uint8_t *data, uint16_t length) {
+    if (transport->receive) {
+        transport->receive(transport, data, length);
+    }
+}
+
+bool transport_queue_push(transport_queue_t *queue, const uint8_t *data,
+                          uint16_t length);
+// Oldest packet, NULL if the queue is empty. Stays queued until popped.
+const uint8_t *transport_queue_peek(const transport_queue_t *queue,
+                                    uint16_t *length);
+void transport_queue_pop(transport_queue_t *queue);
+
+static inline uint8_t transport_queue_free(const transport_queue_t *queue) {
+    return TRANSPORT_QUEUE_LEN - queue->count;
+}
+
+#endif // TRANSPORT_H
@@ -0,0 +1,33 @@
+#ifndef TRANSPORT_LOOPBACK_H
+#define TRANSPORT_LOOPBACK_H
+
+#include "transport.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Transport without a link, sent packets stay in its queue until they are
+// popped. Used to drive and measure the protocol layer on the host.
+
+typedef struct {
+
+    uint32_t packets_received;
+    uint32_t packets_sent;
+    uint32_t bytes_sent;
+    // Sends rejected because the queue was full
+    uint32_t busy;
+
+} transport_loopback_stats_t;
+
+extern transport_t loopback_transport;
+
+// Hands `packet` to the receive callback as if it came over a link
+void transport_loopback_inject(const uint8_t *packet, uint16_t length);
+
+// Copies the oldest sent packet into `packet` (TRANSPORT_PACKET_MAX bytes)
+bool transport_loopback_pop(uint8_t *packet, uint16_t *length);
+
+void transport_loopback_reset();
+const transport_loopback_stats_t *transport_loopback_get_stats();
+
+#endif // TRANSPORT_LOOPBACK_H
@@ -2,6 +2,10 @@
 #define USB_H
 
 #include "hal_err.h"
+#include "transport.h"
+
+// Vendor interface, packets are sent as reports with VEND_HID_REPORT_ID
+extern transport_t usb_transport;
 
 hal_err setup_usb();
 
@@ -8,7 +8,7 @@
 #include <string.h>
 
 /*---------- -----------*/
-#define USBD_MAX_NUM_INTERFACES 2U
+#define USBD_MAX_NUM_INTERFACES 3U
 /*---------- -----------*/
 #define USBD_MAX_NUM_CONFIGURATION 1U
 /*---------- -----------*/
@@ -21,6 +21,8 @@
 #define USBD_SELF_POWERED 1U
 /*---------- -----------*/
 #define HID_FS_BINTERVAL 0xAU
+// Polled every frame, the scan is synchronized to the SOF (sof_sync.h)
+#define HID_KB_FS_BINTERVAL 0x1U
 
 /****************************************/
 /* #define for FS and HS identification */
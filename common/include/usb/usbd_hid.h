@@ -6,11 +6,12 @@
 #ifndef HID_EPIN_ADDR
 #define HID_EPIN_ADDR 0x81U
 #endif /* HID_EPIN_ADDR */
-#define HID_EPIN_SIZE 0x04U
+#define HID_EPIN_SIZE 0x08U
 
-#define USB_HID_CONFIG_DESC_SIZ 66U
+#define USB_HID_CONFIG_DESC_SIZ 91U
 #define USB_HID_DESC_SIZ 9U
 #define USB_VEND_HID_DESC_SIZ 9U
+#define USB_GAMEPAD_HID_DESC_SIZ 9U
 #define HID_KB_REPORT_DESC_SIZE 63U
 
 #define HID_DESCRIPTOR_TYPE 0x21U
@@ -32,7 +33,31 @@
 #define VEND_HID_EPIN_ADDR 0x83U
 #define VEND_HID_EPOUT_ADDR 0x03U
 #define VEND_HID_EPSIZE 0x40U
-#define VEND_HID_REPORT_DESC_SIZE 33U
+#define VEND_HID_REPORT_DESC_SIZE 136U
+
+// Report IDs of the vendor interface. Consumer, system control and mouse
+// reports share its IN endpoint with the ykb protocol replies.
+#define VEND_HID_REPORT_ID 0x01U
+#define HID_CONSUMER_REPORT_ID 0x02U
+#define HID_SYSTEM_REPORT_ID 0x03U
+#define HID_MOUSE_REPORT_ID 0x04U
+
+// Gamepad has its own interface and IN endpoint, so its reports never wait
+// for the keyboard or the vendor ones
+#define GAMEPAD_HID_EPIN_ADDR 0x82U
+#define GAMEPAD_HID_EPIN_SIZE 0x0CU
+#define GAMEPAD_HID_REPORT_DESC_SIZE 31U
+
+// Amount of reports which can wait for the vendor IN endpoint
+#ifndef VEND_HID_TX_QUEUE_LEN
+#define VEND_HID_TX_QUEUE_LEN 8U
+#endif // VEND_HID_TX_QUEUE_LEN
+
+// Vendor OUT endpoint is not re-armed (host gets NAKed) until the TX queue has
+// at least this amount of free slots, so every request has room for its reply
+#ifndef VEND_HID_RX_RESUME_THRESHOLD
+#define VEND_HID_RX_RESUME_THRESHOLD 4U
+#endif // VEND_HID_RX_RESUME_THRESHOLD
 
 typedef enum {
     USBD_HID_IDLE = 0,
@@ -45,6 +70,17 @@ typedef struct {
     uint32_t AltSetting;
     USBD_HID_StateTypeDef kb_state;
     USBD_HID_StateTypeDef vend_state;
+    USBD_HID_StateTypeDef gamepad_state;
+    uint8_t vend_tx_queue[VEND_HID_TX_QUEUE_LEN][VEND_HID_EPSIZE];
+    uint16_t vend_tx_len[VEND_HID_TX_QUEUE_LEN];
+    uint8_t vend_tx_head;
+    uint8_t vend_tx_count;
+    // Consumer, system or mouse report, goes ahead of the queued ones
+    uint8_t vend_extra[VEND_HID_EPSIZE];
+    uint16_t vend_extra_len;
+    // The extra report is being transmitted rather than the queue head
+    uint8_t vend_extra_sending;
+    uint8_t vend_rx_paused;
 } USBD_HID_HandleTypeDef;
 
 /*
@@ -65,8 +101,17 @@ typedef struct {
 extern USBD_ClassTypeDef USBD_HID;
 #define USBD_HID_CLASS &USBD_HID
 
+// Returns USBD_BUSY if the report could not be accepted: keyboard or gamepad
+// endpoint is still transmitting or the vendor TX queue is full
 uint8_t USBD_HID_SendReport(USBD_HandleTypeDef *pdev, uint8_t ep_addr,
                             uint8_t *report, uint16_t len);
+// Consumer, system and mouse reports on the vendor endpoint. They have a slot
+// of their own which goes ahead of queued protocol replies, USBD_BUSY until
+// the previous one is sent.
+uint8_t USBD_HID_SendExtraReport(USBD_HandleTypeDef *pdev, uint8_t *report,
+                                 uint16_t len);
+// Free slots in the vendor endpoint TX queue
+uint8_t USBD_HID_VendTxFree(USBD_HandleTypeDef *pdev);
 uint32_t USBD_HID_GetPollingInterval(USBD_HandleTypeDef *pdev);
 
 #endif /* __USB_HID_H */
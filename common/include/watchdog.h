@@ -0,0 +1,57 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include "hal_err.h"
+
+#include <stdint.h>
+
+// Independent watchdog fed by the scan loop. It's only fed when a scan and its
+// reports complete within WATCHDOG_BUDGET, so a hung conversion or flash wait
+// as well as a loop which keeps running over budget reset the MCU after
+// WATCHDOG_TIMEOUT_MS. Overruns are recorded in retained RAM, the next boot
+// reports them together with the reset reason.
+
+// Also covers the blocking flash operations of an update, which feed the
+// watchdog in between
+#ifndef WATCHDOG_TIMEOUT_MS
+#define WATCHDOG_TIMEOUT_MS 2000U
+#endif // WATCHDOG_TIMEOUT_MS
+
+// us from the start of a scan to its reports being handed to USB
+#ifndef WATCHDOG_BUDGET
+#define WATCHDOG_BUDGET 1000U
+#endif // WATCHDOG_BUDGET
+
+typedef struct {
+
+    // RCC_CSR reset flags of this boot
+    uint32_t reset_flags;
+
+    // Of the previous boot, all 0 after a power-on reset
+    uint32_t previous_overruns;
+    // us
+    uint32_t previous_last_overrun;
+    // ms after boot
+    uint32_t previous_last_overrun_time;
+    uint32_t previous_last_feed_time;
+
+    // Of this boot
+    uint32_t overruns;
+    uint32_t last_overrun;
+    uint32_t last_overrun_time;
+
+} watchdog_report_t;
+
+// Starts the watchdog, right before the main loop. `reset_flags` are the
+// RCC_CSR reset flags of this boot.
+hal_err setup_watchdog(uint32_t reset_flags);
+
+// After every scan, `duration` in us
+void watchdog_cycle_complete(uint32_t duration);
+
+// Long blocking operations outside of the scan loop
+void watchdog_feed();
+
+watchdog_report_t watchdog_get_report();
+
+#endif // WATCHDOG_H
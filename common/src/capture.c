@@ -0,0 +1,198 @@
+#include "capture.h"
+
+#include "hal_systick.h"
+
+#include "stm32wbxx.h"
+
+#include <string.h>
+
+static capture_frame_t frames[CAPTURE_FRAME_COUNT];
+// Next frame written
+static uint16_t head = 0U;
+static uint16_t frame_count = 0U;
+
+// The protocol handler (USB interrupt) only sets it to idle, the rest is up to
+// the scan
+static volatile capture_state state = CAPTURE_STATE_IDLE;
+
+// Staged by `capture_arm`, the scan applies it before its next frame
+static struct {
+
+    uint8_t key;
+    uint16_t level;
+    capture_trigger type;
+    uint16_t post_frames;
+
+} staged;
+static volatile bool arm_pending = false;
+
+static uint8_t trigger_key = 0U;
+static uint16_t trigger_level = 0U;
+static capture_trigger trigger_type = CAPTURE_TRIGGER_NONE;
+static uint16_t trigger_post_frames = 0U;
+
+static uint16_t previous_value = 0U;
+static uint16_t post_frames_left = 0U;
+
+hal_err capture_arm(uint8_t key_index, uint16_t level, capture_trigger trigger,
+                    uint16_t post_frames) {
+
+    if (trigger > CAPTURE_TRIGGER_BOTH) {
+        return ERR_CAPTURE_ARM_BADTRIGGER;
+    }
+
+    if (trigger != CAPTURE_TRIGGER_NONE && key_index >= KB_KEY_COUNT) {
+        return ERR_CAPTURE_ARM_BADKEY;
+    }
+
+    if (post_frames > CAPTURE_FRAME_COUNT - 1U) {
+        post_frames = CAPTURE_FRAME_COUNT - 1U;
+    }
+
+    // The scan may be in the middle of a frame, the ring and the trigger are
+    // left to it
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    staged.key = key_index;
+    staged.level = level;
+    staged.type = trigger;
+    staged.post_frames = post_frames;
+    arm_pending = trigger != CAPTURE_TRIGGER_NONE;
+    state = CAPTURE_STATE_IDLE;
+
+    __set_PRIMASK(primask);
+
+    return OK;
+}
+
+// Interrupts have to be masked
+static inline void capture_apply_staged() {
+
+    trigger_key = staged.key;
+    trigger_level = staged.level;
+    trigger_type = staged.type;
+    trigger_post_frames = staged.post_frames;
+    head = 0U;
+    frame_count = 0U;
+
+    arm_pending = false;
+    state = CAPTURE_STATE_ARMED;
+}
+
+static inline bool capture_triggered(uint16_t value) {
+
+    switch (trigger_type) {
+
+    case CAPTURE_TRIGGER_IMMEDIATE:
+        return true;
+
+    case CAPTURE_TRIGGER_RISING:
+        return previous_value < trigger_level && value >= trigger_level;
+
+    case CAPTURE_TRIGGER_FALLING:
+        return previous_value >= trigger_level && value < trigger_level;
+
+    case CAPTURE_TRIGGER_BOTH:
+        return (previous_value < trigger_level) != (value < trigger_level);
+
+    default:
+        return false;
+    }
+}
+
+void capture_frame(const uint16_t *values) {
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (arm_pending) {
+        capture_apply_staged();
+    }
+    capture_state seen = state;
+    __set_PRIMASK(primask);
+
+    capture_state current = seen;
+
+    if (current != CAPTURE_STATE_ARMED && current != CAPTURE_STATE_TRIGGERED) {
+        return;
+    }
+
+    capture_frame_t *frame = &frames[head];
+    frame->time = systick_get_us();
+    memcpy(frame->values, values, sizeof(frame->values));
+
+    head = head + 1U < CAPTURE_FRAME_COUNT ? head + 1U : 0U;
+    if (frame_count < CAPTURE_FRAME_COUNT) {
+        frame_count++;
+    }
+
+    uint16_t value = values[trigger_key];
+
+    if (current == CAPTURE_STATE_ARMED) {
+        // The first frame has nothing to cross from
+        if ((frame_count > 1U ||
+             trigger_type == CAPTURE_TRIGGER_IMMEDIATE) &&
+            capture_triggered(value)) {
+            post_frames_left = trigger_post_frames;
+            current = CAPTURE_STATE_TRIGGERED;
+        }
+        previous_value = value;
+    } else {
+        post_frames_left--;
+    }
+
+    if (current == CAPTURE_STATE_TRIGGERED && post_frames_left == 0U) {
+        current = CAPTURE_STATE_DONE;
+    }
+
+    // Unless re-armed or stopped by the protocol meanwhile
+    primask = __get_PRIMASK();
+    __disable_irq();
+    if (state == seen && !arm_pending) {
+        state = current;
+    }
+    __set_PRIMASK(primask);
+}
+
+capture_status_t capture_get_status() {
+
+    capture_status_t status = {.state = state};
+
+    if (status.state == CAPTURE_STATE_DONE) {
+        status.frame_count = frame_count;
+        status.trigger_frame = frame_count - 1U - trigger_post_frames;
+    }
+
+    return status;
+}
+
+uint16_t capture_read(uint32_t offset, uint8_t *buffer, uint16_t size) {
+
+    if (state != CAPTURE_STATE_DONE) {
+        return 0U;
+    }
+
+    uint32_t total = (uint32_t)frame_count * sizeof(capture_frame_t);
+    if (offset >= total) {
+        return 0U;
+    }
+    if (size > total - offset) {
+        size = total - offset;
+    }
+
+    // Oldest frame is at `head` once the ring has wrapped
+    uint32_t start = frame_count < CAPTURE_FRAME_COUNT
+                         ? 0U
+                         : (uint32_t)head * sizeof(capture_frame_t);
+    uint32_t position = (start + offset) % sizeof(frames);
+
+    uint16_t first = size;
+    if (first > sizeof(frames) - position) {
+        first = sizeof(frames) - position;
+    }
+
+    memcpy(buffer, (const uint8_t *)frames + position, first);
+    memcpy(buffer + first, frames, size - first);
+
+    return size;
+}
@@ -0,0 +1,158 @@
+#include "combo.h"
+
+#include "keys.h"
+#include "logging.h"
+#include "tap_hold.h"
+
+#include <stddef.h>
+
+static const kb_combo_t *combos = NULL;
+static uint8_t combo_amount = 0U;
+
+// Keys which are part of at least one combo
+static kb_key_set_t combo_keys = {0};
+
+static kb_key_set_t previous_pressed = {0};
+
+// Combo key presses which are held back, in order
+static kb_key_set_t chord = {0};
+static key_event_t chord_presses[KB_TOTAL_KEY_COUNT];
+static uint8_t chord_length = 0U;
+
+// Keys of matched combos, their own presses and releases are not reported
+static kb_key_set_t combo_keys_held = {0};
+static bool combo_active[KB_COMBO_MAX];
+
+void combo_init(const kb_combo_t *new_combos, uint8_t amount) {
+
+    if (amount > KB_COMBO_MAX) {
+        LOG_ERROR("Too many combos (%d), only %d are used.", amount,
+                  KB_COMBO_MAX);
+        amount = KB_COMBO_MAX;
+    }
+
+    combos = new_combos;
+    combo_amount = amount;
+
+    combo_keys = (kb_key_set_t){0};
+    for (uint8_t i = 0; i < combo_amount; i++) {
+        combo_keys = kb_key_set_or(combo_keys, combos[i].keys);
+    }
+
+    LOG_DEBUG("%d combos initialized.", combo_amount);
+}
+
+uint16_t combo_get_action(uint8_t combo) {
+    if (combo >= combo_amount) {
+        return KEY_NOKEY;
+    }
+    return combos[combo].action;
+}
+
+static inline void combo_emit(uint8_t index, bool pressed, uint32_t time) {
+    key_event_t event = {.key_index = index, .pressed = pressed, .time = time};
+    tap_hold_event(&event);
+}
+
+static inline void combo_chord_clear() {
+    chord = (kb_key_set_t){0};
+    chord_length = 0U;
+}
+
+static void combo_resolve_chord(uint32_t now) {
+
+    if (kb_key_set_empty(chord)) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < combo_amount; i++) {
+        if (kb_key_set_equal(combos[i].keys, chord)) {
+            combo_active[i] = true;
+            combo_keys_held = kb_key_set_or(combo_keys_held, chord);
+            combo_emit(KB_TOTAL_KEY_COUNT + i, true, now);
+            combo_chord_clear();
+            return;
+        }
+    }
+
+    // Not a combo, press the keys in the order they came
+    for (uint8_t i = 0; i < chord_length; i++) {
+        tap_hold_event(&chord_presses[i]);
+    }
+
+    combo_chord_clear();
+}
+
+// Called on every chord change, combos are only walked then
+static void combo_chord_update(uint32_t now) {
+
+    for (uint8_t i = 0; i < combo_amount; i++) {
+        if (kb_key_set_equal(kb_key_set_and(combos[i].keys, chord), chord) &&
+            !kb_key_set_equal(combos[i].keys, chord)) {
+            // Longer combo is still possible
+            return;
+        }
+    }
+
+    // Either matches right away or never will
+    combo_resolve_chord(now);
+}
+
+static void combo_release(uint8_t index, uint32_t now) {
+
+    if (!kb_key_set_has(combo_keys_held, index)) {
+        combo_emit(index, false, now);
+        return;
+    }
+
+    kb_key_set_remove(&combo_keys_held, index);
+
+    // First released key releases the combo, the rest are ignored
+    for (uint8_t i = 0; i < combo_amount; i++) {
+        if (combo_active[i] && kb_key_set_has(combos[i].keys, index)) {
+            combo_active[i] = false;
+            combo_emit(KB_TOTAL_KEY_COUNT + i, false, now);
+        }
+    }
+}
+
+void combo_scan(kb_key_set_t pressed, uint32_t now) {
+
+    kb_key_set_t released = kb_key_set_and_not(previous_pressed, pressed);
+    kb_key_set_t new_pressed = kb_key_set_and_not(pressed, previous_pressed);
+
+    previous_pressed = pressed;
+
+    while (!kb_key_set_empty(released)) {
+        uint8_t index = kb_key_set_pop(&released);
+
+        if (kb_key_set_has(chord, index)) {
+            // Released before the chord got complete
+            combo_resolve_chord(now);
+        }
+
+        combo_release(index, now);
+    }
+
+    while (!kb_key_set_empty(new_pressed)) {
+        uint8_t index = kb_key_set_pop(&new_pressed);
+
+        if (!kb_key_set_has(combo_keys, index)) {
+            combo_resolve_chord(now);
+            combo_emit(index, true, now);
+            continue;
+        }
+
+        kb_key_set_add(&chord, index);
+        chord_presses[chord_length] = (key_event_t){
+            .key_index = index, .pressed = true, .time = now};
+        chord_length++;
+
+        combo_chord_update(now);
+    }
+
+    if (!kb_key_set_empty(chord) &&
+        now - chord_presses[0].time >= KB_COMBO_TERM * 1000U) {
+        combo_resolve_chord(now);
+    }
+}
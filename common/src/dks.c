@@ -0,0 +1,168 @@
+#include "dks.h"
+
+#include "keys.h"
+#include "logging.h"
+#include "macro.h"
+
+#include <stddef.h>
+
+// Stage of the press cycle, the next point to be crossed depends on it
+typedef enum {
+    DKS_STAGE_RELEASED = 0U,
+    DKS_STAGE_PRESSED = 1U,
+    DKS_STAGE_BOTTOMED_OUT = 2U,
+    DKS_STAGE_RELEASED_FROM_BOTTOM = 3U,
+} dks_stage;
+
+typedef struct {
+
+    uint16_t breakpoints[KB_DKS_POINTS]; // Raw ADC values
+    dks_stage stage;
+    uint8_t held;   // Bit per point
+    uint8_t tapped; // Bit per point, cleared after every report
+
+} dks_key_t;
+
+static const kb_dks_t *dks_config = NULL;
+static dks_key_t dks_keys[KB_DKS_MAX];
+static uint8_t dks_amount = 0U;
+
+bool dks_valid(const kb_dks_t *dks) {
+
+    if (!dks || dks->key_index >= KB_KEY_COUNT) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < KB_DKS_POINTS; i++) {
+        if (dks->depths[i] < 1U || dks->depths[i] > 100U) {
+            return false;
+        }
+    }
+
+    return dks->depths[DKS_POINT_PRESS] < dks->depths[DKS_POINT_BOTTOM_OUT] &&
+           dks->depths[DKS_POINT_RELEASE_FROM_BOTTOM] <
+               dks->depths[DKS_POINT_BOTTOM_OUT] &&
+           dks->depths[DKS_POINT_RELEASE] <= dks->depths[DKS_POINT_PRESS];
+}
+
+void dks_compile(const kb_dks_t *dks, uint8_t amount,
+                 const uint16_t *min_thresholds,
+                 const uint16_t *max_thresholds) {
+
+    if (amount > KB_DKS_MAX) {
+        amount = KB_DKS_MAX;
+    }
+
+    dks_config = dks;
+    dks_amount = amount;
+
+    for (uint8_t i = 0; i < dks_amount; i++) {
+        dks_key_t *key = &dks_keys[i];
+        uint8_t index = dks[i].key_index;
+
+        key->stage = DKS_STAGE_RELEASED;
+        key->held = 0U;
+        key->tapped = 0U;
+
+        uint16_t min = min_thresholds[index];
+        uint16_t max = max_thresholds[index];
+
+        for (uint8_t j = 0; j < KB_DKS_POINTS; j++) {
+            if (max <= min) {
+                // Not calibrated, never pressed
+                key->breakpoints[j] = UINT16_MAX;
+                continue;
+            }
+            key->breakpoints[j] =
+                min + (uint32_t)(max - min) * dks[i].depths[j] / 100U;
+        }
+    }
+
+    LOG_DEBUG("%d DKS keys compiled.", dks_amount);
+}
+
+static void dks_cross(const kb_dks_t *dks, dks_key_t *key, dks_point point) {
+
+    uint16_t action = dks->actions[point];
+
+    if (point == DKS_POINT_RELEASE) {
+        key->held = 0U;
+    }
+
+    if (action == KEY_NOKEY) {
+        return;
+    }
+
+    if (KB_ACTION_TYPE(action) == KB_ACTION_TYPE_MACRO) {
+        macro_play(KB_ACTION_PAYLOAD(action));
+        return;
+    }
+
+    if (point != DKS_POINT_RELEASE && (dks->hold & (1U << point))) {
+        key->held |= 1U << point;
+    } else {
+        key->tapped |= 1U << point;
+    }
+}
+
+void dks_scan(const uint16_t *values) {
+
+    for (uint8_t i = 0; i < dks_amount; i++) {
+        const kb_dks_t *dks = &dks_config[i];
+        dks_key_t *key = &dks_keys[i];
+        uint16_t value = values[dks->key_index];
+        const uint16_t *breakpoints = key->breakpoints;
+
+        // A fast press can cross more than one point between two scans
+        switch (key->stage) {
+        case DKS_STAGE_RELEASED:
+            if (value < breakpoints[DKS_POINT_PRESS]) {
+                break;
+            }
+            dks_cross(dks, key, DKS_POINT_PRESS);
+            key->stage = DKS_STAGE_PRESSED;
+            // fall through
+        case DKS_STAGE_PRESSED:
+            if (value >= breakpoints[DKS_POINT_BOTTOM_OUT]) {
+                dks_cross(dks, key, DKS_POINT_BOTTOM_OUT);
+                key->stage = DKS_STAGE_BOTTOMED_OUT;
+            } else if (value < breakpoints[DKS_POINT_RELEASE]) {
+                dks_cross(dks, key, DKS_POINT_RELEASE);
+                key->stage = DKS_STAGE_RELEASED;
+            }
+            break;
+        case DKS_STAGE_BOTTOMED_OUT:
+            if (value >= breakpoints[DKS_POINT_RELEASE_FROM_BOTTOM]) {
+                break;
+            }
+            dks_cross(dks, key, DKS_POINT_RELEASE_FROM_BOTTOM);
+            key->stage = DKS_STAGE_RELEASED_FROM_BOTTOM;
+            // fall through
+        case DKS_STAGE_RELEASED_FROM_BOTTOM:
+            if (value >= breakpoints[DKS_POINT_BOTTOM_OUT]) {
+                dks_cross(dks, key, DKS_POINT_BOTTOM_OUT);
+                key->stage = DKS_STAGE_BOTTOMED_OUT;
+            } else if (value < breakpoints[DKS_POINT_RELEASE]) {
+                dks_cross(dks, key, DKS_POINT_RELEASE);
+                key->stage = DKS_STAGE_RELEASED;
+            }
+            break;
+        }
+    }
+}
+
+void dks_task(dks_process_fp process) {
+
+    for (uint8_t i = 0; i < dks_amount; i++) {
+        dks_key_t *key = &dks_keys[i];
+        uint8_t active = key->held | key->tapped;
+
+        for (uint8_t j = 0; j < KB_DKS_POINTS; j++) {
+            if (active & (1U << j)) {
+                process(dks_config[i].actions[j]);
+            }
+        }
+
+        key->tapped = 0U;
+    }
+}
@@ -3,6 +3,8 @@
 #include "hal_flash.h"
 
 #include "memory_map.h"
+#include "postmortem.h"
+#include "telemetry.h"
 
 #include <stdint.h>
 #include <string.h>
@@ -33,18 +35,8 @@ hal_err eeprom_get(uint32_t address, void *value, size_t size) {
         return ERR_EEPROM_GET_OUTOFBOUNDS;
     }
 
-    const size_t buff_size = (size / 4U) + 1U;
-
-    uint32_t buffer[buff_size];
-
-    for (size_t i = 0; i < buff_size; i++) {
-        buffer[i] = *(volatile uint32_t *)address;
-        address += 4U;
-    }
-
-    if (value) {
-        memcpy(value, buffer, size);
-    }
+    // Flash is memory mapped, no need for a copy of it on the stack
+    memcpy(value, (const void *)address, size);
 
     return OK;
 }
@@ -63,6 +55,7 @@ hal_err eeprom_clear() {
         flash_lock();
         return err;
     }
+    TELEMETRY_ADD(flash_erases, eeprom_get_size() / 4096U);
 
     err = flash_lock();
     if (err) {
@@ -86,16 +79,6 @@ hal_err eeprom_save(uint32_t address, void *value, size_t size) {
         return ERR_EEPROM_SAVE_OUTOFBOUNDS;
     }
 
-    size_t buff_size = size / 8U;
-    if (size % 8 != 0) {
-        buff_size++;
-    }
-
-    uint64_t buffer[buff_size];
-    buffer[buff_size - 1] = 0U;
-
-    memcpy(buffer, value, size);
-
     hal_err err;
 
     err = flash_unlock();
@@ -103,13 +86,21 @@ hal_err eeprom_save(uint32_t address, void *value, size_t size) {
         return err;
     }
 
-    for (size_t i = 0; i < buff_size; i++) {
-        err = flash_program(FLASH_TYPEPROGRAM_DOUBLEWORD, address + (8 * i),
-                            buffer[i]);
+    // Programmed straight from `value`, a copy of it would have to go on the
+    // stack. Only the last double word is padded with 0.
+    const uint8_t *data = value;
+    for (size_t offset = 0; offset < size; offset += 8U) {
+        uint64_t double_word = 0U;
+        memcpy(&double_word, &data[offset],
+               size - offset < 8U ? size - offset : 8U);
+
+        err = flash_program(FLASH_TYPEPROGRAM_DOUBLEWORD, address + offset,
+                            double_word);
         if (err) {
             flash_lock();
             return err;
         }
+        TELEMETRY_COUNT(flash_programs);
     }
 
     err = flash_lock();
@@ -117,5 +108,8 @@ hal_err eeprom_save(uint32_t address, void *value, size_t size) {
         return err;
     }
 
+    TELEMETRY_COUNT(eeprom_commits);
+    postmortem_trace(POSTMORTEM_EVENT_EEPROM_COMMIT, 0U);
+
     return OK;
 }
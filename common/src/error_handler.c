@@ -4,6 +4,7 @@
 
 #include "logging.h"
 #include "pinout.h"
+#include "postmortem.h"
 #include "settings.h"
 
 #ifdef PIN_ERROR_HANDLER_LED
@@ -24,10 +25,16 @@ void setup_error_handler() {
 
 void error_handler(hal_err error_code) {
 
-#ifdef PIN_ERROR_HANDLER_LED
     if (error_code == OK)
         return;
 
+#ifndef BOOTLOADER
+    // Survives a reset by the watchdog or the reset pin
+    postmortem_save_error(error_code,
+                          (uint32_t)__builtin_return_address(0));
+#endif // !BOOTLOADER
+
+#ifdef PIN_ERROR_HANDLER_LED
     if (error_code > 0 || error_code > -100) {
         // Unknown error
         gpio_digital_write(led_dbg, HIGH);
@@ -0,0 +1,110 @@
+#include "frame.h"
+
+#include "ykb_protocol.h"
+
+#include <string.h>
+
+size_t frame_encode(const uint8_t *payload, size_t length, uint8_t *out) {
+
+    if (length > FRAME_PAYLOAD_MAX) {
+        return 0U;
+    }
+
+    uint8_t raw[FRAME_PAYLOAD_MAX + 2U];
+    memcpy(raw, payload, length);
+
+    uint16_t crc = ykb_crc16(payload, length);
+    raw[length++] = crc & 0xFF;
+    raw[length++] = crc >> 8;
+
+    // Every zero is replaced by the distance to the next one, the first code
+    // byte holds the distance to the first zero
+    size_t code_index = 0U;
+    size_t out_index = 1U;
+    uint8_t code = 1U;
+
+    for (size_t i = 0; i < length; i++) {
+        if (raw[i] == 0U) {
+            out[code_index] = code;
+            code_index = out_index++;
+            code = 1U;
+            continue;
+        }
+
+        out[out_index++] = raw[i];
+        code++;
+    }
+
+    out[code_index] = code;
+    out[out_index++] = FRAME_DELIMITER;
+
+    return out_index;
+}
+
+void frame_decoder_reset(frame_decoder_t *decoder) {
+    decoder->length = 0U;
+    decoder->overflow = false;
+}
+
+// In place, the decoded data is always shorter than the encoded one
+static size_t frame_cobs_decode(uint8_t *buffer, size_t length) {
+
+    size_t in = 0U;
+    size_t out = 0U;
+
+    while (in < length) {
+        uint8_t code = buffer[in++];
+
+        if (code == 0U || in + code - 1U > length) {
+            return 0U;
+        }
+
+        for (uint8_t i = 1U; i < code; i++) {
+            buffer[out++] = buffer[in++];
+        }
+
+        if (in < length) {
+            buffer[out++] = 0U;
+        }
+    }
+
+    return out;
+}
+
+frame_decode_result frame_decoder_push(frame_decoder_t *decoder, uint8_t byte,
+                                       size_t *payload_length) {
+
+    if (byte != FRAME_DELIMITER) {
+        if (decoder->length >= sizeof(decoder->buffer)) {
+            decoder->overflow = true;
+            return FRAME_DECODE_INCOMPLETE;
+        }
+
+        decoder->buffer[decoder->length++] = byte;
+        return FRAME_DECODE_INCOMPLETE;
+    }
+
+    if (decoder->length == 0U) {
+        // Idle line or back to back delimiters
+        return FRAME_DECODE_INCOMPLETE;
+    }
+
+    bool overflow = decoder->overflow;
+    size_t length = frame_cobs_decode(decoder->buffer, decoder->length);
+    frame_decoder_reset(decoder);
+
+    if (overflow || length < 2U) {
+        return FRAME_DECODE_ERROR;
+    }
+
+    length -= 2U;
+
+    uint16_t crc = decoder->buffer[length] | decoder->buffer[length + 1] << 8;
+    if (crc != ykb_crc16(decoder->buffer, length)) {
+        return FRAME_DECODE_ERROR;
+    }
+
+    *payload_length = length;
+
+    return FRAME_DECODE_OK;
+}
@@ -5,6 +5,10 @@
 #include "boot_config.h"
 #include "logging.h"
 #include "memory_map.h"
+#include "postmortem.h"
+#include "settings.h"
+#include "telemetry.h"
+#include "watchdog.h"
 
 #include "stm32wbxx.h"
 
@@ -31,8 +35,20 @@ static fw_update_source bl_source = FW_UPDATE_SOURCE_NONE;
 static bool bootloader_update_ready = false;
 static size_t bl_update_size = 0U;
 
+// The watchdog is fed around every blocking flash operation, the scan loop
+// doesn't run meanwhile
+static inline void fw_update_feed_watchdog() {
+#if defined(WATCHDOG_ENABLED) && WATCHDOG_ENABLED == 1
+    watchdog_feed();
+#endif // WATCHDOG_ENABLED
+}
+
 static inline hal_err erase_staging() {
-    return flash_erase(FW_STAGING_ADDRESS, FW_STAGING_PAGE_SIZE, NULL);
+    TELEMETRY_ADD(flash_erases, FW_STAGING_PAGE_SIZE);
+    fw_update_feed_watchdog();
+    hal_err err = flash_erase(FW_STAGING_ADDRESS, FW_STAGING_PAGE_SIZE, NULL);
+    fw_update_feed_watchdog();
+    return err;
 }
 
 static inline void erase_staging_and_boot_config() {
@@ -183,6 +199,8 @@ static inline void fw_update() {
             fw_update_cleanup();
             return;
         }
+        TELEMETRY_COUNT(flash_programs);
+        fw_update_feed_watchdog();
     }
     LOG_TRACE("Staging flashed successfully.");
 
@@ -205,6 +223,7 @@ static inline void fw_update() {
     LOG_TRACE("Flash locked.");
 
     LOG_INFO("Rebooting to bootloader...");
+    postmortem_trace(POSTMORTEM_EVENT_FW_UPDATE, 0U);
 
     NVIC_SystemReset();
 }
@@ -224,12 +243,15 @@ static inline void bl_update() {
 
     LOG_TRACE("Erasing old bootloader...");
     uint32_t page_amount = bl_update_size / FLASH_PAGE_SIZE + 1;
+    fw_update_feed_watchdog();
     err = flash_erase(FLASH_BASE, page_amount, NULL);
+    fw_update_feed_watchdog();
     if (err) {
         LOG_ERROR("Unable tp erase old bootloader: Error %d", err);
         bl_update_cleanup();
         return;
     }
+    TELEMETRY_ADD(flash_erases, page_amount);
 
     size_t block_size = bl_update_size / 8U;
     if (block_size % 8 != 0) {
@@ -249,6 +271,8 @@ static inline void bl_update() {
             bl_update_cleanup();
             return;
         }
+        TELEMETRY_COUNT(flash_programs);
+        fw_update_feed_watchdog();
     }
     LOG_TRACE("Bootloader flashed successfully.");
 
@@ -262,6 +286,7 @@ static inline void bl_update() {
     LOG_TRACE("Flash locked.");
 
     LOG_INFO("Rebooting to bootloader...");
+    postmortem_trace(POSTMORTEM_EVENT_FW_UPDATE, 1U);
 
     NVIC_SystemReset();
 }
@@ -0,0 +1,88 @@
+#include "gamepad.h"
+
+#include "logging.h"
+
+#include <stddef.h>
+#include <string.h>
+
+static const kb_gamepad_axis_t *gamepad_axes = NULL;
+static uint8_t gamepad_axis_amount = 0U;
+
+static uint16_t key_offsets[KB_KEY_COUNT];
+static uint16_t key_ranges[KB_KEY_COUNT];
+static uint32_t key_factors[KB_KEY_COUNT];
+
+static gamepad_report_t report;
+static gamepad_report_t report_sent;
+
+void gamepad_init(const kb_gamepad_axis_t *axes, uint8_t amount) {
+
+    if (amount > GAMEPAD_AXIS_COUNT) {
+        LOG_ERROR("Too many gamepad axes (%d), only %d are used.", amount,
+                  GAMEPAD_AXIS_COUNT);
+        amount = GAMEPAD_AXIS_COUNT;
+    }
+
+    gamepad_axes = axes;
+    gamepad_axis_amount = amount;
+
+    memset(&report, 0, sizeof(report));
+    memset(&report_sent, 0, sizeof(report_sent));
+
+    LOG_DEBUG("%d gamepad axes initialized.", gamepad_axis_amount);
+}
+
+void gamepad_compile(const uint16_t *min_thresholds,
+                     const uint16_t *max_thresholds) {
+
+    for (uint8_t i = 0; i < KB_KEY_COUNT; i++) {
+        key_offsets[i] = min_thresholds[i];
+
+        if (max_thresholds[i] <= min_thresholds[i]) {
+            // Not calibrated, no travel
+            key_ranges[i] = 0U;
+            key_factors[i] = 0U;
+            continue;
+        }
+
+        key_ranges[i] = max_thresholds[i] - min_thresholds[i];
+        key_factors[i] = ((uint32_t)GAMEPAD_AXIS_MAX << GAMEPAD_SCALE_SHIFT) /
+                         key_ranges[i];
+    }
+}
+
+static inline int32_t gamepad_travel(uint8_t key, const uint16_t *values) {
+
+    if (key >= KB_KEY_COUNT || values[key] <= key_offsets[key]) {
+        return 0;
+    }
+
+    // Clamped to the range, so the product always fits
+    uint32_t travel = values[key] - key_offsets[key];
+    if (travel > key_ranges[key]) {
+        travel = key_ranges[key];
+    }
+
+    return (int32_t)((travel * key_factors[key]) >> GAMEPAD_SCALE_SHIFT);
+}
+
+bool gamepad_update(const uint16_t *values) {
+
+    for (uint8_t i = 0; i < gamepad_axis_amount; i++) {
+        const kb_gamepad_axis_t *axis = &gamepad_axes[i];
+
+        if (axis->axis >= GAMEPAD_AXIS_COUNT) {
+            continue;
+        }
+
+        report.axes[axis->axis] =
+            (int16_t)(gamepad_travel(axis->positive_key, values) -
+                      gamepad_travel(axis->negative_key, values));
+    }
+
+    return memcmp(&report, &report_sent, sizeof(report)) != 0;
+}
+
+const gamepad_report_t *gamepad_get_report() { return &report; }
+
+void gamepad_report_sent() { report_sent = report; }
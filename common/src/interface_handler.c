@@ -2,64 +2,134 @@
 
 #include "ykb_protocol.h"
 
-#include "usb/usbd_def.h"
-#include "usb/usbd_hid.h"
-
+#include "capture.h"
 #include "fw_update_handler.h"
 #include "keyboard.h"
 #include "logging.h"
+#include "postmortem.h"
 #include "settings.h"
+#include "sof_sync.h"
+#include "stack_usage.h"
+#include "telemetry.h"
+#include "watchdog.h"
+
+#include "stm32wbxx.h"
 
 #include <stdint.h>
 #include <string.h>
 #include <sys/types.h>
 
-#if defined(USB_ENABLED) && USB_ENABLED == 1
-extern USBD_HandleTypeDef hUsbDeviceFS;
-#endif // USB_ENABLED
+static hal_err interface_send_packet(transport_t *transport,
+                                     ykb_protocol_t *packet) {
+
+    if (sizeof(ykb_protocol_t) > transport->mtu) {
+        return ERR_INTERFACE_TX_FAIL;
+    }
+
+    hal_err err = transport->send((uint8_t *)packet, sizeof(ykb_protocol_t));
+    TELEMETRY_ADD(replies_dropped, err != OK);
+
+    return err;
+}
+
+static hal_err interface_send_reply(transport_t *transport,
+                                    ykb_protocol_t *packet, uint8_t *data,
+                                    uint32_t data_length) {
+
+    hal_err err;
+
+    if (data_length <= YKB_PROTOCOL_DATA_LENGTH) {
+
+        memset(packet->data, 0, sizeof(packet->data));
+        if (data_length) {
+            memcpy(packet->data, data, data_length);
+        }
+
+        packet->crc = ykb_crc16(packet->data, data_length);
+        packet->packet_size = data_length;
+
+        err = interface_send_packet(transport, packet);
+        if (err) {
+            LOG_ERROR("Unable to send reply: Error %d", err);
+        }
+        return err;
+    }
 
-static void interface_send_reply(communication_source source,
-                                 ykb_protocol_t *packet, uint8_t *data,
-                                 uint32_t data_length) {
+    uint32_t packet_amount =
+        (data_length + YKB_PROTOCOL_DATA_LENGTH - 1) / YKB_PROTOCOL_DATA_LENGTH;
 
-    uint16_t size = data_length;
-    if (data_length > YKB_PROTOCOL_DATA_LENGTH) {
-        if ((packet->packet_number + 1) * YKB_PROTOCOL_DATA_LENGTH >
-            data_length) {
-            size = data_length % YKB_PROTOCOL_DATA_LENGTH;
-        } else {
+    // Burst every packet from the requested one till the end, so the host
+    // does not need a round trip per packet
+    while (packet->packet_number < packet_amount) {
+
+        uint32_t offset = packet->packet_number * YKB_PROTOCOL_DATA_LENGTH;
+        uint16_t size = data_length - offset;
+        if (size > YKB_PROTOCOL_DATA_LENGTH) {
             size = YKB_PROTOCOL_DATA_LENGTH;
         }
+
+        memset(packet->data, 0, sizeof(packet->data));
+        memcpy(packet->data, &data[offset], size);
+
+        packet->crc = ykb_crc16(packet->data, size);
+        packet->packet_size = size;
+
+        err = interface_send_packet(transport, packet);
+        if (err) {
+            LOG_DEBUG("Reply stopped at packet %d: Error %d",
+                      packet->packet_number, err);
+            return err;
+        }
+
+        packet->packet_number++;
     }
 
-    uint8_t buff[sizeof(ykb_protocol_t) + 2];
-    buff[0] = 1;
+    return OK;
+}
 
-    memset(packet->data, 0, sizeof(packet->data));
-    memcpy(packet->data,
-           &data[packet->packet_number * YKB_PROTOCOL_DATA_LENGTH], size);
+// Long reply the transport had no room for, the rest is sent from the main
+// loop by `interface_handler_task`
+static ykb_protocol_t stream_packet;
+static transport_t *stream_transport = NULL;
+static uint8_t *stream_data;
+static uint32_t stream_length;
 
-    packet->crc = ykb_crc16(packet->data, size);
-    packet->packet_size = size;
+// `data` has to stay valid until the reply is complete
+static void interface_stream_reply(transport_t *transport,
+                                   ykb_protocol_t *packet, uint8_t *data,
+                                   uint32_t data_length) {
 
-    memcpy(&buff[1], packet, sizeof(ykb_protocol_t));
+    stream_transport = NULL;
 
-    switch (source) {
-    case COMMUNICATION_SOURCE_USB:
-#if defined(USB_ENABLED) && USB_ENABLED == 1
-        USBD_HID_SendReport(&hUsbDeviceFS, VEND_HID_EPIN_ADDR, buff,
-                            sizeof(buff));
-#endif // USB_ENABLED
-        break;
-    case COMMUNICATION_SOURCE_BT:
-#if defined(BLUETOOTH_ENABLED) && BLUETOOTH_ENABLED == 1
-        // TODO
-#endif // BLUETOOTH_ENABLED
-        break;
+    hal_err err = interface_send_reply(transport, packet, data, data_length);
+    if (err != ERR_INTERFACE_TX_BUSY) {
+        return;
     }
+
+    memcpy(&stream_packet, packet, sizeof(stream_packet));
+    stream_transport = transport;
+    stream_data = data;
+    stream_length = data_length;
 }
 
-static void handle_get_settings(communication_source source,
+void interface_handler_task() {
+
+    // Requests are handled in the USB interrupt, which may start a new stream
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (stream_transport) {
+        hal_err err = interface_send_reply(stream_transport, &stream_packet,
+                                           stream_data, stream_length);
+        if (err != ERR_INTERFACE_TX_BUSY) {
+            stream_transport = NULL;
+        }
+    }
+
+    __set_PRIMASK(primask);
+}
+
+static void handle_get_settings(transport_t *transport,
                                 ykb_protocol_t *packet) {
 
     LOG_DEBUG("New get settings request.");
@@ -69,58 +139,56 @@ static void handle_get_settings(communication_source source,
     kb_get_settings(buff);
 
     // Send OK
-    interface_send_reply(source, packet, buff, sizeof(buff));
+    interface_send_reply(transport, packet, buff, sizeof(buff));
 }
 
-static void handle_get_mappings(communication_source source,
+static void handle_get_mappings(transport_t *transport,
                                 ykb_protocol_t *packet) {
 
     LOG_DEBUG("New get mappings request.");
 
-    uint8_t buff[KB_KEY_COUNT];
+    uint8_t buff[KB_MAPPINGS_SIZE];
 
     kb_get_mappings(buff);
 
     // Send OK
-    interface_send_reply(source, packet, buff, sizeof(buff));
+    interface_send_reply(transport, packet, buff, sizeof(buff));
 }
 
-static void handle_get_values(communication_source source,
-                              ykb_protocol_t *packet) {
+static void handle_get_values(transport_t *transport, ykb_protocol_t *packet) {
 
     LOG_DEBUG("New get values request, packet number: %d",
               packet->packet_number);
 
-    kb_request_values(source, packet);
+    kb_request_values(transport, packet);
 }
 
-void interface_handle_get_values_response(communication_source source,
-                                          ykb_protocol_t *packet,
-                                          uint16_t *values) {
+hal_err interface_handle_get_values_response(transport_t *transport,
+                                             ykb_protocol_t *packet,
+                                             uint16_t *values) {
 
     LOG_DEBUG("Responding to get values request (packet number %d)...",
               packet->packet_number);
 
-    interface_send_reply(source, packet, (uint8_t *)values,
-                         sizeof(uint16_t) * KB_KEY_COUNT);
+    return interface_send_reply(transport, packet, (uint8_t *)values,
+                                sizeof(uint16_t) * KB_KEY_COUNT);
 }
 
-static void handle_get_thresholds(communication_source source,
+static void handle_get_thresholds(transport_t *transport,
                                   ykb_protocol_t *packet) {
 
     LOG_DEBUG("New get thresholds request, packet number: %d",
               packet->packet_number);
 
-    uint8_t buff[sizeof(uint8_t) * KB_KEY_COUNT +
-                 sizeof(uint16_t) * KB_KEY_COUNT * 2];
+    uint8_t buff[KB_THRESHOLDS_SIZE];
 
     kb_get_thresholds(buff);
 
     // Send OK
-    interface_send_reply(source, packet, buff, sizeof(buff));
+    interface_send_reply(transport, packet, buff, sizeof(buff));
 }
 
-static void handle_set_settings(communication_source source,
+static void handle_set_settings(transport_t *transport,
                                 ykb_protocol_t *packet) {
 
     LOG_DEBUG("New set settings request.");
@@ -130,24 +198,49 @@ static void handle_set_settings(communication_source source,
     kb_set_settings(&new_settings);
 
     // Send OK
-    interface_send_reply(source, packet, NULL, 0);
+    interface_send_reply(transport, packet, NULL, 0);
 }
 
-static void handle_set_mappings(communication_source source,
+static uint16_t mappings_buffer[KB_KEY_COUNT];
+static uint8_t mappings_buffer_length = 0U;
+
+static void mappings_buffer_cleanup() {
+    memset(mappings_buffer, 0, sizeof(mappings_buffer));
+    mappings_buffer_length = 0U;
+}
+
+static void handle_set_mappings(transport_t *transport,
                                 ykb_protocol_t *packet) {
 
-    LOG_DEBUG("New set mappings request.");
+    LOG_DEBUG("New set mappings request, packet number: %d",
+              packet->packet_number);
 
-    uint8_t mappings[KB_KEY_COUNT] = {0};
-    memcpy(mappings, packet->data, sizeof(mappings));
-    kb_set_mappings(mappings);
+    if (packet->packet_number == 0 && mappings_buffer_length != 0) {
+        LOG_DEBUG("Clearing old set mappings try...");
+        mappings_buffer_cleanup();
+    }
+
+    if (mappings_buffer_length + packet->packet_size >
+        sizeof(mappings_buffer)) {
+        LOG_ERROR("Error setting mappings: buffer overflow.");
+        mappings_buffer_cleanup();
+        return;
+    }
+
+    memcpy((uint8_t *)mappings_buffer + mappings_buffer_length, packet->data,
+           packet->packet_size);
+    mappings_buffer_length += packet->packet_size;
+
+    if (packet->packet_size < YKB_PROTOCOL_DATA_LENGTH) {
+        kb_set_mappings(mappings_buffer);
+        mappings_buffer_cleanup();
+    }
 
     // Send OK
-    interface_send_reply(source, packet, NULL, 0);
+    interface_send_reply(transport, packet, NULL, 0);
 }
 
-static uint8_t thresholds_buffer[KB_KEY_COUNT * sizeof(uint16_t) * 2 +
-                                 KB_KEY_COUNT * sizeof(uint8_t)];
+static uint8_t thresholds_buffer[KB_THRESHOLDS_SIZE];
 static uint8_t thresholds_buffer_length = 0U;
 
 static void thresholds_buffer_cleanup() {
@@ -155,7 +248,7 @@ static void thresholds_buffer_cleanup() {
     thresholds_buffer_length = 0U;
 }
 
-static void handle_set_thresholds(communication_source source,
+static void handle_set_thresholds(transport_t *transport,
                                   ykb_protocol_t *packet) {
 
     LOG_DEBUG("New set thresholds request, packet number: %d",
@@ -181,10 +274,10 @@ static void handle_set_thresholds(communication_source source,
         thresholds_buffer_cleanup();
     }
 
-    interface_send_reply(source, packet, NULL, 0);
+    interface_send_reply(transport, packet, NULL, 0);
 }
 
-static void handle_firmware_update(communication_source source,
+static void handle_firmware_update(transport_t *transport,
                                    ykb_protocol_t *packet) {
     LOG_DEBUG("New firmware update packet, packet number: %d",
               packet->packet_number);
@@ -207,10 +300,10 @@ static void handle_firmware_update(communication_source source,
     }
 
     // Send OK
-    interface_send_reply(source, packet, NULL, 0);
+    interface_send_reply(transport, packet, NULL, 0);
 }
 
-static void handle_bootloader_update(communication_source source,
+static void handle_bootloader_update(transport_t *transport,
                                      ykb_protocol_t *packet) {
     LOG_DEBUG("New bootloader update packet, packet number: %d",
               packet->packet_number);
@@ -234,10 +327,389 @@ static void handle_bootloader_update(communication_source source,
     }
 
     // Send OK
-    interface_send_reply(source, packet, NULL, 0);
+    interface_send_reply(transport, packet, NULL, 0);
+}
+
+static void handle_ext_get_config_hashes(transport_t *transport,
+                                         ykb_protocol_t *packet) {
+
+    LOG_DEBUG("New get config hashes request.");
+
+    uint8_t buff[1 + sizeof(uint32_t) * KB_CONFIG_SECTION_COUNT];
+    buff[0] = YKB_EXT_GET_CONFIG_HASHES;
+
+    for (uint8_t i = 0; i < KB_CONFIG_SECTION_COUNT; i++) {
+        uint32_t hash = kb_get_config_hash(i);
+        memcpy(&buff[1 + sizeof(uint32_t) * i], &hash, sizeof(uint32_t));
+    }
+
+    interface_send_reply(transport, packet, buff, sizeof(buff));
+}
+
+static void handle_ext_get_config_if_changed(transport_t *transport,
+                                             ykb_protocol_t *packet) {
+
+    LOG_DEBUG("New conditional get config request, packet number: %d",
+              packet->packet_number);
+
+    // Too big for the stack
+    static uint8_t buff[2 + sizeof(uint32_t) * KB_CONFIG_SECTION_COUNT +
+                        KB_CONFIG_SECTIONS_MAX_SIZE];
+    buff[0] = YKB_EXT_GET_CONFIG_IF_CHANGED;
+    buff[1] = 0U;
+
+    size_t length = 2 + sizeof(uint32_t) * KB_CONFIG_SECTION_COUNT;
+
+    for (uint8_t i = 0; i < KB_CONFIG_SECTION_COUNT; i++) {
+        uint32_t host_hash;
+        memcpy(&host_hash, &packet->data[1 + sizeof(uint32_t) * i],
+               sizeof(uint32_t));
+
+        uint32_t hash = kb_get_config_hash(i);
+        memcpy(&buff[2 + sizeof(uint32_t) * i], &hash, sizeof(uint32_t));
+
+        if (hash == host_hash) {
+            continue;
+        }
+
+        buff[1] |= 1U << i;
+        length += kb_get_config_section(i, &buff[length]);
+    }
+
+    // A full resync is more packets than the transport queues
+    interface_stream_reply(transport, packet, buff, length);
 }
 
-typedef void (*fp)(communication_source source, ykb_protocol_t *packet);
+static void handle_ext_set_key_fields(transport_t *transport,
+                                      ykb_protocol_t *packet) {
+
+    uint8_t amount = packet->data[1];
+
+    LOG_DEBUG("New set key fields request, %d updates.", amount);
+
+    kb_key_field_update_t
+        updates[(YKB_PROTOCOL_DATA_LENGTH - 2) / sizeof(kb_key_field_update_t)];
+
+    uint8_t buff[2] = {YKB_EXT_SET_KEY_FIELDS, 0};
+
+    if (amount > sizeof(updates) / sizeof(kb_key_field_update_t)) {
+        LOG_ERROR("Error setting key fields: too many updates.");
+        interface_send_reply(transport, packet, buff, sizeof(buff));
+        return;
+    }
+
+    memcpy(updates, &packet->data[2], amount * sizeof(kb_key_field_update_t));
+
+    if (kb_set_key_fields(updates, amount)) {
+        buff[1] = amount;
+    }
+
+    interface_send_reply(transport, packet, buff, sizeof(buff));
+}
+
+static void handle_ext_get_profile(transport_t *transport,
+                                   ykb_protocol_t *packet) {
+
+    LOG_DEBUG("New get profile request.");
+
+    uint8_t buff[4] = {YKB_EXT_GET_PROFILE, KB_PROFILE_COUNT,
+                       kb_get_active_profile(), kb_get_default_profile()};
+
+    interface_send_reply(transport, packet, buff, sizeof(buff));
+}
+
+static void handle_ext_set_profile(transport_t *transport,
+                                   ykb_protocol_t *packet) {
+
+    LOG_DEBUG("New set profile request.");
+
+    bool switched = kb_set_profile(packet->data[1], packet->data[2] == 1);
+
+    uint8_t buff[5] = {YKB_EXT_SET_PROFILE, switched, KB_PROFILE_COUNT,
+                       kb_get_active_profile(), kb_get_default_profile()};
+
+    interface_send_reply(transport, packet, buff, sizeof(buff));
+}
+
+static uint8_t macros_buffer[KB_MACROS_SIZE];
+static uint16_t macros_buffer_length = 0U;
+
+static void macros_buffer_cleanup() {
+    memset(macros_buffer, 0, sizeof(macros_buffer));
+    macros_buffer_length = 0U;
+}
+
+static void handle_ext_set_macros(transport_t *transport,
+                                  ykb_protocol_t *packet) {
+
+    LOG_DEBUG("New set macros request, packet number: %d",
+              packet->packet_number);
+
+    uint8_t buff[2] = {YKB_EXT_SET_MACROS, 0};
+
+    if (packet->packet_number == 0 && macros_buffer_length != 0) {
+        LOG_DEBUG("Clearing old set macros try...");
+        macros_buffer_cleanup();
+    }
+
+    if (packet->packet_size == 0U) {
+        LOG_ERROR("Error setting macros: empty packet.");
+        macros_buffer_cleanup();
+        interface_send_reply(transport, packet, buff, sizeof(buff));
+        return;
+    }
+
+    // `data[0]` is the extended request
+    uint8_t length = packet->packet_size - 1U;
+
+    if (macros_buffer_length + length > sizeof(macros_buffer)) {
+        LOG_ERROR("Error setting macros: buffer overflow.");
+        macros_buffer_cleanup();
+        interface_send_reply(transport, packet, buff, sizeof(buff));
+        return;
+    }
+
+    memcpy(&macros_buffer[macros_buffer_length], &packet->data[1], length);
+    macros_buffer_length += length;
+
+    if (packet->packet_size < YKB_PROTOCOL_DATA_LENGTH) {
+        buff[1] = kb_set_macros(macros_buffer, macros_buffer_length);
+        macros_buffer_cleanup();
+    }
+
+    interface_send_reply(transport, packet, buff, sizeof(buff));
+}
+
+static void handle_ext_set_dks(transport_t *transport, ykb_protocol_t *packet) {
+
+    kb_dks_t dks;
+    memcpy(&dks, &packet->data[1], sizeof(kb_dks_t));
+
+    LOG_DEBUG("New set DKS request, key %d.", dks.key_index);
+
+    uint8_t buff[2] = {YKB_EXT_SET_DKS, kb_set_dks(&dks)};
+
+    interface_send_reply(transport, packet, buff, sizeof(buff));
+}
+
+static void handle_ext_get_scan_timing(transport_t *transport,
+                                       ykb_protocol_t *packet) {
+
+    LOG_DEBUG("New get scan timing request.");
+
+    const sof_sync_stats_t *stats = sof_sync_get_stats();
+    uint16_t fields[4] = {stats->in_offset, stats->scan_duration,
+                          stats->scan_phase, SOF_SYNC_BUCKET_WIDTH};
+
+    uint8_t buff[3 + sizeof(fields) + sizeof(stats->histogram)];
+    buff[0] = YKB_EXT_GET_SCAN_TIMING;
+    buff[1] = sof_sync_active();
+    memcpy(&buff[2], fields, sizeof(fields));
+    buff[2 + sizeof(fields)] = SOF_SYNC_BUCKET_COUNT;
+    memcpy(&buff[3 + sizeof(fields)], stats->histogram,
+           sizeof(stats->histogram));
+
+    if (packet->data[1] == 1U) {
+        sof_sync_reset_histogram();
+    }
+
+    interface_send_reply(transport, packet, buff, sizeof(buff));
+}
+
+static void handle_ext_capture_arm(transport_t *transport,
+                                   ykb_protocol_t *packet) {
+
+    uint16_t level;
+    uint16_t post_frames;
+    memcpy(&level, &packet->data[2], sizeof(level));
+    memcpy(&post_frames, &packet->data[5], sizeof(post_frames));
+
+    LOG_DEBUG("New capture arm request, key %d trigger %d.", packet->data[1],
+              packet->data[4]);
+
+    hal_err err =
+        capture_arm(packet->data[1], level, packet->data[4], post_frames);
+    if (err) {
+        LOG_ERROR("Unable to arm capture: Error %d", err);
+    }
+
+    uint8_t buff[2] = {YKB_EXT_CAPTURE_ARM, err == OK};
+    interface_send_reply(transport, packet, buff, sizeof(buff));
+}
+
+static void handle_ext_capture_status(transport_t *transport,
+                                      ykb_protocol_t *packet) {
+
+    LOG_DEBUG("New capture status request.");
+
+    capture_status_t status = capture_get_status();
+    uint16_t fields[3] = {status.frame_count, status.trigger_frame,
+                          CAPTURE_FRAME_COUNT};
+
+    uint8_t buff[4 + sizeof(fields)];
+    buff[0] = YKB_EXT_CAPTURE_STATUS;
+    buff[1] = status.state;
+    buff[2] = KB_KEY_COUNT;
+    buff[3] = sizeof(capture_frame_t);
+    memcpy(&buff[4], fields, sizeof(fields));
+
+    interface_send_reply(transport, packet, buff, sizeof(buff));
+}
+
+#define CAPTURE_PACKET_LENGTH (YKB_PROTOCOL_DATA_LENGTH - 1U)
+
+_Static_assert(sizeof(capture_frame_t) * CAPTURE_FRAME_COUNT <=
+                   CAPTURE_PACKET_LENGTH * UINT8_MAX,
+               "Capture does not fit the packet numbers");
+
+static void handle_ext_capture_read(transport_t *transport,
+                                    ykb_protocol_t *packet) {
+
+    LOG_DEBUG("New capture read request, packet number: %d",
+              packet->packet_number);
+
+    // Frames are copied straight into the packets, a reply buffer would be
+    // as large as the ring
+    while (true) {
+
+        memset(packet->data, 0, sizeof(packet->data));
+        packet->data[0] = YKB_EXT_CAPTURE_READ;
+
+        uint16_t size = capture_read(packet->packet_number *
+                                         CAPTURE_PACKET_LENGTH,
+                                     &packet->data[1], CAPTURE_PACKET_LENGTH);
+        if (size == 0U && packet->packet_number != 0U) {
+            return;
+        }
+
+        packet->crc = ykb_crc16(packet->data, size + 1U);
+        packet->packet_size = size + 1U;
+
+        hal_err err = interface_send_packet(transport, packet);
+        if (err) {
+            LOG_DEBUG("Capture read stopped at packet %d: Error %d",
+                      packet->packet_number, err);
+            return;
+        }
+
+        if (size < CAPTURE_PACKET_LENGTH) {
+            return;
+        }
+
+        packet->packet_number++;
+    }
+}
+
+_Static_assert(1U + sizeof(telemetry_snapshot_t) <= YKB_PROTOCOL_DATA_LENGTH,
+               "Telemetry reply is longer than a packet");
+
+static void handle_ext_get_telemetry(transport_t *transport,
+                                     ykb_protocol_t *packet) {
+
+    LOG_DEBUG("New get telemetry request.");
+
+    telemetry_snapshot_t snapshot = telemetry_get_snapshot();
+
+    uint8_t buff[1 + sizeof(snapshot)];
+    buff[0] = YKB_EXT_GET_TELEMETRY;
+    memcpy(&buff[1], &snapshot, sizeof(snapshot));
+
+    if (packet->data[1] == 1U) {
+        telemetry_reset_scan_times();
+    }
+
+    interface_send_reply(transport, packet, buff, sizeof(buff));
+}
+
+static void handle_ext_get_reset_info(transport_t *transport,
+                                      ykb_protocol_t *packet) {
+
+    LOG_DEBUG("New get reset info request.");
+
+    watchdog_report_t report = {0};
+    uint8_t enabled = 0U;
+#if defined(WATCHDOG_ENABLED) && WATCHDOG_ENABLED == 1
+    report = watchdog_get_report();
+    enabled = 1U;
+#endif // WATCHDOG_ENABLED
+
+    uint8_t buff[2 + sizeof(report)];
+    buff[0] = YKB_EXT_GET_RESET_INFO;
+    buff[1] = enabled;
+    memcpy(&buff[2], &report, sizeof(report));
+
+    interface_send_reply(transport, packet, buff, sizeof(buff));
+}
+
+static void handle_ext_get_postmortem(transport_t *transport,
+                                      ykb_protocol_t *packet) {
+
+    LOG_DEBUG("New get post-mortem request.");
+
+    postmortem_record_t record = {0};
+    uint8_t valid = postmortem_get_previous(&record);
+
+    uint8_t buff[2 + sizeof(record)];
+    buff[0] = YKB_EXT_GET_POSTMORTEM;
+    buff[1] = valid;
+    memcpy(&buff[2], &record, sizeof(record));
+
+    // The reply overwrites the request
+    bool clear = packet->data[1] == 1U;
+
+    // Only once the last packet is out, a burst cut short is asked for again
+    hal_err err = interface_send_reply(transport, packet, buff, sizeof(buff));
+    if (err == OK && clear) {
+        postmortem_clear_previous();
+    }
+}
+
+static void handle_ext_get_memory_usage(transport_t *transport,
+                                        ykb_protocol_t *packet) {
+
+    LOG_DEBUG("New get memory usage request.");
+
+    stack_usage_t usage = stack_get_usage();
+
+    uint8_t buff[1 + sizeof(usage)];
+    buff[0] = YKB_EXT_GET_MEMORY_USAGE;
+    memcpy(&buff[1], &usage, sizeof(usage));
+
+    interface_send_reply(transport, packet, buff, sizeof(buff));
+}
+
+typedef void (*fp)(transport_t *transport, ykb_protocol_t *packet);
+
+static fp ext_request_fp_map[] = {
+    handle_ext_get_config_hashes,     //
+    handle_ext_get_config_if_changed, //
+    handle_ext_set_key_fields,        //
+    handle_ext_get_profile,           //
+    handle_ext_set_profile,           //
+    handle_ext_set_macros,            //
+    handle_ext_set_dks,               //
+    handle_ext_get_scan_timing,       //
+    handle_ext_capture_arm,           //
+    handle_ext_capture_status,        //
+    handle_ext_capture_read,          //
+    handle_ext_get_telemetry,         //
+    handle_ext_get_reset_info,        //
+    handle_ext_get_postmortem,        //
+    handle_ext_get_memory_usage,      //
+};
+
+static void handle_extended_request(transport_t *transport,
+                                    ykb_protocol_t *packet) {
+
+    uint8_t ext_request = packet->data[0];
+
+    if (ext_request >= sizeof(ext_request_fp_map) / sizeof(fp)) {
+        LOG_ERROR("Unknown extended request %d", ext_request);
+        return;
+    }
+
+    ext_request_fp_map[ext_request](transport, packet);
+}
 
 static fp request_fp_map[9] = {
     handle_get_settings,      //
@@ -251,11 +723,13 @@ static fp request_fp_map[9] = {
     handle_bootloader_update, //
 };
 
-void interface_handle_new_packet(communication_source source, uint8_t *packet,
-                                 uint8_t packet_length) {
+void interface_handle_new_packet(transport_t *transport, const uint8_t *packet,
+                                 uint16_t packet_length) {
 
     ykb_protocol_t result;
-    memcpy(&result, packet, packet_length);
+    memset(&result, 0, sizeof(result));
+    memcpy(&result, packet,
+           packet_length < sizeof(result) ? packet_length : sizeof(result));
 
     uint8_t version = result.request_and_version & 0x0F;
     uint8_t request = result.request_and_version & 0xF0;
@@ -265,7 +739,15 @@ void interface_handle_new_packet(communication_source source, uint8_t *packet,
         return;
     }
 
+    postmortem_trace(POSTMORTEM_EVENT_REQUEST,
+                     result.request_and_version << 8U | result.data[0]);
+
+    if (request == YKB_EXTENDED_REQUEST) {
+        handle_extended_request(transport, &result);
+        return;
+    }
+
     if (IS_YKB_GET_REQUEST(request) || IS_YKB_SET_REQUEST(request)) {
-        request_fp_map[(request >> 4) - 1](source, &result);
+        request_fp_map[(request >> 4) - 1](transport, &result);
     }
 }
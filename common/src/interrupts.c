@@ -7,35 +7,44 @@
 #include "hal_pcd.h"
 
 #include "logging.h"
+#include "postmortem.h"
+
+#include "stm32wbxx.h"
 
 extern PCD_HandleTypeDef hpcd_USB_FS;
 
 void NMI_Handler(void) { LOG_TRACE("NMI_Handler."); }
 
-void HardFault_Handler(void) {
-    LOG_CRITICAL("HARDFAULT.");
-    while (1) {
+// Passes the stacked frame of the faulting context (MSP or PSP, from
+// EXC_RETURN bit 2) to `fault_handler`
+#define FAULT_HANDLER(NAME, REASON)                                            \
+    __attribute__((naked)) void NAME(void) {                                   \
+        __asm volatile("tst lr, #4\n"                                          \
+                       "ite eq\n"                                              \
+                       "mrseq r0, msp\n"                                       \
+                       "mrsne r0, psp\n"                                       \
+                       "mov r1, %0\n"                                          \
+                       "b fault_handler\n" ::"i"(REASON));                     \
     }
-}
 
-void MemManage_Handler(void) {
-    LOG_CRITICAL("MEMMANAGE.");
-    while (1) {
-    }
-}
+__attribute__((used)) void fault_handler(const uint32_t *frame,
+                                         postmortem_reason reason) {
 
-void BusFault_Handler(void) {
-    LOG_CRITICAL("BUSFAULT.");
-    while (1) {
-    }
-}
+    const uint32_t fault[4] = {SCB->CFSR, SCB->HFSR, SCB->MMFAR, SCB->BFAR};
+    postmortem_save_fault(reason, frame, fault);
 
-void UsageFault_Handler(void) {
-    LOG_CRITICAL("USAGEFAULT.");
-    while (1) {
-    }
+    LOG_CRITICAL("FAULT %u at 0x%08x, CFSR 0x%08x HFSR 0x%08x.", reason,
+                 frame[6], fault[0], fault[1]);
+
+    // Recover, the next boot reports the record
+    NVIC_SystemReset();
 }
 
+FAULT_HANDLER(HardFault_Handler, POSTMORTEM_REASON_HARDFAULT)
+FAULT_HANDLER(MemManage_Handler, POSTMORTEM_REASON_MEMMANAGE)
+FAULT_HANDLER(BusFault_Handler, POSTMORTEM_REASON_BUSFAULT)
+FAULT_HANDLER(UsageFault_Handler, POSTMORTEM_REASON_USAGEFAULT)
+
 void SVC_Handler(void) { LOG_TRACE("SVC Handler triggered."); }
 
 void DebugMon_Handler(void) { LOG_TRACE("DebugMon Handler triggered."); }
@@ -1,61 +1,229 @@
 #include "keyboard.h"
 
+#include "capture.h"
+#include "combo.h"
+#include "dks.h"
 #include "eeprom.h"
+#include "gamepad.h"
 #include "hal_systick.h"
 #include "keys.h"
 #include "logging.h"
+#include "macro.h"
 #include "memory_map.h"
 #include "pinout.h"
+#include "postmortem.h"
+#include "predict.h"
+#include "socd.h"
+#include "sof_sync.h"
+#include "split_link.h"
+#include "telemetry.h"
+#include "watchdog.h"
 
 #include "usb/usbd_hid.h"
 
 static uint8_t hid_buff[HID_BUFFER_SIZE];
 static uint8_t pressed_amount = 0;
 
-static uint8_t fn_buff[HID_BUFFER_SIZE - 2];
-static uint8_t fn_pressed_amount = 0;
-static bool fn_pressed;
+// Local and remote keys, then combos
+#define KB_VIRTUAL_KEY_COUNT (KB_TOTAL_KEY_COUNT + KB_COMBO_MAX)
+
+// Actions of the pressed keys, resolved when they were pressed
+static uint16_t key_actions[KB_VIRTUAL_KEY_COUNT];
+// Pressed since the last report, release is delayed so the press gets reported
+static bool key_pressed_fresh[KB_VIRTUAL_KEY_COUNT];
+static bool key_release_deferred[KB_VIRTUAL_KEY_COUNT];
+
+_Static_assert(KB_LAYER_COUNT <= 8U, "Layer state is an 8-bit mask");
+
+// Layer 0 is always active
+static uint8_t layers_momentary = 0U;
+static uint8_t layers_toggled = 0U;
+static uint8_t layers_active = 0x01U;
+
+// Layer keys seen during the current poll
+static uint8_t layer_keys_momentary = 0U;
+static uint8_t layer_keys_toggle = 0U;
+static uint8_t layer_keys_toggle_previous = 0U;
 
 static uint8_t modifier_map[8] = {0x01, 0x02, 0x04, 0x08,
                                   0x10, 0x20, 0x40, 0x80};
 
 static ykb_protocol_t values_request;
 static ykb_protocol_t *values_request_ptr;
-static communication_source values_request_src;
+static transport_t *values_request_transport;
+
+static uint32_t config_hashes[KB_CONFIG_SECTION_COUNT];
 
 typedef struct PACKED {
 
-    kb_state_t state;
+    kb_profile_t profiles[KB_PROFILE_COUNT];
+
+    // Shared by all profiles
+    macro_step_t macros[KB_MACRO_STEPS_MAX];
+    // Steps set by `kb_set_macros`, the cleared ones after them are no macros
+    uint16_t macro_step_count;
+
+    uint8_t default_profile;
 
     uint16_t crc16;
 
 } kb_eeprom_t;
 
+// Also serves as the RAM cache of all profiles
+static kb_eeprom_t kb_eeprom;
+static bool profiles_loaded = false;
+
+static uint8_t active_profile = 0U;
+
+// Keys driven by DKS instead of their mappings
+static kb_key_mask_t dks_keys = 0U;
+
+static uint16_t profile_key = KB_PROFILE_NEXT;
+static bool profile_key_pressed = false;
+static bool profile_key_was_pressed = false;
+
+// Reports of the extra usage pages, collected during the poll
+static uint16_t consumer_usage = 0U;
+static uint16_t consumer_usage_sent = 0U;
+
+static uint8_t system_usage = 0U;
+static uint8_t system_usage_sent = 0U;
+
+static uint8_t mouse_buttons = 0U;
+static uint8_t mouse_buttons_sent = 0U;
+static int8_t mouse_x = 0;
+static int8_t mouse_y = 0;
+static int8_t mouse_wheel = 0;
+static uint32_t mouse_move_time = 0U;
+
 #define EEPROM_KB_STATE_ADDR EEPROM_START_ADDRESS
 
+// Per-key updates are appended after the saved state, one flash double word
+// per record, and replayed on top of it on load. Full save erases the journal.
+typedef struct PACKED {
+
+    kb_key_field_update_t update;
+
+    uint8_t profile;
+    uint8_t reserved;
+
+    uint16_t crc16;
+
+} kb_journal_record_t;
+
+_Static_assert(sizeof(kb_journal_record_t) == sizeof(uint64_t),
+               "Journal record has to be a single flash double word");
+
+#define EEPROM_KB_JOURNAL_ADDR                                                 \
+    (EEPROM_KB_STATE_ADDR + ((sizeof(kb_eeprom_t) + 7U) & ~7U))
+
+#define EEPROM_KB_JOURNAL_END_ADDR (EEPROM_START_ADDRESS + eeprom_get_size())
+
+// Address of the next free journal record, 0 if the saved state is not valid
+static uint32_t journal_address = 0U;
+
 kb_state_t kb_state = {
     .settings =
         {
             .mode = KB_MODE_NORMAL,
             .adc_sampling_time = KB_ADC_SAMPLING_DEFAULT,
             .key_polling_rate = KB_DEFAULT_POLLING_RATE,
+            .tapping_term = TAP_HOLD_TERM_DEFAULT,
+            .tap_hold_policy = TAP_HOLD_POLICY_DEFAULT,
+            .predictive_actuation = false,
         },
 };
 
+static uint16_t kb_key_action(uint8_t index) {
+    if (index < KB_TOTAL_KEY_COUNT) {
+        return kb_state.keymap[index];
+    }
+    return combo_get_action(index - KB_TOTAL_KEY_COUNT);
+}
+
+static void kb_key_resolved(uint8_t index, bool pressed, uint16_t action) {
+    if (index >= KB_VIRTUAL_KEY_COUNT) {
+        return;
+    }
+
+    if (pressed) {
+        if (KB_ACTION_TYPE(action) == KB_ACTION_TYPE_MACRO) {
+            macro_play(KB_ACTION_PAYLOAD(action));
+        }
+        key_actions[index] = action;
+        key_pressed_fresh[index] = true;
+        key_release_deferred[index] = false;
+        return;
+    }
+
+    if (key_pressed_fresh[index]) {
+        key_release_deferred[index] = true;
+        return;
+    }
+
+    key_actions[index] = KEY_NOKEY;
+}
+
 void kb_super_init() {
+    tap_hold_init(kb_key_action, kb_key_resolved);
+
 #ifdef PIN_CAPSLOCK_LED
     gpio_turn_on_port(PIN_CAPSLOCK_LED.gpio);
     gpio_set_mode(PIN_CAPSLOCK_LED, GPIO_MODE_OUTPUT);
 #endif // PIN_CAPSLOCK_LED
 }
 
+static void kb_profile_store(kb_profile_t *profile) {
+    memcpy(&profile->settings, &kb_state.settings, sizeof(kb_settings_t));
+    memcpy(profile->key_thresholds, kb_state.key_thresholds,
+           sizeof(profile->key_thresholds));
+    memcpy(profile->min_thresholds, kb_state.min_thresholds,
+           sizeof(profile->min_thresholds));
+    memcpy(profile->max_thresholds, kb_state.max_thresholds,
+           sizeof(profile->max_thresholds));
+    memcpy(profile->mappings, kb_state.mappings, sizeof(profile->mappings));
+}
+
+static void kb_compile_dks(const kb_profile_t *profile) {
+    dks_compile(profile->dks, profile->dks_count, kb_state.min_thresholds,
+                kb_state.max_thresholds);
+
+    dks_keys = 0U;
+    for (uint8_t i = 0; i < profile->dks_count; i++) {
+        dks_keys |= KB_KEY_BIT(profile->dks[i].key_index);
+    }
+}
+
+// Everything precomputed from the thresholds in `kb_state`
+static void kb_compile_thresholds(const kb_profile_t *profile) {
+    kb_compile_dks(profile);
+    gamepad_compile(kb_state.min_thresholds, kb_state.max_thresholds);
+    predict_compile(kb_state.key_thresholds, kb_state.min_thresholds,
+                    kb_state.max_thresholds);
+}
+
+static void kb_profile_load(const kb_profile_t *profile) {
+    memcpy(&kb_state.settings, &profile->settings, sizeof(kb_settings_t));
+    memcpy(kb_state.key_thresholds, profile->key_thresholds,
+           sizeof(kb_state.key_thresholds));
+    memcpy(kb_state.min_thresholds, profile->min_thresholds,
+           sizeof(kb_state.min_thresholds));
+    memcpy(kb_state.max_thresholds, profile->max_thresholds,
+           sizeof(kb_state.max_thresholds));
+    memcpy(kb_state.mappings, profile->mappings, sizeof(kb_state.mappings));
+
+    tap_hold_configure(kb_state.settings.tapping_term,
+                       kb_state.settings.tap_hold_policy);
+    kb_compile_thresholds(profile);
+}
+
 static inline void kb_save_to_eeprom() {
 
     hal_err err;
 
-    kb_eeprom_t to_save = {
-        .state = kb_state,
-        .crc16 = ykb_crc16((uint8_t *)&kb_state, sizeof(kb_state_t))};
+    kb_profile_store(&kb_eeprom.profiles[active_profile]);
+    kb_eeprom.crc16 = ykb_crc16((uint8_t *)&kb_eeprom,
+                                sizeof(kb_eeprom) - sizeof(kb_eeprom.crc16));
 
     err = eeprom_clear();
     if (err) {
@@ -64,38 +232,221 @@ static inline void kb_save_to_eeprom() {
     }
     LOG_TRACE("EEPROM cleared.");
 
-    err = eeprom_save(EEPROM_KB_STATE_ADDR, &to_save, sizeof(to_save));
+    journal_address = 0U;
+
+    err = eeprom_save(EEPROM_KB_STATE_ADDR, &kb_eeprom, sizeof(kb_eeprom));
     if (err) {
         LOG_ERROR("Unable to save to EEPROM: %d", err);
         return;
     }
 
+    journal_address = EEPROM_KB_JOURNAL_ADDR;
+
     LOG_DEBUG("Successfully saved to EEPROM.");
 }
 
-bool kb_load_state_from_eeprom() {
+static bool kb_key_field_update_valid(const kb_key_field_update_t *update) {
+
+    if (update->key_index >= KB_TOTAL_KEY_COUNT) {
+        return false;
+    }
+
+    switch (update->field) {
+    case KB_KEY_FIELD_THRESHOLD:
+        return update->key_index < KB_KEY_COUNT && update->value >= 1U &&
+               update->value <= 100U;
+    case KB_KEY_FIELD_MIN_THRESHOLD:
+    case KB_KEY_FIELD_MAX_THRESHOLD:
+        return update->key_index < KB_KEY_COUNT;
+    case KB_KEY_FIELD_MAPPING:
+        return true;
+    default:
+        return update->field < KB_KEY_FIELD_COUNT;
+    }
+}
+
+static int16_t kb_layer_entry_find(const kb_profile_t *profile, uint8_t layer,
+                                   uint8_t key_index) {
+    for (uint8_t i = 0; i < profile->layer_entry_count; i++) {
+        const kb_layer_entry_t *entry = &profile->layer_entries[i];
+        if (entry->layer == layer && entry->key_index == key_index) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void kb_layer_entry_set(kb_profile_t *profile, uint8_t layer,
+                               uint8_t key_index, uint16_t key_code) {
+
+    int16_t i = kb_layer_entry_find(profile, layer, key_index);
+
+    if (key_code == KEY_TRANSPARENT) {
+        if (i < 0) {
+            return;
+        }
+        // Order doesn't matter, move the last one in its place
+        profile->layer_entry_count--;
+        profile->layer_entries[i] =
+            profile->layer_entries[profile->layer_entry_count];
+        return;
+    }
+
+    if (i >= 0) {
+        profile->layer_entries[i].key_code = key_code;
+        return;
+    }
+
+    if (profile->layer_entry_count >= KB_LAYER_ENTRIES_MAX) {
+        LOG_ERROR("No space left for layer %d key %d.", layer, key_index);
+        return;
+    }
+
+    profile->layer_entries[profile->layer_entry_count] = (kb_layer_entry_t){
+        .layer = layer, .key_index = key_index, .key_code = key_code};
+    profile->layer_entry_count++;
+}
+
+static kb_config_section
+kb_apply_key_field_update(kb_profile_t *profile,
+                          const kb_key_field_update_t *update) {
+
+    uint8_t index = update->key_index;
+
+    switch (update->field) {
+    case KB_KEY_FIELD_THRESHOLD:
+        profile->key_thresholds[index] = update->value;
+        return KB_CONFIG_SECTION_THRESHOLDS;
+    case KB_KEY_FIELD_MIN_THRESHOLD:
+        profile->min_thresholds[index] = update->value;
+        return KB_CONFIG_SECTION_THRESHOLDS;
+    case KB_KEY_FIELD_MAX_THRESHOLD:
+        profile->max_thresholds[index] = update->value;
+        return KB_CONFIG_SECTION_THRESHOLDS;
+    case KB_KEY_FIELD_MAPPING:
+        profile->mappings[index] = update->value;
+        return KB_CONFIG_SECTION_MAPPINGS;
+    default:
+        kb_layer_entry_set(profile,
+                           update->field - KB_KEY_FIELD_LAYER_MAPPING + 1U,
+                           index, update->value);
+        return KB_CONFIG_SECTION_LAYERS;
+    }
+}
+
+static bool kb_journal_append(const kb_key_field_update_t *update) {
+
+    if (journal_address == 0U ||
+        journal_address + sizeof(kb_journal_record_t) >
+            EEPROM_KB_JOURNAL_END_ADDR) {
+        return false;
+    }
+
+    kb_journal_record_t record = {
+        .update = *update, .profile = active_profile, .reserved = 0U};
+    record.crc16 = ykb_crc16((uint8_t *)&record,
+                             sizeof(record) - sizeof(record.crc16));
+
+    hal_err err = eeprom_save(journal_address, &record, sizeof(record));
+    if (err) {
+        LOG_ERROR("Unable to append to EEPROM journal: %d", err);
+        // Programmed double word state is unknown, don't reuse it
+        journal_address = EEPROM_KB_JOURNAL_END_ADDR;
+        return false;
+    }
+
+    journal_address += sizeof(kb_journal_record_t);
+
+    return true;
+}
+
+static void kb_journal_replay() {
 
     hal_err err;
 
-    kb_eeprom_t to_get = {0};
+    kb_journal_record_t record;
+    uint32_t address = EEPROM_KB_JOURNAL_ADDR;
+    uint16_t replayed = 0U;
+
+    for (; address + sizeof(record) <= EEPROM_KB_JOURNAL_END_ADDR;
+         address += sizeof(record)) {
+
+        err = eeprom_get(address, &record, sizeof(record));
+        if (err) {
+            LOG_ERROR("Unable to read EEPROM journal: %d", err);
+            address = EEPROM_KB_JOURNAL_END_ADDR;
+            break;
+        }
+
+        if (record.update.field == 0xFFU) {
+            // Erased, end of the journal
+            break;
+        }
+
+        uint16_t crc16 = ykb_crc16((uint8_t *)&record,
+                                   sizeof(record) - sizeof(record.crc16));
+        if (crc16 != record.crc16 || record.profile >= KB_PROFILE_COUNT ||
+            !kb_key_field_update_valid(&record.update)) {
+            // Probably interrupted write, next update will compact
+            LOG_ERROR("Broken EEPROM journal record at 0x%x", address);
+            address = EEPROM_KB_JOURNAL_END_ADDR;
+            break;
+        }
+
+        kb_apply_key_field_update(&kb_eeprom.profiles[record.profile],
+                                  &record.update);
+        replayed++;
+    }
+
+    journal_address = address;
+
+    LOG_DEBUG("Replayed %d EEPROM journal records.", replayed);
+}
+
+bool kb_load_state_from_eeprom() {
+
+    hal_err err;
 
     LOG_TRACE("Loading state from EEPROM...");
-    err = eeprom_get(EEPROM_KB_STATE_ADDR, &to_get, sizeof(to_get));
+    err = eeprom_get(EEPROM_KB_STATE_ADDR, &kb_eeprom, sizeof(kb_eeprom));
     if (err) {
         LOG_ERROR("Unable to get from EEPROM: %d", err);
         return false;
     }
     LOG_TRACE("Loaded state from EEPROM.");
 
-    uint16_t crc16 = ykb_crc16((uint8_t *)&to_get.state, sizeof(kb_state_t));
-    if (crc16 != to_get.crc16) {
+    uint16_t crc16 = ykb_crc16((uint8_t *)&kb_eeprom,
+                               sizeof(kb_eeprom) - sizeof(kb_eeprom.crc16));
+    if (crc16 != kb_eeprom.crc16) {
         LOG_DEBUG("Wrong CRC16 EEPROM signature (%d != %d), aborting", crc16,
-                  to_get.crc16);
+                  kb_eeprom.crc16);
         return false;
     }
     LOG_TRACE("EEPROM CRC16 is correct.");
 
-    memcpy(&kb_state, &to_get.state, sizeof(kb_state_t));
+    if (kb_eeprom.default_profile >= KB_PROFILE_COUNT) {
+        kb_eeprom.default_profile = 0U;
+    }
+
+    for (uint8_t i = 0; i < KB_PROFILE_COUNT; i++) {
+        kb_profile_t *profile = &kb_eeprom.profiles[i];
+        if (profile->layer_entry_count > KB_LAYER_ENTRIES_MAX) {
+            profile->layer_entry_count = 0U;
+        }
+        if (profile->dks_count > KB_DKS_MAX) {
+            profile->dks_count = 0U;
+        }
+        for (uint8_t j = 0; j < profile->dks_count; j++) {
+            if (!dks_valid(&profile->dks[j])) {
+                profile->dks_count = 0U;
+                break;
+            }
+        }
+    }
+
+    kb_journal_replay();
+
+    profiles_loaded = true;
 
     LOG_DEBUG("Successfully retreived kb_state from EEPROM.");
 
@@ -111,59 +462,387 @@ static inline void toggle_capslock_led() {
 }
 #endif // PIN_CAPSLOCK_LED
 
-void kb_process_key(uint8_t key) {
+// Flattens the active layers into `kb_state.keymap`, so the scan path resolves
+// a key with a single load
+static void kb_compile_keymap() {
 
-    if (pressed_amount >= HID_BUFFER_SIZE - 2) {
-        return;
+    const kb_profile_t *profile = &kb_eeprom.profiles[active_profile];
+
+    uint8_t key_layers[KB_TOTAL_KEY_COUNT] = {0};
+
+    memcpy(kb_state.keymap, kb_state.mappings, sizeof(kb_state.keymap));
+
+    for (uint8_t i = 0; i < profile->layer_entry_count; i++) {
+        const kb_layer_entry_t *entry = &profile->layer_entries[i];
+
+        if (entry->key_index >= KB_TOTAL_KEY_COUNT ||
+            entry->layer >= KB_LAYER_COUNT ||
+            !(layers_active & (1U << entry->layer)) ||
+            entry->layer < key_layers[entry->key_index]) {
+            continue;
+        }
+
+        kb_state.keymap[entry->key_index] = entry->key_code;
+        key_layers[entry->key_index] = entry->layer;
     }
+}
+
+static void kb_update_layers() {
+
+    // Toggle on press only, keys are reported on every poll while held
+    layers_toggled ^= layer_keys_toggle & ~layer_keys_toggle_previous;
+    layer_keys_toggle_previous = layer_keys_toggle;
+
+    layers_momentary = layer_keys_momentary;
+
+    layer_keys_momentary = 0U;
+    layer_keys_toggle = 0U;
 
-    if (key == KEY_FN) {
-        fn_pressed = true;
+    uint8_t active = 0x01U | layers_momentary | layers_toggled;
+    if (active == layers_active) {
         return;
     }
 
-    if (key == KEY_LAYER) {
-        // TODO
-        return;
+    layers_active = active;
+    kb_compile_keymap();
+}
+
+static void kb_reset_layers() {
+    layers_momentary = 0U;
+    layers_toggled = 0U;
+    layers_active = 0x01U;
+    layer_keys_momentary = 0U;
+    layer_keys_toggle = 0U;
+    layer_keys_toggle_previous = 0U;
+}
+
+static void kb_activate_profile(uint8_t profile) {
+    kb_profile_store(&kb_eeprom.profiles[active_profile]);
+
+    active_profile = profile;
+
+    kb_profile_load(&kb_eeprom.profiles[active_profile]);
+    kb_reset_layers();
+    kb_compile_keymap();
+    kb_update_config_hashes();
+}
+
+void kb_init_profiles() {
+    if (!profiles_loaded) {
+        // Left as read by the failed load, e.g. erased flash with every count
+        // at 0xFF
+        memset(&kb_eeprom, 0, sizeof(kb_eeprom));
+        for (uint8_t i = 0; i < KB_PROFILE_COUNT; i++) {
+            kb_profile_store(&kb_eeprom.profiles[i]);
+        }
+        kb_eeprom.default_profile = 0U;
+        profiles_loaded = true;
+    }
+
+    if (!macro_validate(kb_eeprom.macros, kb_eeprom.macro_step_count)) {
+        memset(kb_eeprom.macros, 0, sizeof(kb_eeprom.macros));
+        kb_eeprom.macro_step_count = 0U;
+    }
+    macro_init(kb_eeprom.macros, kb_eeprom.macro_step_count);
+
+    active_profile = kb_eeprom.default_profile;
+    kb_profile_load(&kb_eeprom.profiles[active_profile]);
+    kb_reset_layers();
+    kb_compile_keymap();
+    kb_update_config_hashes();
+
+    LOG_DEBUG("Profile %d activated.", active_profile);
+}
+
+bool kb_set_profile(uint8_t profile, bool make_default) {
+    if (profile >= KB_PROFILE_COUNT) {
+        LOG_ERROR("Profile %d does not exist.", profile);
+        return false;
+    }
+
+    if (profile != active_profile) {
+        kb_activate_profile(profile);
+        LOG_DEBUG("Switched to profile %d.", profile);
+    }
+
+    if (make_default && kb_eeprom.default_profile != profile) {
+        kb_eeprom.default_profile = profile;
+        kb_save_to_eeprom();
     }
 
+    return true;
+}
+
+uint8_t kb_get_active_profile() { return active_profile; }
+
+uint8_t kb_get_default_profile() { return kb_eeprom.default_profile; }
+
+static void kb_action_key(uint16_t usage) {
+
 #ifdef PIN_CAPSLOCK_LED
-    if (key == KEY_CAPSLOCK) {
+    if (usage == KEY_CAPSLOCK) {
         toggle_capslock_led();
     }
 #endif // PIN_CAPSLOCK_LED
 
-    if (fn_pressed && fn_pressed_amount < HID_BUFFER_SIZE - 2) {
+    if (usage < KEY_LEFTCONTROL) {
+        // Regular
+
+        if (pressed_amount >= HID_BUFFER_SIZE - 2) {
+            return;
+        }
 
-        fn_buff[fn_pressed_amount] = key;
-        fn_pressed_amount++;
+        hid_buff[2 + pressed_amount] = usage;
+        pressed_amount++;
 
         return;
     }
 
-    if (key < KEY_LEFTCONTROL) {
-        // Regular
+    if (usage <= KEY_RIGHTGUI) {
+        // Modifiers
 
-        hid_buff[2 + pressed_amount] = key;
-        pressed_amount++;
+        hid_buff[0] |= modifier_map[usage - KEY_LEFTCONTROL];
+        return;
+    }
+}
 
+static void kb_action_consumer(uint16_t usage) { consumer_usage = usage; }
+
+static void kb_action_system(uint16_t usage) { system_usage = usage; }
+
+static void kb_action_mouse(uint16_t op) {
+    switch (op) {
+    case KB_MOUSE_BUTTON1:
+    case KB_MOUSE_BUTTON2:
+    case KB_MOUSE_BUTTON3:
+    case KB_MOUSE_BUTTON4:
+    case KB_MOUSE_BUTTON5:
+        mouse_buttons |= 1U << (op - KB_MOUSE_BUTTON1);
+        break;
+    case KB_MOUSE_UP:
+        mouse_y = -1;
+        break;
+    case KB_MOUSE_DOWN:
+        mouse_y = 1;
+        break;
+    case KB_MOUSE_LEFT:
+        mouse_x = -1;
+        break;
+    case KB_MOUSE_RIGHT:
+        mouse_x = 1;
+        break;
+    case KB_MOUSE_WHEEL_UP:
+        mouse_wheel = 1;
+        break;
+    case KB_MOUSE_WHEEL_DOWN:
+        mouse_wheel = -1;
+        break;
+    }
+}
+
+static void kb_action_layer(uint16_t payload) {
+
+    uint8_t layer = payload & 0xFF;
+
+    if (layer >= KB_LAYER_COUNT) {
         return;
     }
 
-    if (key < KEY_FN) {
-        // Modifiers
+    switch (payload >> 8) {
+    case KB_LAYER_OP_MOMENTARY:
+        layer_keys_momentary |= 1U << layer;
+        break;
+    case KB_LAYER_OP_TOGGLE:
+        layer_keys_toggle |= 1U << layer;
+        break;
+    }
+}
+
+static void kb_action_profile(uint16_t profile) {
+    profile_key = profile;
+    profile_key_pressed = true;
+}
+
+static void kb_action_mods(uint16_t mods) { hid_buff[0] |= mods & 0xFF; }
+
+typedef void (*kb_action_handler)(uint16_t payload);
+
+static const kb_action_handler action_handlers[KB_ACTION_TYPE_COUNT] = {
+    [KB_ACTION_TYPE_KEY] = kb_action_key,
+    [KB_ACTION_TYPE_CONSUMER] = kb_action_consumer,
+    [KB_ACTION_TYPE_SYSTEM] = kb_action_system,
+    [KB_ACTION_TYPE_MOUSE] = kb_action_mouse,
+    [KB_ACTION_TYPE_LAYER] = kb_action_layer,
+    [KB_ACTION_TYPE_PROFILE] = kb_action_profile,
+    [KB_ACTION_TYPE_MODS] = kb_action_mods,
+    // Macros are started on press, tap-hold actions are resolved into one of
+    // the above on press
+};
+
+void kb_process_key(uint16_t action) {
+
+    kb_action_handler handler = action_handlers[KB_ACTION_TYPE(action)];
+
+    if (handler) {
+        handler(KB_ACTION_PAYLOAD(action));
+    }
+}
+
+#if KB_REMOTE_KEY_COUNT > 0
+// ADC values of the local keys followed by those of the remote ones
+static uint16_t key_values[KB_TOTAL_KEY_COUNT];
+#endif // KB_REMOTE_KEY_COUNT
+
+void kb_update_keys(kb_key_mask_t pressed) {
+    if (kb_state.settings.predictive_actuation &&
+        kb_state.settings.mode == KB_MODE_NORMAL) {
+        pressed = predict_update(pressed, kb_state.current_values);
+    }
+#if defined(LEFT) && defined(SPLIT_LINK_ENABLED) && SPLIT_LINK_ENABLED == 1
+    // Physical state, the primary half maps it with its own profile
+    split_link_send_keys(pressed, kb_state.current_values);
+#endif // LEFT && SPLIT_LINK_ENABLED
+    dks_scan(kb_state.current_values);
+    pressed &= ~dks_keys;
+
+    kb_key_set_t keys = {.words = {pressed}};
+    const uint16_t *values = kb_state.current_values;
+
+#if KB_REMOTE_KEY_COUNT > 0
+    kb_key_mask_t remote = split_link_take_remote_keys();
+    while (remote) {
+        uint8_t index = __builtin_ctzll(remote);
+        remote &= remote - 1U;
+        kb_key_set_add(&keys, KB_REMOTE_KEY(index));
+    }
+
+    // Remote values stay 0 without SPLIT_LINK_ANALOG_ENABLED
+    memcpy(key_values, kb_state.current_values,
+           sizeof(kb_state.current_values));
+    memcpy(&key_values[KB_KEY_COUNT], split_link_get_remote_values(),
+           KB_REMOTE_KEY_COUNT * sizeof(uint16_t));
+    values = key_values;
+#endif // KB_REMOTE_KEY_COUNT
+
+    keys = socd_resolve(keys, values);
+    combo_scan(keys, systick_get_us());
+}
+
+static void kb_process_pressed_keys() {
+
+    tap_hold_task(systick_get_us());
+
+    for (uint8_t i = 0; i < KB_VIRTUAL_KEY_COUNT; i++) {
+        if (key_actions[i] != KEY_NOKEY) {
+            kb_process_key(key_actions[i]);
+        }
+
+        key_pressed_fresh[i] = false;
+        if (key_release_deferred[i]) {
+            key_actions[i] = KEY_NOKEY;
+            key_release_deferred[i] = false;
+        }
+    }
+
+    dks_task(kb_process_key);
+    macro_task(systick_get_tick(), kb_process_key);
+}
+
+// FNV-1a
+#define KB_HASH_SEED 0x811C9DC5U
+#define KB_HASH_PRIME 0x01000193U
+
+static uint32_t kb_hash(uint32_t hash, const void *data, size_t size) {
+    const uint8_t *bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= KB_HASH_PRIME;
+    }
+    return hash;
+}
+
+static void kb_update_config_hash(kb_config_section section) {
+
+    uint32_t hash = KB_HASH_SEED;
+    const kb_profile_t *profile;
 
-        hid_buff[0] |= modifier_map[key - KEY_LEFTCONTROL];
+    switch (section) {
+    case KB_CONFIG_SECTION_SETTINGS:
+        hash = kb_hash(hash, &kb_state.settings, sizeof(kb_settings_t));
+        break;
+    case KB_CONFIG_SECTION_MAPPINGS:
+        hash = kb_hash(hash, kb_state.mappings, sizeof(kb_state.mappings));
+        break;
+    case KB_CONFIG_SECTION_THRESHOLDS:
+        hash = kb_hash(hash, kb_state.key_thresholds,
+                       sizeof(kb_state.key_thresholds));
+        hash = kb_hash(hash, kb_state.min_thresholds,
+                       sizeof(kb_state.min_thresholds));
+        hash = kb_hash(hash, kb_state.max_thresholds,
+                       sizeof(kb_state.max_thresholds));
+        break;
+    case KB_CONFIG_SECTION_MACROS:
+        hash = kb_hash(hash, &kb_eeprom.macro_step_count,
+                       sizeof(kb_eeprom.macro_step_count));
+        hash = kb_hash(hash, kb_eeprom.macros, sizeof(kb_eeprom.macros));
+        break;
+    case KB_CONFIG_SECTION_LAYERS:
+        profile = &kb_eeprom.profiles[active_profile];
+        hash = kb_hash(hash, &profile->layer_entry_count, sizeof(uint8_t));
+        hash = kb_hash(hash, profile->layer_entries,
+                       sizeof(kb_layer_entry_t) * profile->layer_entry_count);
+        break;
+    case KB_CONFIG_SECTION_DKS:
+        profile = &kb_eeprom.profiles[active_profile];
+        hash = kb_hash(hash, &profile->dks_count, sizeof(uint8_t));
+        hash = kb_hash(hash, profile->dks,
+                       sizeof(kb_dks_t) * profile->dks_count);
+        break;
+    default:
         return;
     }
+
+    config_hashes[section] = hash;
 }
 
-static inline void kb_process_fn_buff() {
-    // TODO
+void kb_update_config_hashes() {
+    for (uint8_t i = 0; i < KB_CONFIG_SECTION_COUNT; i++) {
+        kb_update_config_hash(i);
+    }
+}
 
-    memset(fn_buff, 0, HID_BUFFER_SIZE - 2);
-    fn_pressed = false;
-    fn_pressed_amount = 0;
+uint32_t kb_get_config_hash(kb_config_section section) {
+    if (section >= KB_CONFIG_SECTION_COUNT) {
+        return 0U;
+    }
+    return config_hashes[section];
+}
+
+size_t kb_get_config_section(kb_config_section section, uint8_t *buffer) {
+    switch (section) {
+    case KB_CONFIG_SECTION_SETTINGS:
+        kb_get_settings(buffer);
+        return sizeof(kb_settings_t);
+    case KB_CONFIG_SECTION_MAPPINGS:
+        kb_get_mappings(buffer);
+        return sizeof(kb_state.mappings);
+    case KB_CONFIG_SECTION_THRESHOLDS:
+        kb_get_thresholds(buffer);
+        return KB_THRESHOLDS_SIZE;
+    case KB_CONFIG_SECTION_LAYERS:
+        memcpy(buffer, &kb_eeprom.profiles[active_profile].layer_entry_count,
+               KB_LAYERS_SIZE);
+        return KB_LAYERS_SIZE;
+    case KB_CONFIG_SECTION_MACROS:
+        memcpy(buffer, kb_eeprom.macros, sizeof(kb_eeprom.macros));
+        return sizeof(kb_eeprom.macros);
+    case KB_CONFIG_SECTION_DKS:
+        memcpy(buffer, &kb_eeprom.profiles[active_profile].dks_count,
+               KB_DKS_SIZE);
+        return KB_DKS_SIZE;
+    default:
+        return 0U;
+    }
 }
 
 void kb_get_settings(uint8_t *buffer) {
@@ -180,10 +859,10 @@ void kb_get_mappings(uint8_t *buffer) {
     memcpy(buffer, kb_state.mappings, sizeof(kb_state.mappings));
 }
 
-void kb_request_values(communication_source source, ykb_protocol_t *protocol) {
+void kb_request_values(transport_t *transport, ykb_protocol_t *protocol) {
     memcpy(&values_request, protocol, sizeof(ykb_protocol_t));
     values_request_ptr = &values_request;
-    values_request_src = source;
+    values_request_transport = transport;
 }
 
 void kb_get_thresholds(uint8_t *buffer) {
@@ -203,14 +882,21 @@ void kb_set_settings(kb_settings_t *new_settings) {
         return;
     }
     memcpy(&kb_state.settings, new_settings, sizeof(kb_settings_t));
+    tap_hold_configure(kb_state.settings.tapping_term,
+                       kb_state.settings.tap_hold_policy);
+    // Predictive actuation might have been switched on, drop stale samples
+    kb_compile_thresholds(&kb_eeprom.profiles[active_profile]);
+    kb_update_config_hash(KB_CONFIG_SECTION_SETTINGS);
     kb_save_to_eeprom();
 }
 
-void kb_set_mappings(uint8_t *new_mappings) {
+void kb_set_mappings(uint16_t *new_mappings) {
     if (!new_mappings) {
         return;
     }
     memcpy(kb_state.mappings, new_mappings, sizeof(kb_state.mappings));
+    kb_compile_keymap();
+    kb_update_config_hash(KB_CONFIG_SECTION_MAPPINGS);
     kb_save_to_eeprom();
 }
 
@@ -220,7 +906,151 @@ void kb_set_thresholds(uint8_t *new_thresholds) {
     }
     memcpy(kb_state.key_thresholds, new_thresholds,
            sizeof(kb_state.key_thresholds));
+    kb_compile_thresholds(&kb_eeprom.profiles[active_profile]);
+    kb_update_config_hash(KB_CONFIG_SECTION_THRESHOLDS);
+    kb_save_to_eeprom();
+}
+
+bool kb_set_key_fields(const kb_key_field_update_t *updates, uint8_t amount) {
+    if (!updates) {
+        return false;
+    }
+
+    kb_profile_t *profile = &kb_eeprom.profiles[active_profile];
+    uint8_t new_layer_entries = 0U;
+
+    for (uint8_t i = 0; i < amount; i++) {
+        const kb_key_field_update_t *update = &updates[i];
+
+        if (!kb_key_field_update_valid(update)) {
+            LOG_ERROR("Invalid key field update %d (key %d, field %d)", i,
+                      update->key_index, update->field);
+            return false;
+        }
+
+        if (update->field >= KB_KEY_FIELD_LAYER_MAPPING &&
+            update->value != KEY_TRANSPARENT &&
+            kb_layer_entry_find(
+                profile, update->field - KB_KEY_FIELD_LAYER_MAPPING + 1U,
+                update->key_index) < 0) {
+            new_layer_entries++;
+        }
+    }
+
+    if (profile->layer_entry_count + new_layer_entries > KB_LAYER_ENTRIES_MAX) {
+        LOG_ERROR("Not enough space for %d new layer keys.", new_layer_entries);
+        return false;
+    }
+
+    kb_profile_store(profile);
+
+    uint8_t changed_sections = 0U;
+    for (uint8_t i = 0; i < amount; i++) {
+        changed_sections |=
+            1U << kb_apply_key_field_update(profile, &updates[i]);
+    }
+
+    kb_profile_load(profile);
+
+    if (changed_sections & ((1U << KB_CONFIG_SECTION_MAPPINGS) |
+                            (1U << KB_CONFIG_SECTION_LAYERS))) {
+        kb_compile_keymap();
+    }
+
+    for (uint8_t i = 0; i < KB_CONFIG_SECTION_COUNT; i++) {
+        if (changed_sections & (1U << i)) {
+            kb_update_config_hash(i);
+        }
+    }
+
+    for (uint8_t i = 0; i < amount; i++) {
+        if (!kb_journal_append(&updates[i])) {
+            // Journal is full or not there yet, full save includes the rest
+            LOG_DEBUG("EEPROM journal is full, compacting...");
+            kb_save_to_eeprom();
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool kb_set_macros(const uint8_t *new_macros, size_t size) {
+    if (!new_macros || size % sizeof(macro_step_t) != 0U ||
+        size > sizeof(kb_eeprom.macros)) {
+        return false;
+    }
+
+    const macro_step_t *steps = (const macro_step_t *)new_macros;
+    uint16_t amount = size / sizeof(macro_step_t);
+    if (!macro_validate(steps, amount)) {
+        LOG_ERROR("Invalid macros.");
+        return false;
+    }
+
+    memset(kb_eeprom.macros, 0, sizeof(kb_eeprom.macros));
+    memcpy(kb_eeprom.macros, new_macros, size);
+    kb_eeprom.macro_step_count = amount;
+    macro_init(kb_eeprom.macros, amount);
+
+    kb_update_config_hash(KB_CONFIG_SECTION_MACROS);
     kb_save_to_eeprom();
+
+    return true;
+}
+
+bool kb_set_dks(const kb_dks_t *dks) {
+    if (!dks || dks->key_index >= KB_KEY_COUNT) {
+        return false;
+    }
+
+    kb_profile_t *profile = &kb_eeprom.profiles[active_profile];
+
+    int16_t index = -1;
+    for (uint8_t i = 0; i < profile->dks_count; i++) {
+        if (profile->dks[i].key_index == dks->key_index) {
+            index = i;
+            break;
+        }
+    }
+
+    bool remove = true;
+    for (uint8_t i = 0; i < KB_DKS_POINTS; i++) {
+        if (dks->actions[i] != KEY_NOKEY) {
+            remove = false;
+            break;
+        }
+    }
+
+    if (remove) {
+        if (index < 0) {
+            return true;
+        }
+        // Order doesn't matter, move the last one in its place
+        profile->dks_count--;
+        profile->dks[index] = profile->dks[profile->dks_count];
+    } else {
+        if (!dks_valid(dks)) {
+            LOG_ERROR("Invalid DKS for key %d.", dks->key_index);
+            return false;
+        }
+        if (index < 0) {
+            if (profile->dks_count >= KB_DKS_MAX) {
+                LOG_ERROR("No space left for DKS of key %d.", dks->key_index);
+                return false;
+            }
+            index = profile->dks_count;
+            profile->dks_count++;
+        }
+        profile->dks[index] = *dks;
+    }
+
+    kb_compile_dks(profile);
+
+    kb_update_config_hash(KB_CONFIG_SECTION_DKS);
+    kb_save_to_eeprom();
+
+    return true;
 }
 
 void kb_calibrate(uint16_t *min_thresholds, uint16_t *max_thresholds) {
@@ -231,6 +1061,8 @@ void kb_calibrate(uint16_t *min_thresholds, uint16_t *max_thresholds) {
            sizeof(kb_state.min_thresholds));
     memcpy(kb_state.max_thresholds, max_thresholds,
            sizeof(kb_state.max_thresholds));
+    kb_compile_thresholds(&kb_eeprom.profiles[active_profile]);
+    kb_update_config_hash(KB_CONFIG_SECTION_THRESHOLDS);
     kb_save_to_eeprom();
 }
 
@@ -240,15 +1072,127 @@ extern USBD_HandleTypeDef hUsbDeviceFS;
 
 static uint32_t previous_poll_time = 0;
 
+// Report of the last scan not handed to the endpoint yet
+static bool report_pending = false;
+
+static void kb_send_extra_reports() {
+#if defined(USB_ENABLED) && USB_ENABLED == 1
+
+    uint8_t report[5];
+
+    if (consumer_usage != consumer_usage_sent) {
+        report[0] = HID_CONSUMER_REPORT_ID;
+        memcpy(&report[1], &consumer_usage, sizeof(consumer_usage));
+        if (USBD_HID_SendExtraReport(&hUsbDeviceFS, report, 3) == USBD_OK) {
+            consumer_usage_sent = consumer_usage;
+        }
+    }
+
+    if (system_usage != system_usage_sent) {
+        report[0] = HID_SYSTEM_REPORT_ID;
+        report[1] = system_usage;
+        if (USBD_HID_SendExtraReport(&hUsbDeviceFS, report, 2) == USBD_OK) {
+            system_usage_sent = system_usage;
+        }
+    }
+
+    // Movement is relative, it's repeated every KB_MOUSE_MOVE_INTERVAL while
+    // the key is held
+    bool mouse_moving = mouse_x || mouse_y || mouse_wheel;
+    uint32_t tick = systick_get_tick();
+
+    if (mouse_buttons != mouse_buttons_sent ||
+        (mouse_moving && tick - mouse_move_time >= KB_MOUSE_MOVE_INTERVAL)) {
+        report[0] = HID_MOUSE_REPORT_ID;
+        report[1] = mouse_buttons;
+        report[2] = (uint8_t)(mouse_x * KB_MOUSE_MOVE_STEP);
+        report[3] = (uint8_t)(mouse_y * KB_MOUSE_MOVE_STEP);
+        report[4] = (uint8_t)mouse_wheel;
+        if (USBD_HID_SendExtraReport(&hUsbDeviceFS, report, 5) == USBD_OK) {
+            mouse_buttons_sent = mouse_buttons;
+            if (mouse_moving) {
+                mouse_move_time = tick;
+            }
+        }
+    }
+
+#endif // USB_ENABLED
+}
+
+// Axes come from the same scan as the keyboard report, but go out on their own
+// endpoint
+static void kb_send_gamepad_report() {
+#if defined(USB_ENABLED) && USB_ENABLED == 1
+
+    if (!gamepad_update(kb_state.current_values)) {
+        return;
+    }
+
+    if (USBD_HID_SendReport(&hUsbDeviceFS, GAMEPAD_HID_EPIN_ADDR,
+                            (uint8_t *)gamepad_get_report(),
+                            sizeof(gamepad_report_t)) == USBD_OK) {
+        gamepad_report_sent();
+    }
+
+#endif // USB_ENABLED
+}
+
+// Synchronized to the USB frame while there are SOFs, see sof_sync.h
+static bool kb_scan_due() {
+#if defined(USB_ENABLED) && USB_ENABLED == 1
+    if (sof_sync_active()) {
+        return sof_sync_scan_due();
+    }
+#endif // USB_ENABLED
+
+    return systick_get_tick() - previous_poll_time >= KB_DEFAULT_POLLING_RATE;
+}
+
+static void kb_send_keyboard_report() {
+#if defined(USB_ENABLED) && USB_ENABLED == 1
+
+    // The report must not be collected before it's marked as armed
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (USBD_HID_SendReport(&hUsbDeviceFS, HID_EPIN_ADDR, hid_buff,
+                            HID_BUFFER_SIZE) == USBD_OK) {
+        sof_sync_report_armed();
+        report_pending = false;
+    }
+
+    __set_PRIMASK(primask);
+
+#endif // USB_ENABLED
+}
+
 void kb_handle() {
 
-    if (systick_get_tick() - previous_poll_time >= KB_DEFAULT_POLLING_RATE) {
+    if (kb_scan_due()) {
+
+        uint32_t scan_start = systick_get_us();
+        sof_sync_scan_started();
+
+        // Previous report never made it to the endpoint, this scan's replaces
+        // it
+        TELEMETRY_ADD(reports_dropped, report_pending);
 
         if (hid_buff[0] != KEY_NOKEY || hid_buff[2] != KEY_NOKEY) {
             memset(hid_buff, 0, HID_BUFFER_SIZE);
             pressed_amount = 0;
         }
 
+        consumer_usage = 0U;
+        system_usage = 0U;
+        mouse_buttons = 0U;
+        mouse_x = 0;
+        mouse_y = 0;
+        mouse_wheel = 0;
+
+#if defined(SPLIT_LINK_ENABLED) && SPLIT_LINK_ENABLED == 1
+        split_link_receive();
+#endif // SPLIT_LINK_ENABLED
+
         switch (kb_state.settings.mode) {
 
         case KB_MODE_NORMAL:
@@ -260,19 +1204,65 @@ void kb_handle() {
             break;
         }
 
-        if (fn_pressed) {
-            kb_process_fn_buff();
+        capture_frame(kb_state.current_values);
+
+        kb_process_pressed_keys();
+
+#if defined(SPLIT_LINK_ENABLED) && SPLIT_LINK_ENABLED == 1 &&                  \
+    SPLIT_LINK_PROTOCOL_ENABLED == 1
+        // After the scan, so protocol packets don't hold back key frames
+        split_link_flush();
+#endif // SPLIT_LINK_ENABLED && SPLIT_LINK_PROTOCOL_ENABLED
+
+        kb_update_layers();
+
+        if (profile_key_pressed && !profile_key_was_pressed) {
+            if (profile_key == KB_PROFILE_NEXT) {
+                kb_set_profile((active_profile + 1U) % KB_PROFILE_COUNT, false);
+            } else if (profile_key < KB_PROFILE_COUNT) {
+                kb_set_profile(profile_key, false);
+            }
+        }
+        profile_key_was_pressed = profile_key_pressed;
+        profile_key_pressed = false;
+
+        sof_sync_scan_complete();
+        telemetry_scan(systick_get_us() - scan_start);
+        postmortem_scan_complete();
+        report_pending = true;
+        kb_send_keyboard_report();
+
+        kb_send_extra_reports();
+        kb_send_gamepad_report();
+
+#if defined(WATCHDOG_ENABLED) && WATCHDOG_ENABLED == 1
+        watchdog_cycle_complete(systick_get_us() - scan_start);
+#endif // WATCHDOG_ENABLED
+
+#if defined(USB_ENABLED) && USB_ENABLED == 1
+        if (sof_sync_active()) {
+            // A report armed later would be stale by the time it's collected,
+            // the next scan completes just before then
+            TELEMETRY_ADD(reports_dropped, report_pending);
+            report_pending = false;
         }
+#endif // USB_ENABLED
     }
 
     if (values_request_ptr) {
-        interface_handle_get_values_response(
-            values_request_src, values_request_ptr, kb_state.current_values);
-        values_request_ptr = NULL;
+        // On backpressure keep the request, the rest of the reply is sent on
+        // the next iteration
+        hal_err err = interface_handle_get_values_response(
+            values_request_transport, values_request_ptr,
+            kb_state.current_values);
+        if (err != ERR_INTERFACE_TX_BUSY) {
+            values_request_ptr = NULL;
+        }
     }
 
-#if defined(USB_ENABLED) && USB_ENABLED == 1
-    USBD_HID_SendReport(&hUsbDeviceFS, HID_EPIN_ADDR, hid_buff,
-                        HID_BUFFER_SIZE);
-#endif // USB_ENABLED
+    interface_handler_task();
+
+    if (report_pending) {
+        kb_send_keyboard_report();
+    }
 }
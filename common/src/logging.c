@@ -7,6 +7,7 @@
 #include "hal_uart.h"
 
 #include "pinout.h"
+#include "telemetry.h"
 
 #include "utils/utils.h"
 
@@ -142,15 +143,18 @@ int _write(int file, char *ptr, int len) {
 #ifdef PIN_SERIAL_ACTIVITY_LED
         gpio_digital_write(PIN_SERIAL_ACTIVITY_LED, HIGH);
 #endif // PIN_SERIAL_ACTIVITY_LED
-        uart_transmit(&uart_handle, (uint8_t *)ptr, len, 0xFFFF);
+        hal_err err =
+            uart_transmit(&uart_handle, (uint8_t *)ptr, len, 0xFFFF);
 #ifdef PIN_SERIAL_ACTIVITY_LED
         gpio_digital_write(PIN_SERIAL_ACTIVITY_LED, LOW);
 #endif // PIN_SERIAL_ACTIVITY_LED
+        TELEMETRY_ADD(log_drops, err != OK);
 
         return len;
     }
 
     if (log_str_queue_index >= LOG_STR_QUEUE_LEN) {
+        TELEMETRY_COUNT(log_drops);
         return -1;
     }
 
@@ -0,0 +1,180 @@
+#include "macro.h"
+
+#include "logging.h"
+
+#include <stddef.h>
+
+static const macro_step_t *steps = NULL;
+static uint16_t macro_offsets[KB_MACRO_MAX];
+static uint8_t macro_amount = 0U;
+
+static uint16_t queue[KB_MACRO_QUEUE_LEN];
+static uint8_t queue_head = 0U;
+static uint8_t queue_count = 0U;
+
+static bool playing = false;
+static uint16_t position = 0U;
+static uint32_t next_step_time = 0U;
+static bool tap_pressed = false;
+
+static uint16_t held[KB_MACRO_HELD_MAX];
+static uint8_t held_amount = 0U;
+// Pressed during the current report, can't be released before it's sent
+static uint8_t held_fresh = 0U;
+
+bool macro_validate(const macro_step_t *new_steps, uint16_t amount) {
+
+    if (!new_steps || amount == 0U || amount > KB_MACRO_STEPS_MAX) {
+        return false;
+    }
+
+    for (uint16_t i = 0; i < amount; i++) {
+        if (new_steps[i].op > MACRO_STEP_DELAY) {
+            return false;
+        }
+    }
+
+    return new_steps[amount - 1U].op == MACRO_STEP_END;
+}
+
+void macro_init(const macro_step_t *new_steps, uint16_t amount) {
+
+    steps = new_steps;
+    macro_amount = 0U;
+    playing = false;
+    held_amount = 0U;
+    queue_count = 0U;
+
+    if (!steps) {
+        return;
+    }
+
+    if (amount > KB_MACRO_STEPS_MAX) {
+        amount = KB_MACRO_STEPS_MAX;
+    }
+
+    uint16_t start = 0U;
+    for (uint16_t i = 0; i < amount && macro_amount < KB_MACRO_MAX; i++) {
+        if (steps[i].op == MACRO_STEP_END) {
+            macro_offsets[macro_amount] = start;
+            macro_amount++;
+            start = i + 1U;
+        }
+    }
+}
+
+void macro_play(uint16_t id) {
+
+    if (id >= macro_amount) {
+        LOG_ERROR("Macro %d does not exist.", id);
+        return;
+    }
+
+    if (queue_count >= KB_MACRO_QUEUE_LEN) {
+        LOG_ERROR("Macro queue is full, macro %d dropped.", id);
+        return;
+    }
+
+    queue[(queue_head + queue_count) % KB_MACRO_QUEUE_LEN] = id;
+    queue_count++;
+}
+
+static void macro_press(uint16_t action) {
+    if (held_amount >= KB_MACRO_HELD_MAX) {
+        return;
+    }
+    held[held_amount] = action;
+    held_fresh |= 1U << held_amount;
+    held_amount++;
+}
+
+// Returns false if the action has to stay pressed until the next report
+static bool macro_release(uint16_t action) {
+    for (uint8_t i = 0; i < held_amount; i++) {
+        if (held[i] != action) {
+            continue;
+        }
+        if (held_fresh & (1U << i)) {
+            return false;
+        }
+        held_amount--;
+        held[i] = held[held_amount];
+        if (held_fresh & (1U << held_amount)) {
+            held_fresh = (held_fresh & ~(1U << held_amount)) | (1U << i);
+        }
+        return true;
+    }
+    return true;
+}
+
+static void macro_run_steps(uint32_t now) {
+
+    while (playing && (int32_t)(now - next_step_time) >= 0) {
+
+        const macro_step_t *step = &steps[position];
+
+        switch (step->op) {
+        case MACRO_STEP_PRESS:
+            macro_press(step->argument);
+            break;
+
+        case MACRO_STEP_RELEASE:
+            if (!macro_release(step->argument)) {
+                return;
+            }
+            break;
+
+        case MACRO_STEP_TAP:
+            if (!tap_pressed) {
+                macro_press(step->argument);
+                tap_pressed = true;
+                return;
+            }
+            if (!macro_release(step->argument)) {
+                return;
+            }
+            tap_pressed = false;
+            break;
+
+        case MACRO_STEP_DELAY:
+            next_step_time = now + step->argument;
+            position++;
+            return;
+
+        case MACRO_STEP_END:
+        default:
+            // Whatever is still held is released, once it got reported
+            if (held_fresh) {
+                return;
+            }
+            held_amount = 0U;
+            playing = false;
+            return;
+        }
+
+        position++;
+    }
+}
+
+void macro_task(uint32_t now, macro_process_fp process) {
+
+    held_fresh = 0U;
+
+    if (!playing && queue_count && held_amount == 0U) {
+        position = macro_offsets[queue[queue_head]];
+        queue_head = (queue_head + 1U) % KB_MACRO_QUEUE_LEN;
+        queue_count--;
+
+        next_step_time = now;
+        tap_pressed = false;
+        playing = true;
+    }
+
+    if (playing) {
+        macro_run_steps(now);
+    }
+
+    for (uint8_t i = 0; i < held_amount; i++) {
+        process(held[i]);
+    }
+}
@@ -17,10 +17,15 @@
 #include "error_handler.h"
 #include "fw_update_handler.h"
 #include "keyboard.h"
+#include "postmortem.h"
+#include "stack_usage.h"
 #include "usb.h"
+#include "watchdog.h"
 
 int main(void) {
 
+    stack_paint();
+
     // Base
     LOG_INFO("Start booting YarmanKB Dactyl firmware "
              "version " YKB_FW_VERSION);
@@ -30,6 +35,7 @@ int main(void) {
     ERR_H(hal_init());
     LOG_TRACE("HAL init OK.");
     ERR_H(setup_logging());
+    ERR_H(setup_postmortem());
 
     // Misc
 #if defined(BOOT0_HANDLER_ENABLED) && BOOT0_HANDLER_ENABLED == 1
@@ -45,6 +51,10 @@ int main(void) {
     ERR_H(setup_usb());
 #endif // USB_ENABLED
 
+#if defined(WATCHDOG_ENABLED) && WATCHDOG_ENABLED == 1
+    ERR_H(setup_watchdog(postmortem_get_reset_flags()));
+#endif // WATCHDOG_ENABLED
+
     LOG_INFO("Successfully booted.");
 
     while (true) { // Main loop
@@ -0,0 +1,206 @@
+#include "postmortem.h"
+
+#include "hal_clock.h"
+#include "hal_systick.h"
+
+#include "logging.h"
+#include "sof_sync.h"
+#include "telemetry.h"
+
+#include "stm32wbxx.h"
+
+#include <string.h>
+
+#define POSTMORTEM_RECORD_MAGIC 0x504D5254U
+
+// Outlives the reset, taken over on the next boot
+static postmortem_record_t record __attribute__((section(".noinit")));
+
+static postmortem_record_t previous;
+static bool previous_valid = false;
+
+static uint32_t reset_flags = 0U;
+
+// ms
+static uint32_t snapshot_time = 0U;
+
+static inline const char *postmortem_reason_name(uint32_t reason) {
+    switch (reason) {
+    case POSTMORTEM_REASON_HARDFAULT:
+        return "hardfault";
+    case POSTMORTEM_REASON_MEMMANAGE:
+        return "memmanage";
+    case POSTMORTEM_REASON_BUSFAULT:
+        return "busfault";
+    case POSTMORTEM_REASON_USAGEFAULT:
+        return "usagefault";
+    case POSTMORTEM_REASON_ERROR:
+        return "error";
+    case POSTMORTEM_REASON_WATCHDOG:
+        return "watchdog";
+    default:
+        return "unknown";
+    }
+}
+
+static inline void postmortem_log_previous() {
+
+    if (previous.reason == POSTMORTEM_REASON_NONE) {
+        LOG_INFO("Previous boot left no fault, %u trace events",
+                 previous.trace_head);
+        return;
+    }
+
+    if (previous.reason == POSTMORTEM_REASON_WATCHDOG ||
+        previous.reason == POSTMORTEM_REASON_UNKNOWN) {
+        LOG_ERROR("Previous boot reset: %s, last snapshot at %u ms, scan max "
+                  "%u us avg %u us",
+                  postmortem_reason_name(previous.reason), previous.time,
+                  previous.scan_time_max, previous.scan_time_avg);
+        return;
+    }
+
+    LOG_ERROR("Previous boot died at %u ms: %s, error %d", previous.time,
+              postmortem_reason_name(previous.reason), previous.error);
+    LOG_ERROR("pc 0x%08x lr 0x%08x xpsr 0x%08x", previous.registers[6],
+              previous.registers[5], previous.registers[7]);
+    LOG_ERROR("cfsr 0x%08x hfsr 0x%08x mmfar 0x%08x bfar 0x%08x",
+              previous.cfsr, previous.hfsr, previous.mmfar, previous.bfar);
+}
+
+hal_err setup_postmortem() {
+
+    LOG_INFO("Setting up...");
+
+    reset_flags = clock_get_reset_flags();
+    clock_clear_reset_flags();
+
+    // RAM content doesn't survive a power-on or brownout reset
+    if (record.magic == POSTMORTEM_RECORD_MAGIC &&
+        !(reset_flags & RCC_CSR_BORRSTF)) {
+        previous = record;
+        previous_valid = true;
+
+        // Nothing saved the context, tell the watchdog from a pin reset
+        if (previous.reason == POSTMORTEM_REASON_NONE) {
+            if (reset_flags & (RCC_CSR_IWDGRSTF | RCC_CSR_WWDGRSTF)) {
+                previous.reason = POSTMORTEM_REASON_WATCHDOG;
+            } else if (!(reset_flags & RCC_CSR_SFTRSTF)) {
+                previous.reason = POSTMORTEM_REASON_UNKNOWN;
+            }
+        }
+
+        postmortem_log_previous();
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    memset(&record, 0, sizeof(record));
+    record.magic = POSTMORTEM_RECORD_MAGIC;
+    __set_PRIMASK(primask);
+
+    postmortem_trace(POSTMORTEM_EVENT_BOOT, reset_flags >> 24U);
+
+    LOG_INFO("Setup complete.");
+
+    return OK;
+}
+
+void postmortem_trace(postmortem_event event, uint16_t arg) {
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    // The head is garbage until the setup, keep the write in bounds
+    postmortem_trace_t *trace =
+        &record.trace[record.trace_head % POSTMORTEM_TRACE_LENGTH];
+    trace->time = systick_get_us();
+    trace->event = event;
+    trace->arg = arg;
+    record.trace_head++;
+
+    __set_PRIMASK(primask);
+}
+
+static void postmortem_save_timing() {
+
+    uint32_t scans = telemetry.scans;
+    record.scans = scans;
+    record.scan_time_min = scans ? telemetry.scan_time_min : 0U;
+    record.scan_time_max = telemetry.scan_time_max;
+    record.scan_time_avg = scans ? telemetry.scan_time_sum / scans : 0U;
+
+    const sof_sync_stats_t *stats = sof_sync_get_stats();
+    record.in_offset = stats->in_offset;
+    record.scan_duration = stats->scan_duration;
+    record.scan_phase = stats->scan_phase;
+
+    record.time = systick_get_tick();
+    record.magic = POSTMORTEM_RECORD_MAGIC;
+}
+
+void postmortem_scan_complete() {
+
+    uint32_t now = systick_get_tick();
+    if (now - snapshot_time < POSTMORTEM_SNAPSHOT_PERIOD) {
+        return;
+    }
+    snapshot_time = now;
+
+    // Don't mix with a context saved by ERR_H from an interrupt
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (record.reason == POSTMORTEM_REASON_NONE) {
+        postmortem_save_timing();
+    }
+    __set_PRIMASK(primask);
+}
+
+void postmortem_save_fault(postmortem_reason reason, const uint32_t *frame,
+                           const uint32_t *fault) {
+
+    record.reason = reason;
+    record.error = OK;
+    memcpy(record.registers, frame, sizeof(record.registers));
+    record.cfsr = fault[0];
+    record.hfsr = fault[1];
+    record.mmfar = fault[2];
+    record.bfar = fault[3];
+
+    postmortem_save_timing();
+}
+
+void postmortem_save_error(hal_err error_code, uint32_t caller) {
+
+    postmortem_trace(POSTMORTEM_EVENT_ERROR, (uint16_t)-error_code);
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    record.reason = POSTMORTEM_REASON_ERROR;
+    record.error = error_code;
+    memset(record.registers, 0, sizeof(record.registers));
+    record.registers[5] = caller;
+    record.cfsr = 0U;
+    record.hfsr = 0U;
+    record.mmfar = 0U;
+    record.bfar = 0U;
+
+    postmortem_save_timing();
+
+    __set_PRIMASK(primask);
+}
+
+bool postmortem_get_previous(postmortem_record_t *previous_record) {
+
+    if (!previous_valid) {
+        return false;
+    }
+
+    *previous_record = previous;
+    return true;
+}
+
+void postmortem_clear_previous() { previous_valid = false; }
+
+uint32_t postmortem_get_reset_flags() { return reset_flags; }
@@ -0,0 +1,109 @@
+#include "predict.h"
+
+#include <string.h>
+
+static uint16_t raw_thresholds[KB_KEY_COUNT];
+
+static uint16_t history[KB_KEY_COUNT][KB_PREDICT_SAMPLES];
+static uint8_t history_position = 0U;
+static uint8_t history_length = 0U;
+
+// Actuated early and not crossed the threshold yet, with the scans since
+static kb_key_mask_t pending = 0U;
+static uint8_t pending_scans[KB_KEY_COUNT];
+
+static predict_stats_t stats;
+
+void predict_compile(const uint8_t *key_thresholds,
+                     const uint16_t *min_thresholds,
+                     const uint16_t *max_thresholds) {
+
+    for (uint8_t i = 0; i < KB_KEY_COUNT; i++) {
+        if (max_thresholds[i] <= min_thresholds[i]) {
+            // Not calibrated, never predicted
+            raw_thresholds[i] = UINT16_MAX;
+            continue;
+        }
+        raw_thresholds[i] =
+            min_thresholds[i] + (uint32_t)(max_thresholds[i] -
+                                           min_thresholds[i]) *
+                                    key_thresholds[i] / 100U;
+    }
+
+    history_position = 0U;
+    history_length = 0U;
+    pending = 0U;
+}
+
+_Static_assert(KB_PREDICT_SAMPLES == 4U,
+               "predict_velocity is written for 4 samples");
+
+// Least squares slope over the history, oldest sample first
+static inline int32_t predict_velocity(const uint16_t *samples) {
+
+    int32_t s0 = samples[history_position];
+    int32_t s1 = samples[(history_position + 1U) % KB_PREDICT_SAMPLES];
+    int32_t s2 = samples[(history_position + 2U) % KB_PREDICT_SAMPLES];
+    int32_t s3 = samples[(history_position + 3U) % KB_PREDICT_SAMPLES];
+
+    // Negative on release, which mustn't be left shifted
+    return (3 * (s3 - s0) + (s2 - s1)) * (1 << KB_PREDICT_VELOCITY_SHIFT) / 10;
+}
+
+kb_key_mask_t predict_update(kb_key_mask_t pressed, const uint16_t *values) {
+
+    for (uint8_t i = 0; i < KB_KEY_COUNT; i++) {
+        history[i][history_position] = values[i];
+    }
+    history_position = (history_position + 1U) % KB_PREDICT_SAMPLES;
+
+    if (history_length < KB_PREDICT_SAMPLES) {
+        history_length++;
+        return pressed;
+    }
+
+    for (uint8_t i = 0; i < KB_KEY_COUNT; i++) {
+        kb_key_mask_t bit = KB_KEY_BIT(i);
+
+        if (pressed & bit) {
+            if (pending & bit) {
+                // Prediction came true
+                pending &= ~bit;
+                stats.confirmed++;
+                stats.scans_saved += pending_scans[i];
+            }
+            continue;
+        }
+
+        int32_t velocity = predict_velocity(history[i]);
+
+        if (pending & bit) {
+            if (velocity <= 0 || pending_scans[i] >= KB_PREDICT_PENDING_MAX) {
+                pending &= ~bit;
+                stats.false_actuations++;
+                continue;
+            }
+            pending_scans[i]++;
+            pressed |= bit;
+            continue;
+        }
+
+        if (velocity < (int32_t)(KB_PREDICT_MIN_VELOCITY
+                                 << KB_PREDICT_VELOCITY_SHIFT)) {
+            continue;
+        }
+
+        int32_t projected =
+            values[i] + (velocity >> KB_PREDICT_VELOCITY_SHIFT);
+        if (projected >= raw_thresholds[i]) {
+            pending |= bit;
+            pending_scans[i] = 1U;
+            stats.early++;
+            pressed |= bit;
+        }
+    }
+
+    return pressed;
+}
+
+const predict_stats_t *predict_get_stats() { return &stats; }
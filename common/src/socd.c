@@ -0,0 +1,93 @@
+#include "socd.h"
+
+#include "logging.h"
+
+#include <stddef.h>
+
+static const kb_socd_group_t *groups = NULL;
+static uint8_t group_amount = 0U;
+
+static kb_key_set_t previous_pressed = {0};
+
+// Active key of every SOCD_POLICY_LAST_INPUT_WINS group, KB_TOTAL_KEY_COUNT if
+// none
+static uint8_t last_input[KB_SOCD_GROUP_MAX];
+
+void socd_init(const kb_socd_group_t *new_groups, uint8_t amount) {
+
+    if (amount > KB_SOCD_GROUP_MAX) {
+        LOG_ERROR("Too many SOCD groups (%d), only %d are used.", amount,
+                  KB_SOCD_GROUP_MAX);
+        amount = KB_SOCD_GROUP_MAX;
+    }
+
+    groups = new_groups;
+    group_amount = amount;
+
+    previous_pressed = (kb_key_set_t){0};
+    for (uint8_t i = 0; i < KB_SOCD_GROUP_MAX; i++) {
+        last_input[i] = KB_TOTAL_KEY_COUNT;
+    }
+
+    LOG_DEBUG("%d SOCD groups initialized.", group_amount);
+}
+
+static uint8_t socd_deepest_key(kb_key_set_t keys, const uint16_t *values) {
+
+    uint8_t deepest = kb_key_set_pop(&keys);
+
+    while (!kb_key_set_empty(keys)) {
+        uint8_t index = kb_key_set_pop(&keys);
+        if (values[index] > values[deepest]) {
+            deepest = index;
+        }
+    }
+
+    return deepest;
+}
+
+kb_key_set_t socd_resolve(kb_key_set_t pressed, const uint16_t *values) {
+
+    kb_key_set_t new_presses = kb_key_set_and_not(pressed, previous_pressed);
+    previous_pressed = pressed;
+
+    for (uint8_t i = 0; i < group_amount; i++) {
+
+        const kb_socd_group_t *group = &groups[i];
+        kb_key_set_t held = kb_key_set_and(pressed, group->keys);
+
+        // Nothing to resolve with less than two keys held
+        if (!kb_key_set_several(held)) {
+            last_input[i] = kb_key_set_empty(held) ? KB_TOTAL_KEY_COUNT
+                                                   : kb_key_set_first(held);
+            continue;
+        }
+
+        pressed = kb_key_set_and_not(pressed, group->keys);
+
+        switch (group->policy) {
+        case SOCD_POLICY_LAST_INPUT_WINS: {
+            kb_key_set_t fresh = kb_key_set_and(held, new_presses);
+            if (!kb_key_set_empty(fresh)) {
+                // Pressed within the same scan: the deeper one wins
+                last_input[i] = socd_deepest_key(fresh, values);
+            } else if (last_input[i] >= KB_TOTAL_KEY_COUNT ||
+                       !kb_key_set_has(held, last_input[i])) {
+                last_input[i] = socd_deepest_key(held, values);
+            }
+            kb_key_set_add(&pressed, last_input[i]);
+            break;
+        }
+
+        case SOCD_POLICY_DEEPEST_PRESS_WINS:
+            kb_key_set_add(&pressed, socd_deepest_key(held, values));
+            break;
+
+        case SOCD_POLICY_NEUTRAL:
+        default:
+            break;
+        }
+    }
+
+    return pressed;
+}
@@ -0,0 +1,150 @@
+#include "sof_sync.h"
+
+#include "hal_systick.h"
+
+#include <string.h>
+
+// Fractional bits of the filtered offset and duration, the filters move 1/8
+// of the way to each new sample
+#define SOF_SYNC_FILTER_SHIFT 3U
+
+static volatile uint32_t sof_time = 0U;
+static volatile uint32_t sof_count = 0U;
+// SOF of the last scan started by `sof_sync_scan_due`
+static uint32_t scanned_sof = 0U;
+
+static uint32_t scan_start = 0U;
+static uint32_t scan_complete = 0U;
+
+// Completion of the scan whose report is on the endpoint
+static volatile uint32_t armed_scan_complete = 0U;
+static volatile bool armed = false;
+
+static uint32_t in_offset_filtered = 0U;
+static bool in_offset_valid = false;
+static uint32_t scan_duration_filtered = 0U;
+static bool scan_duration_valid = false;
+
+static sof_sync_stats_t stats;
+
+static inline uint32_t sof_sync_filter(uint32_t filtered, uint32_t sample) {
+    int32_t error =
+        (int32_t)(sample << SOF_SYNC_FILTER_SHIFT) - (int32_t)filtered;
+    return filtered + (error >> SOF_SYNC_FILTER_SHIFT);
+}
+
+static void sof_sync_update_phase() {
+
+    if (!in_offset_valid) {
+        // Nothing collected yet, scan right after the SOF
+        stats.scan_phase = 0U;
+        return;
+    }
+
+    uint32_t lead = stats.scan_duration + SOF_SYNC_GUARD;
+    if (lead >= SOF_SYNC_FRAME) {
+        // Can't fit in a frame, the scan runs back to back anyway
+        stats.scan_phase = 0U;
+        return;
+    }
+
+    stats.scan_phase =
+        (stats.in_offset + SOF_SYNC_FRAME - lead) % SOF_SYNC_FRAME;
+}
+
+void sof_sync_on_sof() {
+    sof_time = systick_get_us();
+    sof_count++;
+}
+
+void sof_sync_on_report_collected() {
+
+    if (!armed) {
+        return;
+    }
+    armed = false;
+
+    uint32_t now = systick_get_us();
+
+    uint32_t offset = now - sof_time;
+    if (offset < SOF_SYNC_FRAME) {
+        if (in_offset_valid) {
+            in_offset_filtered = sof_sync_filter(in_offset_filtered, offset);
+        } else {
+            in_offset_filtered = offset << SOF_SYNC_FILTER_SHIFT;
+            in_offset_valid = true;
+        }
+        stats.in_offset = in_offset_filtered >> SOF_SYNC_FILTER_SHIFT;
+    }
+
+    uint32_t bucket = (now - armed_scan_complete) / SOF_SYNC_BUCKET_WIDTH;
+    if (bucket >= SOF_SYNC_BUCKET_COUNT) {
+        bucket = SOF_SYNC_BUCKET_COUNT - 1U;
+    }
+    stats.histogram[bucket]++;
+}
+
+bool sof_sync_active() {
+    return sof_count != 0U && systick_get_us() - sof_time < SOF_SYNC_TIMEOUT;
+}
+
+bool sof_sync_scan_due() {
+
+    uint32_t count;
+    uint32_t time;
+
+    // Re-read if a SOF came in between
+    do {
+        count = sof_count;
+        time = sof_time;
+    } while (count != sof_count);
+
+    if (count == scanned_sof) {
+        return false;
+    }
+
+    // The phase of this frame may be past the last point the main loop gets
+    // here before the next SOF, don't wait for it once a frame went unscanned
+    if (count - scanned_sof < 2U &&
+        systick_get_us() - time < stats.scan_phase) {
+        return false;
+    }
+
+    scanned_sof = count;
+
+    return true;
+}
+
+void sof_sync_scan_started() { scan_start = systick_get_us(); }
+
+void sof_sync_scan_complete() {
+
+    scan_complete = systick_get_us();
+
+    uint32_t duration = scan_complete - scan_start;
+    if (duration >= SOF_SYNC_FRAME) {
+        duration = SOF_SYNC_FRAME;
+    }
+
+    if (scan_duration_valid) {
+        scan_duration_filtered =
+            sof_sync_filter(scan_duration_filtered, duration);
+    } else {
+        scan_duration_filtered = duration << SOF_SYNC_FILTER_SHIFT;
+        scan_duration_valid = true;
+    }
+    stats.scan_duration = scan_duration_filtered >> SOF_SYNC_FILTER_SHIFT;
+
+    sof_sync_update_phase();
+}
+
+void sof_sync_report_armed() {
+    armed_scan_complete = scan_complete;
+    armed = true;
+}
+
+const sof_sync_stats_t *sof_sync_get_stats() { return &stats; }
+
+void sof_sync_reset_histogram() {
+    memset(stats.histogram, 0, sizeof(stats.histogram));
+}
@@ -0,0 +1,605 @@
+#include "split_link.h"
+
+#if defined(SPLIT_LINK_ENABLED) && SPLIT_LINK_ENABLED == 1
+
+#include "frame.h"
+#include "hal_cortex.h"
+#include "hal_dma.h"
+#include "hal_systick.h"
+#include "hal_uart.h"
+#include "interface_handler.h"
+#include "logging.h"
+#include "pinout.h"
+
+#include "stm32wbxx.h"
+
+#include "utils/utils.h"
+
+#include <string.h>
+
+#define SPLIT_LINK_UART USART1
+
+static uart_handle_t uart_handle;
+static dma_handle_t tx_dma;
+static dma_handle_t rx_dma;
+
+static split_link_stats_t stats;
+
+#if SPLIT_LINK_PROTOCOL_ENABLED == 1
+static transport_queue_t protocol_queue;
+
+_Static_assert((TRANSPORT_PACKET_MAX + SPLIT_LINK_PROTOCOL_CHUNK - 1U) /
+                       SPLIT_LINK_PROTOCOL_CHUNK <=
+                   SPLIT_LINK_PROTOCOL_INDEX_MASK,
+               "Protocol packet doesn't fit into the fragment indexes");
+#endif // SPLIT_LINK_PROTOCOL_ENABLED
+
+_Static_assert(KB_REMOTE_KEY_COUNT == 0U || KB_REMOTE_KEY_COUNT == KB_KEY_COUNT,
+               "Both halves have to scan the same amount of keys");
+
+//
+// Secondary
+
+// Written by the DMA until the transfer completes
+static uint8_t tx_frame[FRAME_ENCODED_MAX];
+static uint8_t tx_sequence = 0U;
+static uint32_t tx_sync_time = 0U;
+
+// State the primary half has, as far as the sent frames go
+static kb_key_mask_t sent_pressed = 0U;
+static uint16_t sent_values[KB_KEY_COUNT];
+
+#if SPLIT_LINK_PROTOCOL_ENABLED == 1
+// Key changes which found the link busy, protocol frames wait for them
+static bool keys_pending = false;
+
+// Part of the oldest queued protocol packet sent next
+static uint8_t tx_fragment = 0U;
+#endif // SPLIT_LINK_PROTOCOL_ENABLED
+
+//
+// Primary
+
+static bool primary = false;
+
+static uint8_t rx_ring[SPLIT_LINK_RX_RING_SIZE];
+static uint16_t rx_position = 0U;
+static frame_decoder_t rx_decoder;
+
+static uint8_t rx_sequence = 0U;
+static bool rx_synced = false;
+static bool rx_values_synced = false;
+static uint32_t rx_time = 0U;
+
+static kb_key_mask_t remote_pressed = 0U;
+// Pressed since the last `split_link_take_remote_keys`, so short taps are not
+// lost
+static kb_key_mask_t remote_fresh = 0U;
+static uint16_t remote_values[KB_KEY_COUNT];
+
+#if SPLIT_LINK_PROTOCOL_ENABLED == 1
+// Protocol packet put together from its parts, both halves receive them
+static uint8_t rx_packet[TRANSPORT_PACKET_MAX];
+static uint16_t rx_packet_length = 0U;
+static uint8_t rx_fragment = 0U;
+
+static hal_err split_link_transport_send(const uint8_t *data,
+                                         uint16_t length) {
+
+    if (!transport_queue_push(&protocol_queue, data, length)) {
+        return ERR_INTERFACE_TX_BUSY;
+    }
+
+    return OK;
+}
+
+transport_t split_link_transport = {
+    .name = "Split link",
+    .mtu = TRANSPORT_PACKET_MAX,
+    .send = split_link_transport_send,
+    .receive = NULL,
+};
+#endif // SPLIT_LINK_PROTOCOL_ENABLED
+
+static hal_err split_link_init_dma(dma_handle_t *dma, dma_channel_t *channel,
+                                   dma_request request,
+                                   dma_transfer_direction direction,
+                                   dma_mode mode) {
+    dma->instance = channel;
+    dma->init.request = request;
+    dma->init.direction = direction;
+    dma->init.peripheralAddrIncrement = false;
+    dma->init.memoryAddrIncrement = true;
+    dma->init.peripheral_align = DMA_PERIPHERAL_DATA_ALIGN_BYTE;
+    dma->init.memory_align = DMA_MEMORY_DATA_ALIGN_BYTE;
+    dma->init.mode = mode;
+    dma->init.priority = DMA_PRIORITY_HIGH;
+
+    return dma_init(dma);
+}
+
+hal_err split_link_init(bool is_primary) {
+
+    primary = is_primary;
+
+    uart_init_t init;
+    init.instance = SPLIT_LINK_UART;
+    init.baudrate = SPLIT_LINK_BAUDRATE;
+    init.word_length = UART_WORD_LENGTH_8B;
+    init.stop_bits = UART_STOPBITS_1;
+    init.parity = UART_PARITY_NONE;
+    init.mode = UART_MODE_TX_RX;
+    init.flow_control = UART_HW_FLOW_CONTROL_NONE;
+    init.oversampling = UART_OVERSAMPLING_16;
+    init.one_bit_sampling = UART_ONE_BIT_SAMPLING_DISABLE;
+    init.clock_prescaler = UART_CLOCK_PRESCALER_DIV1;
+    init.advanced.enable = false;
+    init.rx_pin = PIN_SPLIT_UART_RX;
+    init.tx_pin = PIN_SPLIT_UART_TX;
+
+    hal_err err;
+
+    err = uart_init(&uart_handle, &init);
+    if (err) {
+        return err;
+    }
+
+    err = uart_fifo_disable(&uart_handle);
+    if (err) {
+        return err;
+    }
+
+    dma1_enable();
+    dma_mux_enable();
+
+    err = split_link_init_dma(&tx_dma, DMA1_Channel1, DMA_REQUEST_USART1_TX,
+                              DMA_TRANSFER_MEMORY_TO_PERIPH, DMA_MODE_NORMAL);
+    if (err) {
+        return err;
+    }
+
+    err = split_link_init_dma(&rx_dma, DMA1_Channel2, DMA_REQUEST_USART1_RX,
+                              DMA_TRANSFER_PERIPH_TO_MEMORY, DMA_MODE_CIRCULAR);
+    if (err) {
+        return err;
+    }
+
+    // Completion of a TX transfer frees the UART for the next frame, RX is
+    // polled from the ring
+    cortex_nvic_set_priority(DMA1_Channel1_IRQn, 5, 0);
+    cortex_nvic_enable(DMA1_Channel1_IRQn);
+
+    frame_decoder_reset(&rx_decoder);
+
+    err = uart_receive_dma(&uart_handle, &rx_dma, rx_ring, sizeof(rx_ring));
+    if (err) {
+        return err;
+    }
+
+#if SPLIT_LINK_PROTOCOL_ENABLED == 1
+    transport_register(&split_link_transport, interface_handle_new_packet);
+#endif // SPLIT_LINK_PROTOCOL_ENABLED
+
+    LOG_INFO("Split link set up, %s half.", primary ? "primary" : "secondary");
+
+    return OK;
+}
+
+static hal_err split_link_send(const uint8_t *payload, size_t length) {
+
+    if (uart_handle.state != HAL_UART_STATE_READY) {
+        return ERR_SPLIT_LINK_TX_BUSY;
+    }
+
+    size_t size = frame_encode(payload, length, tx_frame);
+    if (size == 0U) {
+        return ERR_UART_TX_BADARGS;
+    }
+
+    hal_err err = uart_transmit_dma(&uart_handle, &tx_dma, tx_frame, size);
+    if (err) {
+        return err;
+    }
+
+    tx_sequence++;
+    stats.frames_sent++;
+
+    return OK;
+}
+
+static inline void split_link_put_u16(uint8_t *buffer, uint16_t value) {
+    buffer[0] = value & 0xFF;
+    buffer[1] = value >> 8;
+}
+
+static inline uint16_t split_link_get_u16(const uint8_t *buffer) {
+    return buffer[0] | buffer[1] << 8;
+}
+
+static bool split_link_send_sync(kb_key_mask_t pressed,
+                                 const uint16_t *values) {
+
+    uint8_t payload[FRAME_PAYLOAD_MAX];
+    size_t length = 0U;
+
+    payload[length++] = SPLIT_LINK_FRAME_SYNC;
+    payload[length++] = tx_sequence;
+
+    for (uint8_t i = 0; i < SPLIT_LINK_MASK_SIZE; i++) {
+        payload[length++] = (pressed >> (i * 8U)) & 0xFF;
+    }
+
+#if SPLIT_LINK_ANALOG_ENABLED == 1
+    for (uint8_t i = 0; i < KB_KEY_COUNT; i++) {
+        split_link_put_u16(&payload[length], values[i]);
+        length += 2U;
+    }
+#else
+    UNUSED(values);
+#endif // SPLIT_LINK_ANALOG_ENABLED
+
+    return split_link_send(payload, length) == OK;
+}
+
+// Returns false if the changes don't fit into a frame
+static bool split_link_build_delta(kb_key_mask_t pressed,
+                                   const uint16_t *values, uint8_t *payload,
+                                   size_t *length) {
+
+    size_t position = 0U;
+
+    payload[position++] = SPLIT_LINK_FRAME_DELTA;
+    payload[position++] = tx_sequence;
+
+    size_t key_count_position = position++;
+    uint8_t key_count = 0U;
+
+    kb_key_mask_t changed = pressed ^ sent_pressed;
+    while (changed) {
+        uint8_t index = __builtin_ctzll(changed);
+        changed &= changed - 1U;
+
+        bool is_pressed = (pressed & KB_KEY_BIT(index)) != 0U;
+        payload[position++] = index | (is_pressed ? 0x80U : 0U);
+        key_count++;
+    }
+    payload[key_count_position] = key_count;
+
+    size_t value_count_position = position++;
+    uint8_t value_count = 0U;
+
+#if SPLIT_LINK_ANALOG_ENABLED == 1
+    for (uint8_t i = 0; i < KB_KEY_COUNT; i++) {
+        int16_t delta = (int16_t)(values[i] - sent_values[i]);
+        int16_t min_delta = SPLIT_LINK_ANALOG_MIN_DELTA;
+        if (delta < min_delta && delta > -min_delta) {
+            continue;
+        }
+
+        if (position + 3U > FRAME_PAYLOAD_MAX) {
+            return false;
+        }
+
+        payload[position++] = i;
+        split_link_put_u16(&payload[position], delta);
+        position += 2U;
+        value_count++;
+    }
+#else
+    UNUSED(values);
+#endif // SPLIT_LINK_ANALOG_ENABLED
+
+    payload[value_count_position] = value_count;
+
+    *length = key_count || value_count ? position : 0U;
+
+    return true;
+}
+
+void split_link_send_keys(kb_key_mask_t pressed, const uint16_t *values) {
+
+    if (uart_handle.state != HAL_UART_STATE_READY) {
+        // Still sending, the changes are picked up by the next call
+#if SPLIT_LINK_PROTOCOL_ENABLED == 1
+        keys_pending = pressed != sent_pressed;
+#endif // SPLIT_LINK_PROTOCOL_ENABLED
+        return;
+    }
+
+#if SPLIT_LINK_PROTOCOL_ENABLED == 1
+    keys_pending = false;
+#endif // SPLIT_LINK_PROTOCOL_ENABLED
+
+    uint32_t now = systick_get_tick();
+
+    uint8_t payload[FRAME_PAYLOAD_MAX];
+    size_t length;
+
+    bool sync = now - tx_sync_time >= SPLIT_LINK_SYNC_INTERVAL ||
+                !split_link_build_delta(pressed, values, payload, &length);
+
+    if (sync) {
+        if (!split_link_send_sync(pressed, values)) {
+            return;
+        }
+        tx_sync_time = now;
+        sent_pressed = pressed;
+        memcpy(sent_values, values, sizeof(sent_values));
+        return;
+    }
+
+    if (length == 0U || split_link_send(payload, length) != OK) {
+        return;
+    }
+
+    sent_pressed = pressed;
+
+#if SPLIT_LINK_ANALOG_ENABLED == 1
+    // Only what was sent, the rest keeps adding up
+    for (uint8_t i = 0; i < payload[3U + payload[2]]; i++) {
+        const uint8_t *entry = &payload[4U + payload[2] + i * 3U];
+        sent_values[entry[0]] += (int16_t)split_link_get_u16(&entry[1]);
+    }
+#endif // SPLIT_LINK_ANALOG_ENABLED
+}
+
+static void split_link_set_remote_keys(kb_key_mask_t pressed) {
+    remote_fresh |= pressed & ~remote_pressed;
+    remote_pressed = pressed;
+}
+
+static bool split_link_apply_sync(const uint8_t *payload, size_t length) {
+
+    size_t expected = 2U + SPLIT_LINK_MASK_SIZE;
+#if SPLIT_LINK_ANALOG_ENABLED == 1
+    expected += KB_KEY_COUNT * 2U;
+#endif // SPLIT_LINK_ANALOG_ENABLED
+
+    if (length != expected) {
+        return false;
+    }
+
+    kb_key_mask_t pressed = 0U;
+    for (uint8_t i = 0; i < SPLIT_LINK_MASK_SIZE; i++) {
+        pressed |= (kb_key_mask_t)payload[2U + i] << (i * 8U);
+    }
+    split_link_set_remote_keys(pressed & (KB_KEY_BIT(KB_KEY_COUNT) - 1U));
+
+#if SPLIT_LINK_ANALOG_ENABLED == 1
+    for (uint8_t i = 0; i < KB_KEY_COUNT; i++) {
+        remote_values[i] =
+            split_link_get_u16(&payload[2U + SPLIT_LINK_MASK_SIZE + i * 2U]);
+    }
+    rx_values_synced = true;
+#endif // SPLIT_LINK_ANALOG_ENABLED
+
+    return true;
+}
+
+static bool split_link_apply_delta(const uint8_t *payload, size_t length) {
+
+    if (length < 4U) {
+        return false;
+    }
+
+    uint8_t key_count = payload[2];
+    if (length < 4U + key_count) {
+        return false;
+    }
+
+    const uint8_t *values = &payload[3U + key_count];
+    uint8_t value_count = values[0];
+    if (length != 4U + key_count + value_count * 3U) {
+        return false;
+    }
+
+    kb_key_mask_t pressed = remote_pressed;
+
+    for (uint8_t i = 0; i < key_count; i++) {
+        uint8_t index = payload[3U + i] & 0x7FU;
+        if (index >= KB_KEY_COUNT) {
+            return false;
+        }
+
+        if (payload[3U + i] & 0x80U) {
+            pressed |= KB_KEY_BIT(index);
+        } else {
+            pressed &= ~KB_KEY_BIT(index);
+        }
+    }
+
+    split_link_set_remote_keys(pressed);
+
+    if (!rx_values_synced) {
+        return true;
+    }
+
+    for (uint8_t i = 0; i < value_count; i++) {
+        const uint8_t *entry = &values[1U + i * 3U];
+        if (entry[0] < KB_KEY_COUNT) {
+            remote_values[entry[0]] += (int16_t)split_link_get_u16(&entry[1]);
+        }
+    }
+
+    return true;
+}
+
+#if SPLIT_LINK_PROTOCOL_ENABLED == 1
+static void split_link_apply_protocol(const uint8_t *payload, size_t length) {
+
+    uint8_t fragment = payload[2];
+    uint8_t index = fragment & SPLIT_LINK_PROTOCOL_INDEX_MASK;
+    uint16_t part_length = length - 3U;
+
+    if (index == 0U) {
+        rx_packet_length = 0U;
+        rx_fragment = 0U;
+    }
+
+    // A part went missing, wait for the start of the next packet
+    if (index != rx_fragment ||
+        rx_packet_length + part_length > sizeof(rx_packet)) {
+        rx_fragment = SPLIT_LINK_PROTOCOL_INDEX_MASK;
+        return;
+    }
+
+    memcpy(&rx_packet[rx_packet_length], &payload[3], part_length);
+    rx_packet_length += part_length;
+    rx_fragment++;
+
+    if (!(fragment & SPLIT_LINK_PROTOCOL_LAST)) {
+        return;
+    }
+
+    rx_fragment = SPLIT_LINK_PROTOCOL_INDEX_MASK;
+
+    // Answering a reply would bounce packets between the halves forever
+    if (fragment & SPLIT_LINK_PROTOCOL_REPLY) {
+        return;
+    }
+
+    // The USB interrupt calls the same handler, which keeps state of its own
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    transport_receive(&split_link_transport, rx_packet, rx_packet_length);
+    __set_PRIMASK(primask);
+}
+#endif // SPLIT_LINK_PROTOCOL_ENABLED
+
+static void split_link_apply(const uint8_t *payload, size_t length) {
+
+    if (length < 2U) {
+        stats.frames_dropped++;
+        return;
+    }
+
+    uint8_t sequence = payload[1];
+    bool gap = rx_synced && sequence != rx_sequence;
+
+    bool ok = false;
+
+    switch (payload[0]) {
+    case SPLIT_LINK_FRAME_SYNC:
+        ok = split_link_apply_sync(payload, length);
+        break;
+    case SPLIT_LINK_FRAME_DELTA:
+        if (gap) {
+            rx_values_synced = false;
+        }
+        ok = split_link_apply_delta(payload, length);
+        break;
+    case SPLIT_LINK_FRAME_PROTOCOL:
+        ok = length >= 3U;
+        break;
+    }
+
+    if (!ok) {
+        stats.frames_dropped++;
+        return;
+    }
+
+    if (gap) {
+        stats.sequence_gaps++;
+    }
+
+    rx_synced = true;
+    rx_sequence = sequence + 1U;
+    rx_time = systick_get_tick();
+    stats.frames_received++;
+
+#if SPLIT_LINK_PROTOCOL_ENABLED == 1
+    if (payload[0] == SPLIT_LINK_FRAME_PROTOCOL) {
+        split_link_apply_protocol(payload, length);
+    }
+#endif // SPLIT_LINK_PROTOCOL_ENABLED
+}
+
+void split_link_receive() {
+
+    uint16_t head = sizeof(rx_ring) - dma_get_remaining(&rx_dma);
+    if (head >= sizeof(rx_ring)) {
+        head = 0U;
+    }
+
+    while (rx_position != head) {
+        size_t length;
+        frame_decode_result result =
+            frame_decoder_push(&rx_decoder, rx_ring[rx_position], &length);
+
+        rx_position = (rx_position + 1U) % sizeof(rx_ring);
+
+        if (result == FRAME_DECODE_OK) {
+            split_link_apply(rx_decoder.buffer, length);
+        } else if (result == FRAME_DECODE_ERROR) {
+            stats.frames_dropped++;
+        }
+    }
+
+    // Secondary half gets only protocol replies, there is nothing to time out
+    if (primary && rx_synced &&
+        systick_get_tick() - rx_time >= SPLIT_LINK_TIMEOUT) {
+        LOG_ERROR("Split link timed out, releasing remote keys.");
+        remote_pressed = 0U;
+        remote_fresh = 0U;
+        rx_synced = false;
+        rx_values_synced = false;
+        stats.timeouts++;
+    }
+}
+
+#if SPLIT_LINK_PROTOCOL_ENABLED == 1
+void split_link_flush() {
+
+    if (keys_pending) {
+        return;
+    }
+
+    uint16_t length;
+    const uint8_t *packet = transport_queue_peek(&protocol_queue, &length);
+    if (!packet) {
+        return;
+    }
+
+    uint16_t offset = tx_fragment * SPLIT_LINK_PROTOCOL_CHUNK;
+    uint16_t part_length = length - offset;
+    bool last = part_length <= SPLIT_LINK_PROTOCOL_CHUNK;
+    if (!last) {
+        part_length = SPLIT_LINK_PROTOCOL_CHUNK;
+    }
+
+    uint8_t payload[3U + SPLIT_LINK_PROTOCOL_CHUNK];
+    payload[0] = SPLIT_LINK_FRAME_PROTOCOL;
+    payload[1] = tx_sequence;
+    payload[2] = tx_fragment | SPLIT_LINK_PROTOCOL_REPLY |
+                 (last ? SPLIT_LINK_PROTOCOL_LAST : 0U);
+    memcpy(&payload[3], &packet[offset], part_length);
+
+    if (split_link_send(payload, 3U + part_length) != OK) {
+        return;
+    }
+
+    if (!last) {
+        tx_fragment++;
+        return;
+    }
+
+    tx_fragment = 0U;
+    transport_queue_pop(&protocol_queue);
+}
+#endif // SPLIT_LINK_PROTOCOL_ENABLED
+
+kb_key_mask_t split_link_take_remote_keys() {
+
+    kb_key_mask_t keys = remote_pressed | remote_fresh;
+    remote_fresh = 0U;
+
+    return keys;
+}
+
+kb_key_mask_t split_link_get_remote_keys() { return remote_pressed; }
+
+const uint16_t *split_link_get_remote_values() { return remote_values; }
+
+const split_link_stats_t *split_link_get_stats() { return &stats; }
+
+#endif // SPLIT_LINK_ENABLED
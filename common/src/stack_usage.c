@@ -0,0 +1,58 @@
+#include "stack_usage.h"
+
+#include "stm32wbxx.h"
+
+#include <stddef.h>
+
+#define STACK_PAINT_PATTERN 0xA5A5A5A5U
+
+// Words below the stack pointer of the painting function left alone
+#define STACK_PAINT_MARGIN 16U
+
+// Linker script symbols, the sizes are their addresses
+extern uint32_t _sdata[];
+extern uint32_t _ebss[];
+extern uint32_t _estack[];
+extern uint8_t _Min_Stack_Size[];
+extern uint8_t _Ram_Budget[];
+
+static uint32_t *paint_bottom = NULL;
+
+void stack_paint() {
+
+    uint32_t *bottom = _estack - STACK_PAINT_SIZE / sizeof(uint32_t);
+    if (bottom < _ebss) {
+        bottom = _ebss;
+    }
+
+    volatile uint32_t *top = (uint32_t *)__get_MSP() - STACK_PAINT_MARGIN;
+    for (volatile uint32_t *word = bottom; word < top; word++) {
+        *word = STACK_PAINT_PATTERN;
+    }
+
+    paint_bottom = bottom;
+}
+
+stack_usage_t stack_get_usage() {
+
+    stack_usage_t usage = {
+        .static_ram = (uint32_t)(_ebss - _sdata) * sizeof(uint32_t),
+        .ram_budget = (uint32_t)_Ram_Budget,
+        .stack_budget = (uint32_t)_Min_Stack_Size,
+    };
+
+    if (paint_bottom == NULL) {
+        return usage;
+    }
+
+    // Deepest word no longer holding the pattern
+    const uint32_t *word = paint_bottom;
+    while (word < _estack && *word == STACK_PAINT_PATTERN) {
+        word++;
+    }
+
+    usage.stack_painted = (uint32_t)(_estack - paint_bottom) * sizeof(uint32_t);
+    usage.stack_high_water = (uint32_t)(_estack - word) * sizeof(uint32_t);
+
+    return usage;
+}
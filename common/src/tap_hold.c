@@ -0,0 +1,166 @@
+#include "tap_hold.h"
+
+#include "keys.h"
+
+#include <stddef.h>
+
+typedef enum {
+    TAP_HOLD_UNDECIDED = 0U,
+    TAP_HOLD_TAP,
+    TAP_HOLD_HOLD,
+} tap_hold_decision;
+
+static tap_hold_action_fp get_action = NULL;
+static tap_hold_emit_fp emit = NULL;
+
+static uint32_t tapping_term = TAP_HOLD_TERM_DEFAULT * 1000U;
+static tap_hold_policy policy = TAP_HOLD_POLICY_DEFAULT;
+
+static key_event_t buffer[TAP_HOLD_BUFFER_LEN];
+static uint8_t buffer_head = 0U;
+static uint8_t buffer_count = 0U;
+
+static bool pending = false;
+static key_event_t pending_press;
+static uint16_t pending_action;
+
+void tap_hold_init(tap_hold_action_fp get_action_fp, tap_hold_emit_fp emit_fp) {
+    get_action = get_action_fp;
+    emit = emit_fp;
+
+    buffer_head = 0U;
+    buffer_count = 0U;
+    pending = false;
+}
+
+void tap_hold_configure(uint16_t tapping_term_ms, tap_hold_policy new_policy) {
+    if (tapping_term_ms == 0U) {
+        tapping_term_ms = TAP_HOLD_TERM_DEFAULT;
+    }
+    tapping_term = tapping_term_ms * 1000U;
+    policy = new_policy;
+}
+
+static inline key_event_t *buffer_at(uint8_t i) {
+    return &buffer[(buffer_head + i) % TAP_HOLD_BUFFER_LEN];
+}
+
+static inline bool is_tap_hold(uint16_t action) {
+    uint8_t type = KB_ACTION_TYPE(action);
+    return type == KB_ACTION_TYPE_MOD_TAP || type == KB_ACTION_TYPE_LAYER_TAP;
+}
+
+static inline uint16_t tap_action(uint16_t action) {
+    return KB_ACTION(KB_ACTION_TYPE_KEY, KB_ACTION_PAYLOAD(action) & 0xFF);
+}
+
+static inline uint16_t hold_action(uint16_t action) {
+    uint8_t argument = KB_ACTION_PAYLOAD(action) >> 8;
+    if (KB_ACTION_TYPE(action) == KB_ACTION_TYPE_MOD_TAP) {
+        return KEY_MODS(argument);
+    }
+    return KEY_MO(argument);
+}
+
+static tap_hold_decision decide(uint32_t now) {
+
+    for (uint8_t i = 0; i < buffer_count; i++) {
+        const key_event_t *event = buffer_at(i);
+
+        if (event->time - pending_press.time >= tapping_term) {
+            return TAP_HOLD_HOLD;
+        }
+
+        if (event->key_index == pending_press.key_index) {
+            return event->pressed ? TAP_HOLD_HOLD : TAP_HOLD_TAP;
+        }
+
+        if (event->pressed) {
+            if (policy == TAP_HOLD_POLICY_HOLD_ON_OTHER_KEY_PRESS) {
+                return TAP_HOLD_HOLD;
+            }
+            continue;
+        }
+
+        if (policy != TAP_HOLD_POLICY_PERMISSIVE_HOLD) {
+            continue;
+        }
+
+        // Key which was pressed after the tap-hold one got released
+        for (uint8_t j = 0; j < i; j++) {
+            const key_event_t *press = buffer_at(j);
+            if (press->key_index == event->key_index && press->pressed) {
+                return TAP_HOLD_HOLD;
+            }
+        }
+    }
+
+    if (now - pending_press.time >= tapping_term ||
+        buffer_count >= TAP_HOLD_BUFFER_LEN) {
+        return TAP_HOLD_HOLD;
+    }
+
+    return TAP_HOLD_UNDECIDED;
+}
+
+static void resolve(uint32_t now) {
+
+    if (!get_action || !emit) {
+        return;
+    }
+
+    while (true) {
+
+        if (pending) {
+            tap_hold_decision decision = decide(now);
+            if (decision == TAP_HOLD_UNDECIDED) {
+                return;
+            }
+
+            emit(pending_press.key_index, true,
+                 decision == TAP_HOLD_TAP ? tap_action(pending_action)
+                                          : hold_action(pending_action));
+            pending = false;
+        }
+
+        if (buffer_count == 0U) {
+            return;
+        }
+
+        // Replay buffered events in order, the next tap-hold key stops it again
+        key_event_t event = *buffer_at(0);
+        buffer_head = (buffer_head + 1U) % TAP_HOLD_BUFFER_LEN;
+        buffer_count--;
+
+        if (!event.pressed) {
+            emit(event.key_index, false, KEY_NOKEY);
+            continue;
+        }
+
+        uint16_t action = get_action(event.key_index);
+
+        if (is_tap_hold(action)) {
+            pending = true;
+            pending_press = event;
+            pending_action = action;
+            continue;
+        }
+
+        emit(event.key_index, true, action);
+    }
+}
+
+void tap_hold_event(const key_event_t *event) {
+
+    // Full buffer decides the pending key, so there is always room after it
+    if (buffer_count >= TAP_HOLD_BUFFER_LEN) {
+        resolve(event->time);
+    }
+
+    *buffer_at(buffer_count) = *event;
+    buffer_count++;
+
+    resolve(event->time);
+}
+
+void tap_hold_task(uint32_t now) { resolve(now); }
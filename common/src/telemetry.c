@@ -0,0 +1,62 @@
+#include "telemetry.h"
+
+#include "hal_systick.h"
+
+telemetry_t telemetry = {.scan_time_min = UINT32_MAX};
+
+// Scan count and time of the previous snapshot, for the scan rate
+static uint32_t snapshot_scans = 0U;
+static uint32_t snapshot_tick = 0U;
+
+// Scan count the average is taken over
+static uint32_t scan_time_scans = 0U;
+
+telemetry_snapshot_t telemetry_get_snapshot() {
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    telemetry_t counters = telemetry;
+    __set_PRIMASK(primask);
+
+    uint32_t tick = systick_get_tick();
+    uint32_t scans = counters.scans - scan_time_scans;
+
+    telemetry_snapshot_t snapshot = {
+        .uptime = tick,
+        .scans = counters.scans,
+        .scan_time_min = scans ? counters.scan_time_min : 0U,
+        .scan_time_max = counters.scan_time_max,
+        .scan_time_avg = scans ? counters.scan_time_sum / scans : 0U,
+        .reports_sent = counters.reports[0],
+        .reports_dropped = counters.reports_dropped,
+        .replies_dropped = counters.replies_dropped,
+        .flash_erases = counters.flash_erases,
+        .flash_programs = counters.flash_programs,
+        .eeprom_commits = counters.eeprom_commits,
+        .log_drops = counters.log_drops,
+        .reports_refused = counters.reports[1],
+    };
+
+    if (tick != snapshot_tick) {
+        snapshot.scan_rate = (uint64_t)(counters.scans - snapshot_scans) *
+                             1000U / (tick - snapshot_tick);
+    }
+
+    snapshot_scans = counters.scans;
+    snapshot_tick = tick;
+
+    return snapshot;
+}
+
+void telemetry_reset_scan_times() {
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    telemetry.scan_time_min = UINT32_MAX;
+    telemetry.scan_time_max = 0U;
+    telemetry.scan_time_sum = 0U;
+    scan_time_scans = telemetry.scans;
+
+    __set_PRIMASK(primask);
+}
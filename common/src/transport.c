@@ -0,0 +1,51 @@
+#include "transport.h"
+
+#include "logging.h"
+
+#include <string.h>
+
+void transport_register(transport_t *transport,
+                        transport_receive_callback receive) {
+    transport->receive = receive;
+
+    LOG_DEBUG("Transport %s registered, MTU %d.", transport->name,
+              transport->mtu);
+}
+
+bool transport_queue_push(transport_queue_t *queue, const uint8_t *data,
+                          uint16_t length) {
+
+    if (length > TRANSPORT_PACKET_MAX ||
+        queue->count >= TRANSPORT_QUEUE_LEN) {
+        return false;
+    }
+
+    uint8_t slot = (queue->head + queue->count) % TRANSPORT_QUEUE_LEN;
+    memcpy(queue->packets[slot], data, length);
+    queue->lengths[slot] = length;
+    queue->count++;
+
+    return true;
+}
+
+const uint8_t *transport_queue_peek(const transport_queue_t *queue,
+                                    uint16_t *length) {
+
+    if (queue->count == 0U) {
+        return NULL;
+    }
+
+    *length = queue->lengths[queue->head];
+
+    return queue->packets[queue->head];
+}
+
+void transport_queue_pop(transport_queue_t *queue) {
+
+    if (queue->count == 0U) {
+        return;
+    }
+
+    queue->head = (queue->head + 1U) % TRANSPORT_QUEUE_LEN;
+    queue->count--;
+}
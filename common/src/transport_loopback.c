@@ -0,0 +1,55 @@
+#include "transport_loopback.h"
+
+#include "interface_handler.h"
+
+#include <string.h>
+
+static transport_queue_t queue;
+static transport_loopback_stats_t stats;
+
+static hal_err transport_loopback_send(const uint8_t *data, uint16_t length) {
+
+    if (!transport_queue_push(&queue, data, length)) {
+        stats.busy++;
+        return ERR_INTERFACE_TX_BUSY;
+    }
+
+    stats.packets_sent++;
+    stats.bytes_sent += length;
+
+    return OK;
+}
+
+transport_t loopback_transport = {
+    .name = "Loopback",
+    .mtu = TRANSPORT_PACKET_MAX,
+    .send = transport_loopback_send,
+    .receive = NULL,
+};
+
+void transport_loopback_inject(const uint8_t *packet, uint16_t length) {
+    stats.packets_received++;
+    transport_receive(&loopback_transport, packet, length);
+}
+
+bool transport_loopback_pop(uint8_t *packet, uint16_t *length) {
+
+    const uint8_t *head = transport_queue_peek(&queue, length);
+    if (!head) {
+        return false;
+    }
+
+    memcpy(packet, head, *length);
+    transport_queue_pop(&queue);
+
+    return true;
+}
+
+void transport_loopback_reset() {
+    memset(&queue, 0, sizeof(queue));
+    memset(&stats, 0, sizeof(stats));
+}
+
+const transport_loopback_stats_t *transport_loopback_get_stats() {
+    return &stats;
+}
@@ -4,13 +4,40 @@
 
 #include "usb.h"
 
+#include "interface_handler.h"
 #include "logging.h"
 #include "usb/usbd_core.h"
 #include "usb/usbd_hid.h"
 
+#include <string.h>
+
 USBD_HandleTypeDef hUsbDeviceFS;
 extern USBD_DescriptorsTypeDef HID_Desc;
 
+static hal_err usb_transport_send(const uint8_t *data, uint16_t length) {
+
+    uint8_t report[VEND_HID_EPSIZE] = {VEND_HID_REPORT_ID};
+    memcpy(&report[1], data, length);
+
+    // Queued by the HID class until the vendor IN endpoint is free
+    switch (USBD_HID_SendReport(&hUsbDeviceFS, VEND_HID_EPIN_ADDR, report,
+                                sizeof(report))) {
+    case USBD_OK:
+        return OK;
+    case USBD_BUSY:
+        return ERR_INTERFACE_TX_BUSY;
+    default:
+        return ERR_INTERFACE_TX_FAIL;
+    }
+}
+
+transport_t usb_transport = {
+    .name = "USB",
+    .mtu = VEND_HID_EPSIZE - 1U,
+    .send = usb_transport_send,
+    .receive = NULL,
+};
+
 hal_err setup_usb() {
 
     LOG_INFO("Setting up...");
@@ -33,6 +60,8 @@ hal_err setup_usb() {
     }
     LOG_TRACE("HID device registered.");
 
+    transport_register(&usb_transport, interface_handle_new_packet);
+
     LOG_TRACE("Starting USB device...");
     err = usb_device_start(&hUsbDeviceFS);
     if (err) {
@@ -144,16 +144,19 @@ USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev) {
         return 24; // TODO
     }
 
+    // Buffer table takes the first 8 bytes of every endpoint
     HAL_PCDEx_PMAConfig((PCD_HandleTypeDef *)pdev->pData, 0x00, PCD_SNG_BUF,
-                        0x0C);
+                        0x40);
     HAL_PCDEx_PMAConfig((PCD_HandleTypeDef *)pdev->pData, 0x80, PCD_SNG_BUF,
-                        0x4C);
+                        0x80);
     HAL_PCDEx_PMAConfig((PCD_HandleTypeDef *)pdev->pData, HID_EPIN_ADDR,
-                        PCD_SNG_BUF, 0x8C);
+                        PCD_SNG_BUF, 0xC0);
     HAL_PCDEx_PMAConfig((PCD_HandleTypeDef *)pdev->pData, VEND_HID_EPIN_ADDR,
-                        PCD_SNG_BUF, 0xCC);
+                        PCD_SNG_BUF, 0x100);
     HAL_PCDEx_PMAConfig((PCD_HandleTypeDef *)pdev->pData, VEND_HID_EPOUT_ADDR,
-                        PCD_SNG_BUF, 0x10C);
+                        PCD_SNG_BUF, 0x140);
+    HAL_PCDEx_PMAConfig((PCD_HandleTypeDef *)pdev->pData,
+                        GAMEPAD_HID_EPIN_ADDR, PCD_SNG_BUF, 0x180);
     return OK;
 }
 
@@ -2,8 +2,11 @@
 
 #include "hal_systick.h"
 
-#include "interface_handler.h"
 #include "logging.h"
+#include "sof_sync.h"
+#include "telemetry.h"
+#include "transport.h"
+#include "usb.h"
 
 #include "usb/usbd_conf.h"
 #include "usb/usbd_core.h"
@@ -21,6 +24,7 @@ static uint8_t USBD_HID_Setup(USBD_HandleTypeDef *pdev,
                               USBD_SetupReqTypedef *req);
 static uint8_t USBD_HID_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum);
 static uint8_t USBD_HID_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum);
+static uint8_t USBD_HID_SOF(USBD_HandleTypeDef *pdev);
 static uint8_t *USBD_HID_GetFSCfgDesc(uint16_t *length);
 static uint8_t *USBD_HID_GetHSCfgDesc(uint16_t *length);
 static uint8_t *USBD_HID_GetOtherSpeedCfgDesc(uint16_t *length);
@@ -34,7 +38,7 @@ USBD_ClassTypeDef USBD_HID = {
     NULL,             /* EP0_RxReady */
     USBD_HID_DataIn,  /* DataIn */
     USBD_HID_DataOut, /* DataOut */
-    NULL,             /* SOF */
+    USBD_HID_SOF,     /* SOF */
     NULL,
     NULL,
     USBD_HID_GetHSCfgDesc,
@@ -50,7 +54,7 @@ __ALIGN_BEGIN static uint8_t
         USB_DESC_TYPE_CONFIGURATION, /* bLength, bDescriptorType        */
         LOBYTE(USB_HID_CONFIG_DESC_SIZ),
         HIBYTE(USB_HID_CONFIG_DESC_SIZ),
-        0x02, /* bNumInterfaces                               */
+        0x03, /* bNumInterfaces                               */
         0x01,
         0x00,
         0xE0, /* bConfigurationValue, iConfig, bmAttributes   */
@@ -85,7 +89,7 @@ __ALIGN_BEGIN static uint8_t
         0x03, /* Interrupt IN                         */
         HID_EPIN_SIZE,
         0x00,
-        HID_FS_BINTERVAL,
+        HID_KB_FS_BINTERVAL,
 
         /* -------- Interface 1 : Vendor HID channel ------------ */
         /* Interface descriptor */
@@ -107,8 +111,8 @@ __ALIGN_BEGIN static uint8_t
         0x00,
         0x01,
         0x22, /* one report descriptor follows       */
-        VEND_HID_REPORT_DESC_SIZE,
-        0x00,
+        LOBYTE(VEND_HID_REPORT_DESC_SIZE),
+        HIBYTE(VEND_HID_REPORT_DESC_SIZE),
 
         /* IN endpoint 0x82 */
         0x07,
@@ -127,6 +131,38 @@ __ALIGN_BEGIN static uint8_t
         VEND_HID_EPSIZE,
         0x00,
         HID_FS_BINTERVAL,
+
+        /* -------- Interface 2 : Gamepad ----------------------- */
+        /* Interface descriptor */
+        0x09,
+        USB_DESC_TYPE_INTERFACE,
+        0x02,
+        0x00, /* bInterfaceNumber, bAlternateSetting */
+        0x01,
+        0x03,
+        0x00,
+        0x00,
+        0x00, /* 1 EP, class HID, no proto           */
+
+        /* HID descriptor */
+        0x09,
+        HID_DESCRIPTOR_TYPE,
+        0x11,
+        0x01,
+        0x00,
+        0x01,
+        0x22, /* one report descriptor follows       */
+        LOBYTE(GAMEPAD_HID_REPORT_DESC_SIZE),
+        HIBYTE(GAMEPAD_HID_REPORT_DESC_SIZE),
+
+        /* IN endpoint 0x82 */
+        0x07,
+        USB_DESC_TYPE_ENDPOINT,
+        GAMEPAD_HID_EPIN_ADDR,
+        0x03,
+        GAMEPAD_HID_EPIN_SIZE,
+        0x00,
+        HID_FS_BINTERVAL,
 };
 
 /* USB HID device Configuration Descriptor */
@@ -155,9 +191,23 @@ __ALIGN_BEGIN static uint8_t
         0x00, /* bCountryCode: Hardware target country */
         0x01, /* bNumDescriptors: Number of HID class descriptors to follow */
         0x22, /* bDescriptorType */
-        VEND_HID_REPORT_DESC_SIZE, /* wItemLength: Total length of Report
-                                       descriptor */
-        0x00,
+        LOBYTE(VEND_HID_REPORT_DESC_SIZE), /* wItemLength: Total length of
+                                               Report descriptor */
+        HIBYTE(VEND_HID_REPORT_DESC_SIZE),
+};
+
+__ALIGN_BEGIN static uint8_t
+    USBD_GAMEPAD_HID_Desc[USB_GAMEPAD_HID_DESC_SIZ] __ALIGN_END = {
+        0x09,                /* bLength: HID Descriptor size */
+        HID_DESCRIPTOR_TYPE, /* bDescriptorType: HID */
+        0x11,                /* bcdHID: HID Class Spec release number */
+        0x01,
+        0x00, /* bCountryCode: Hardware target country */
+        0x01, /* bNumDescriptors: Number of HID class descriptors to follow */
+        0x22, /* bDescriptorType */
+        LOBYTE(GAMEPAD_HID_REPORT_DESC_SIZE), /* wItemLength: Total length of
+                                                  Report descriptor */
+        HIBYTE(GAMEPAD_HID_REPORT_DESC_SIZE),
 };
 
 /* USB Standard Device Descriptor */
@@ -234,7 +284,81 @@ __ALIGN_BEGIN static uint8_t
         0x85, 0x01,             //   REPORT_ID (1) again
         0x95, 0x40, 0x75, 0x08, //   64-byte OUTPUT
         0x09, 0x01, 0x91, 0x02, //   Output (Data,Var,Abs)
-        0xC0                    // End Collection
+        0xC0,                   // End Collection
+
+        0x05, 0x0C,                   // Usage Page (Consumer)
+        0x09, 0x01,                   // Usage (Consumer Control)
+        0xA1, 0x01,                   // Collection (Application)
+        0x85, HID_CONSUMER_REPORT_ID, //   REPORT_ID (2)
+        0x15, 0x00,                   //   Logical Minimum (0)
+        0x26, 0xFF, 0x03,             //   Logical Maximum (0x3FF)
+        0x19, 0x00,                   //   Usage Minimum (0)
+        0x2A, 0xFF, 0x03,             //   Usage Maximum (0x3FF)
+        0x75, 0x10,                   //   Report Size (16)
+        0x95, 0x01,                   //   Report Count (1)
+        0x81, 0x00,                   //   Input (Data,Array,Abs)
+        0xC0,                         // End Collection
+
+        0x05, 0x01,                   // Usage Page (Generic Desktop Ctrls)
+        0x09, 0x80,                   // Usage (System Control)
+        0xA1, 0x01,                   // Collection (Application)
+        0x85, HID_SYSTEM_REPORT_ID,   //   REPORT_ID (3)
+        0x15, 0x00,                   //   Logical Minimum (0)
+        0x26, 0xB7, 0x00,             //   Logical Maximum (0xB7)
+        0x19, 0x00,                   //   Usage Minimum (0)
+        0x29, 0xB7,                   //   Usage Maximum (0xB7)
+        0x75, 0x08,                   //   Report Size (8)
+        0x95, 0x01,                   //   Report Count (1)
+        0x81, 0x00,                   //   Input (Data,Array,Abs)
+        0xC0,                         // End Collection
+
+        0x05, 0x01,                   // Usage Page (Generic Desktop Ctrls)
+        0x09, 0x02,                   // Usage (Mouse)
+        0xA1, 0x01,                   // Collection (Application)
+        0x85, HID_MOUSE_REPORT_ID,    //   REPORT_ID (4)
+        0x09, 0x01,                   //   Usage (Pointer)
+        0xA1, 0x00,                   //   Collection (Physical)
+        0x05, 0x09,                   //     Usage Page (Button)
+        0x19, 0x01,                   //     Usage Minimum (1)
+        0x29, 0x05,                   //     Usage Maximum (5)
+        0x15, 0x00,                   //     Logical Minimum (0)
+        0x25, 0x01,                   //     Logical Maximum (1)
+        0x95, 0x05,                   //     Report Count (5)
+        0x75, 0x01,                   //     Report Size (1)
+        0x81, 0x02,                   //     Input (Data,Var,Abs) -- Buttons
+        0x95, 0x01,                   //     Report Count (1)
+        0x75, 0x03,                   //     Report Size (3)
+        0x81, 0x01,                   //     Input (Const,Var,Abs) -- Padding
+        0x05, 0x01,                   //     Usage Page (Generic Desktop Ctrls)
+        0x09, 0x30,                   //     Usage (X)
+        0x09, 0x31,                   //     Usage (Y)
+        0x09, 0x38,                   //     Usage (Wheel)
+        0x15, 0x81,                   //     Logical Minimum (-127)
+        0x25, 0x7F,                   //     Logical Maximum (127)
+        0x75, 0x08,                   //     Report Size (8)
+        0x95, 0x03,                   //     Report Count (3)
+        0x81, 0x06,                   //     Input (Data,Var,Rel)
+        0xC0,                         //   End Collection
+        0xC0                          // End Collection
+};
+
+__ALIGN_BEGIN static uint8_t
+    GAMEPAD_HID_ReportDesc[GAMEPAD_HID_REPORT_DESC_SIZE] __ALIGN_END = {
+        0x05, 0x01,       // Usage Page (Generic Desktop Ctrls)
+        0x09, 0x05,       // Usage (Game Pad)
+        0xA1, 0x01,       // Collection (Application)
+        0x09, 0x30,       //   Usage (X)
+        0x09, 0x31,       //   Usage (Y)
+        0x09, 0x32,       //   Usage (Z)
+        0x09, 0x33,       //   Usage (Rx)
+        0x09, 0x34,       //   Usage (Ry)
+        0x09, 0x35,       //   Usage (Rz)
+        0x16, 0x01, 0x80, //   Logical Minimum (-32767)
+        0x26, 0xFF, 0x7F, //   Logical Maximum (32767)
+        0x75, 0x10,       //   Report Size (16)
+        0x95, 0x06,       //   Report Count (6)
+        0x81, 0x02,       //   Input (Data,Var,Abs)
+        0xC0              // End Collection
 };
 
 uint8_t vendRxBuf[64];
@@ -259,7 +383,7 @@ static uint8_t USBD_HID_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx) {
         pdev->ep_in[HID_EPIN_ADDR & 0xFU].bInterval = HID_HS_BINTERVAL;
     } else /* LOW and FULL-speed endpoints */
     {
-        pdev->ep_in[HID_EPIN_ADDR & 0xFU].bInterval = HID_FS_BINTERVAL;
+        pdev->ep_in[HID_EPIN_ADDR & 0xFU].bInterval = HID_KB_FS_BINTERVAL;
     }
 
     /* Open EP IN */
@@ -279,8 +403,19 @@ static uint8_t USBD_HID_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx) {
     USBD_LL_PrepareReceive(pdev, VEND_HID_EPOUT_ADDR, vendRxBuf,
                            VEND_HID_EPSIZE);
 
+    pdev->ep_in[GAMEPAD_HID_EPIN_ADDR & 0xFU].bInterval = HID_FS_BINTERVAL;
+    USBD_LL_OpenEP(pdev, GAMEPAD_HID_EPIN_ADDR, USBD_EP_TYPE_INTR,
+                   GAMEPAD_HID_EPIN_SIZE);
+    pdev->ep_in[GAMEPAD_HID_EPIN_ADDR & 0xFU].is_used = 1U;
+
     hhid->kb_state = USBD_HID_IDLE;
     hhid->vend_state = USBD_HID_IDLE;
+    hhid->gamepad_state = USBD_HID_IDLE;
+    hhid->vend_tx_head = 0U;
+    hhid->vend_tx_count = 0U;
+    hhid->vend_extra_len = 0U;
+    hhid->vend_extra_sending = 0U;
+    hhid->vend_rx_paused = 0U;
 
     return (uint8_t)USBD_OK;
 }
@@ -301,6 +436,10 @@ static uint8_t USBD_HID_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx) {
     pdev->ep_out[VEND_HID_EPOUT_ADDR & 0xFU].is_used = 0U;
     pdev->ep_out[VEND_HID_EPOUT_ADDR & 0xFU].bInterval = 0U;
 
+    USBD_LL_CloseEP(pdev, GAMEPAD_HID_EPIN_ADDR);
+    pdev->ep_in[GAMEPAD_HID_EPIN_ADDR & 0xFU].is_used = 0U;
+    pdev->ep_in[GAMEPAD_HID_EPIN_ADDR & 0xFU].bInterval = 0U;
+
     /* Free allocated memory */
     if (pdev->pClassDataCmsit[pdev->classId] != NULL) {
         (void)USBD_free(pdev->pClassDataCmsit[pdev->classId]);
@@ -369,6 +508,9 @@ static uint8_t USBD_HID_Setup(USBD_HandleTypeDef *pdev,
                 } else if (if_num == 1) {
                     len = MIN(VEND_HID_REPORT_DESC_SIZE, req->wLength);
                     pbuf = VEND_HID_ReportDesc;
+                } else if (if_num == 2) {
+                    len = MIN(GAMEPAD_HID_REPORT_DESC_SIZE, req->wLength);
+                    pbuf = GAMEPAD_HID_ReportDesc;
                 } else {
                     USBD_CtlError(pdev, req);
                     ret = USBD_FAIL;
@@ -381,6 +523,9 @@ static uint8_t USBD_HID_Setup(USBD_HandleTypeDef *pdev,
                 } else if (if_num == 1) {
                     len = MIN(USB_VEND_HID_DESC_SIZ, req->wLength);
                     pbuf = USBD_VEND_HID_Desc;
+                } else if (if_num == 2) {
+                    len = MIN(USB_GAMEPAD_HID_DESC_SIZ, req->wLength);
+                    pbuf = USBD_GAMEPAD_HID_Desc;
                 } else {
                     USBD_CtlError(pdev, req);
                     ret = USBD_FAIL;
@@ -431,8 +576,58 @@ static uint8_t USBD_HID_Setup(USBD_HandleTypeDef *pdev,
     return (uint8_t)ret;
 }
 
-uint8_t USBD_HID_SendReport(USBD_HandleTypeDef *pdev, uint8_t ep_addr,
-                            uint8_t *report, uint16_t len) {
+// Starts the next report if the endpoint is idle, the extra one first. It
+// stays in its slot until transmitted. Interrupts have to be masked.
+static void USBD_HID_VendTransmitNext(USBD_HandleTypeDef *pdev,
+                                      USBD_HID_HandleTypeDef *hhid) {
+    if (hhid->vend_state != USBD_HID_IDLE) {
+        return;
+    }
+
+    if (hhid->vend_extra_len > 0U) {
+        hhid->vend_state = USBD_HID_BUSY;
+        hhid->vend_extra_sending = 1U;
+        (void)USBD_LL_Transmit(pdev, VEND_HID_EPIN_ADDR, hhid->vend_extra,
+                               hhid->vend_extra_len);
+    } else if (hhid->vend_tx_count > 0U) {
+        hhid->vend_state = USBD_HID_BUSY;
+        (void)USBD_LL_Transmit(pdev, VEND_HID_EPIN_ADDR,
+                               hhid->vend_tx_queue[hhid->vend_tx_head],
+                               hhid->vend_tx_len[hhid->vend_tx_head]);
+    }
+}
+
+static uint8_t USBD_HID_VendQueueReport(USBD_HandleTypeDef *pdev,
+                                        USBD_HID_HandleTypeDef *hhid,
+                                        uint8_t *report, uint16_t len) {
+    if (len > VEND_HID_EPSIZE) {
+        return (uint8_t)USBD_FAIL;
+    }
+
+    // Queue is also drained from USBD_HID_DataIn in the USB interrupt
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (hhid->vend_tx_count >= VEND_HID_TX_QUEUE_LEN) {
+        __set_PRIMASK(primask);
+        return (uint8_t)USBD_BUSY;
+    }
+
+    uint8_t slot =
+        (hhid->vend_tx_head + hhid->vend_tx_count) % VEND_HID_TX_QUEUE_LEN;
+    memcpy(hhid->vend_tx_queue[slot], report, len);
+    hhid->vend_tx_len[slot] = len;
+    hhid->vend_tx_count++;
+
+    USBD_HID_VendTransmitNext(pdev, hhid);
+
+    __set_PRIMASK(primask);
+
+    return (uint8_t)USBD_OK;
+}
+
+static uint8_t USBD_HID_Send(USBD_HandleTypeDef *pdev, uint8_t ep_addr,
+                             uint8_t *report, uint16_t len) {
     USBD_HID_HandleTypeDef *hhid =
         (USBD_HID_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
 
@@ -440,24 +635,81 @@ uint8_t USBD_HID_SendReport(USBD_HandleTypeDef *pdev, uint8_t ep_addr,
         return (uint8_t)USBD_FAIL;
     }
 
-    if (pdev->dev_state == USBD_STATE_CONFIGURED) {
-        if (ep_addr == HID_EPIN_ADDR) {
-            if (hhid->kb_state == USBD_HID_IDLE) {
-                hhid->kb_state = USBD_HID_BUSY;
-                (void)USBD_LL_Transmit(pdev, ep_addr, report, len);
-            }
+    if (pdev->dev_state != USBD_STATE_CONFIGURED) {
+        return (uint8_t)USBD_FAIL;
+    }
 
-        } else if (ep_addr == VEND_HID_EPIN_ADDR) {
-            if (hhid->vend_state == USBD_HID_IDLE) {
-                hhid->vend_state = USBD_HID_BUSY;
-                (void)USBD_LL_Transmit(pdev, ep_addr, report, len);
-            }
+    if (ep_addr == HID_EPIN_ADDR) {
+        if (hhid->kb_state != USBD_HID_IDLE) {
+            return (uint8_t)USBD_BUSY;
+        }
+        hhid->kb_state = USBD_HID_BUSY;
+        (void)USBD_LL_Transmit(pdev, ep_addr, report, len);
+
+    } else if (ep_addr == GAMEPAD_HID_EPIN_ADDR) {
+        if (hhid->gamepad_state != USBD_HID_IDLE) {
+            return (uint8_t)USBD_BUSY;
         }
+        hhid->gamepad_state = USBD_HID_BUSY;
+        (void)USBD_LL_Transmit(pdev, ep_addr, report, len);
+
+    } else if (ep_addr == VEND_HID_EPIN_ADDR) {
+        return USBD_HID_VendQueueReport(pdev, hhid, report, len);
     }
 
     return (uint8_t)USBD_OK;
 }
 
+uint8_t USBD_HID_SendReport(USBD_HandleTypeDef *pdev, uint8_t ep_addr,
+                            uint8_t *report, uint16_t len) {
+
+    uint8_t status = USBD_HID_Send(pdev, ep_addr, report, len);
+    TELEMETRY_COUNT(reports[status != USBD_OK]);
+
+    return status;
+}
+
+uint8_t USBD_HID_SendExtraReport(USBD_HandleTypeDef *pdev, uint8_t *report,
+                                 uint16_t len) {
+    USBD_HID_HandleTypeDef *hhid =
+        (USBD_HID_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+
+    if (hhid == NULL || pdev->dev_state != USBD_STATE_CONFIGURED ||
+        len > VEND_HID_EPSIZE) {
+        return (uint8_t)USBD_FAIL;
+    }
+
+    uint8_t status = (uint8_t)USBD_OK;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (hhid->vend_extra_len == 0U) {
+        memcpy(hhid->vend_extra, report, len);
+        hhid->vend_extra_len = len;
+        USBD_HID_VendTransmitNext(pdev, hhid);
+    } else {
+        status = (uint8_t)USBD_BUSY;
+    }
+
+    __set_PRIMASK(primask);
+
+    TELEMETRY_COUNT(reports[status != USBD_OK]);
+
+    return status;
+}
+
+uint8_t USBD_HID_VendTxFree(USBD_HandleTypeDef *pdev) {
+    USBD_HID_HandleTypeDef *hhid =
+        (USBD_HID_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+
+    if (hhid == NULL) {
+        return 0U;
+    }
+
+    return VEND_HID_TX_QUEUE_LEN - hhid->vend_tx_count;
+}
+
 uint32_t USBD_HID_GetPollingInterval(USBD_HandleTypeDef *pdev) {
     uint32_t polling_interval;
 
@@ -472,7 +724,7 @@ uint32_t USBD_HID_GetPollingInterval(USBD_HandleTypeDef *pdev) {
     {
         /* Sets the data transfer polling interval for low and full
         speed transfers */
-        polling_interval = HID_FS_BINTERVAL;
+        polling_interval = HID_KB_FS_BINTERVAL;
     }
 
     return ((uint32_t)(polling_interval));
@@ -483,7 +735,7 @@ static uint8_t *USBD_HID_GetFSCfgDesc(uint16_t *length) {
         USBD_GetEpDesc(USBD_HID_CfgDesc, HID_EPIN_ADDR);
 
     if (pEpDesc != NULL) {
-        pEpDesc->bInterval = HID_FS_BINTERVAL;
+        pEpDesc->bInterval = HID_KB_FS_BINTERVAL;
     }
 
     *length = (uint16_t)sizeof(USBD_HID_CfgDesc);
@@ -507,7 +759,7 @@ static uint8_t *USBD_HID_GetOtherSpeedCfgDesc(uint16_t *length) {
         USBD_GetEpDesc(USBD_HID_CfgDesc, HID_EPIN_ADDR);
 
     if (pEpDesc != NULL) {
-        pEpDesc->bInterval = HID_FS_BINTERVAL;
+        pEpDesc->bInterval = HID_KB_FS_BINTERVAL;
     }
 
     *length = (uint16_t)sizeof(USBD_HID_CfgDesc);
@@ -515,23 +767,76 @@ static uint8_t *USBD_HID_GetOtherSpeedCfgDesc(uint16_t *length) {
 }
 
 static uint8_t USBD_HID_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum) {
+    USBD_HID_HandleTypeDef *hhid =
+        (USBD_HID_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+
     if (epnum == (HID_EPIN_ADDR & 0x7F)) {
-        ((USBD_HID_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId])
-            ->kb_state = USBD_HID_IDLE;
+        hhid->kb_state = USBD_HID_IDLE;
+        // Completes right after the IN token, the closest we get to it
+        sof_sync_on_report_collected();
+    } else if (epnum == (GAMEPAD_HID_EPIN_ADDR & 0x7F)) {
+        hhid->gamepad_state = USBD_HID_IDLE;
     } else if (epnum == (VEND_HID_EPIN_ADDR & 0x7F)) {
-        ((USBD_HID_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId])
-            ->vend_state = USBD_HID_IDLE;
+        // Transmitted report frees its slot, move on to the next one
+        if (hhid->vend_extra_sending) {
+            hhid->vend_extra_sending = 0U;
+            hhid->vend_extra_len = 0U;
+        } else {
+            hhid->vend_tx_head =
+                (hhid->vend_tx_head + 1U) % VEND_HID_TX_QUEUE_LEN;
+            hhid->vend_tx_count--;
+        }
+
+        hhid->vend_state = USBD_HID_IDLE;
+        USBD_HID_VendTransmitNext(pdev, hhid);
+
+        if (hhid->vend_rx_paused &&
+            USBD_HID_VendTxFree(pdev) >= VEND_HID_RX_RESUME_THRESHOLD) {
+            hhid->vend_rx_paused = 0U;
+            USBD_LL_PrepareReceive(pdev, VEND_HID_EPOUT_ADDR, vendRxBuf,
+                                   VEND_HID_EPSIZE);
+        }
     }
 
     return (uint8_t)USBD_OK;
 }
 
+// Phase reference of the scan scheduling, see sof_sync.h
+static uint8_t USBD_HID_SOF(USBD_HandleTypeDef *pdev) {
+    UNUSED(pdev);
+
+    sof_sync_on_sof();
+
+    return (uint8_t)USBD_OK;
+}
+
 static uint8_t USBD_HID_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum) {
 
     if (epnum == (VEND_HID_EPOUT_ADDR & 0x7F)) {
-        interface_handle_new_packet(COMMUNICATION_SOURCE_USB, vendRxBuf, 63);
-        USBD_LL_PrepareReceive(pdev, VEND_HID_EPOUT_ADDR, vendRxBuf,
-                               VEND_HID_EPSIZE);
+        // The packet is already out of packet memory, so with room for the
+        // replies to this and the next one the endpoint is re-armed before
+        // handling it. The next packet comes in meanwhile, its interrupt is
+        // only handled after this one returns.
+        bool rearmed =
+            USBD_HID_VendTxFree(pdev) >= 2U * VEND_HID_RX_RESUME_THRESHOLD;
+        if (rearmed) {
+            USBD_LL_PrepareReceive(pdev, VEND_HID_EPOUT_ADDR, vendRxBuf,
+                                   VEND_HID_EPSIZE);
+        }
+
+        transport_receive(&usb_transport, vendRxBuf, VEND_HID_EPSIZE - 1U);
+
+        // Keep NAKing the host until there is room for the next reply
+        if (rearmed) {
+            return (uint8_t)USBD_OK;
+        }
+        if (USBD_HID_VendTxFree(pdev) >= VEND_HID_RX_RESUME_THRESHOLD) {
+            USBD_LL_PrepareReceive(pdev, VEND_HID_EPOUT_ADDR, vendRxBuf,
+                                   VEND_HID_EPSIZE);
+        } else {
+            ((USBD_HID_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId])
+                ->vend_rx_paused = 1U;
+        }
     }
 
     return (uint8_t)USBD_OK;
@@ -0,0 +1,120 @@
+#include "settings.h"
+
+#if defined(WATCHDOG_ENABLED) && WATCHDOG_ENABLED == 1
+
+#include "watchdog.h"
+
+#include "hal_iwdg.h"
+#include "hal_systick.h"
+
+#include "logging.h"
+#include "postmortem.h"
+
+#include "stm32wbxx.h"
+
+#define WATCHDOG_RECORD_MAGIC 0x57444F47U
+
+typedef struct {
+
+    uint32_t magic;
+    uint32_t overruns;
+    uint32_t last_overrun;
+    uint32_t last_overrun_time;
+    uint32_t last_feed_time;
+
+} watchdog_record_t;
+
+// Outlives the reset, read back on the next boot
+static watchdog_record_t record __attribute__((section(".noinit")));
+
+static watchdog_report_t report;
+
+static inline void watchdog_load_record(uint32_t reset_flags) {
+
+    report.reset_flags = reset_flags;
+
+    // RAM content doesn't survive a power-on or brownout reset
+    if (record.magic == WATCHDOG_RECORD_MAGIC &&
+        !(report.reset_flags & RCC_CSR_BORRSTF)) {
+        report.previous_overruns = record.overruns;
+        report.previous_last_overrun = record.last_overrun;
+        report.previous_last_overrun_time = record.last_overrun_time;
+        report.previous_last_feed_time = record.last_feed_time;
+    }
+
+    record.magic = WATCHDOG_RECORD_MAGIC;
+    record.overruns = 0U;
+    record.last_overrun = 0U;
+    record.last_overrun_time = 0U;
+    record.last_feed_time = systick_get_tick();
+}
+
+hal_err setup_watchdog(uint32_t reset_flags) {
+
+    LOG_INFO("Setting up...");
+
+    watchdog_load_record(reset_flags);
+
+    if (report.reset_flags & RCC_CSR_IWDGRSTF) {
+        LOG_ERROR("Reset by the watchdog, last fed at %u ms, %u overruns "
+                  "(last %u us at %u ms)",
+                  report.previous_last_feed_time, report.previous_overruns,
+                  report.previous_last_overrun,
+                  report.previous_last_overrun_time);
+    }
+
+    // LSI cycles per 4, doubled by every prescaler step
+    uint32_t reload = WATCHDOG_TIMEOUT_MS * (IWDG_LSI_VALUE / 1000U) / 4U;
+    iwdg_prescaler prescaler = IWDG_PRESCALER_4;
+    while (reload > IWDG_RELOAD_MAX + 1U && prescaler < IWDG_PRESCALER_256) {
+        reload /= 2U;
+        prescaler++;
+    }
+    if (reload > IWDG_RELOAD_MAX + 1U) {
+        reload = IWDG_RELOAD_MAX + 1U;
+    }
+
+#ifdef DEBUG
+    iwdg_freeze_in_debug();
+#endif // DEBUG
+
+    hal_err err = iwdg_init(prescaler, reload - 1U);
+    if (err) {
+        LOG_CRITICAL("Unable to start the watchdog: Error %d", err);
+        return err;
+    }
+
+    LOG_INFO("Setup complete.");
+
+    return OK;
+}
+
+void watchdog_cycle_complete(uint32_t duration) {
+
+    if (duration > WATCHDOG_BUDGET) {
+        record.overruns++;
+        record.last_overrun = duration;
+        record.last_overrun_time = systick_get_tick();
+        postmortem_trace(POSTMORTEM_EVENT_OVERRUN,
+                         duration > UINT16_MAX ? UINT16_MAX : duration);
+        return;
+    }
+
+    watchdog_feed();
+}
+
+void watchdog_feed() {
+    iwdg_refresh();
+    record.last_feed_time = systick_get_tick();
+}
+
+watchdog_report_t watchdog_get_report() {
+
+    report.overruns = record.overruns;
+    report.last_overrun = record.last_overrun;
+    report.last_overrun_time = record.last_overrun_time;
+
+    return report;
+}
+
+#endif // WATCHDOG_ENABLED
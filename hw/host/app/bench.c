@@ -0,0 +1,134 @@
+#include "sim.h"
+
+#include "adc.h"
+#include "eeprom.h"
+#include "error_handler.h"
+#include "fw_update_handler.h"
+#include "interface_handler.h"
+#include "keyboard.h"
+#include "settings.h"
+#include "usb.h"
+#include "usb/usbd_hid.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Microbenchmarks of the firmware core on the host. Output is one line per
+// benchmark, `<name> <iterations> <ns/op>`, so runs of different commits can
+// be diffed. Host timings, only comparable between runs on the same machine.
+
+#define BENCH_SCAN_ITERATIONS 200000U
+#define BENCH_PROTOCOL_ITERATIONS 200000U
+
+// Scans a key is held for, keys are pressed one after another
+#define BENCH_STROKE_SCANS 8U
+
+#define BENCH_RELEASED_VALUE 100U
+#define BENCH_PRESSED_VALUE 900U
+
+static uint64_t bench_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+static void bench_report(const char *name, uint32_t iterations,
+                         uint64_t elapsed) {
+    printf("%-10s %8u %10.1f\n", name, iterations,
+           (double)elapsed / iterations);
+}
+
+// Conversions follow the scan order, one per key
+static uint16_t bench_typing_source(uint8_t channel, uint32_t conversion) {
+    (void)channel;
+
+    uint32_t scan = conversion / KB_KEY_COUNT;
+    uint32_t key = conversion % KB_KEY_COUNT;
+    uint32_t pressed = (scan / BENCH_STROKE_SCANS) % KB_KEY_COUNT;
+
+    return key == pressed ? BENCH_PRESSED_VALUE : BENCH_RELEASED_VALUE;
+}
+
+static void bench_scan() {
+
+    uint8_t packet[64];
+    uint16_t length;
+    uint32_t reports = 0U;
+
+    sim_adc_set_source(bench_typing_source);
+
+    uint64_t start = bench_now();
+    for (uint32_t i = 0; i < BENCH_SCAN_ITERATIONS; i++) {
+        sim_advance_ns(125000U);
+        kb_handle();
+        fw_update_handler();
+        if (sim_usb_in(HID_EPIN_ADDR, packet, &length)) {
+            reports++;
+        }
+        while (sim_usb_in(VEND_HID_EPIN_ADDR, packet, &length)) {
+        }
+        while (sim_usb_in(GAMEPAD_HID_EPIN_ADDR, packet, &length)) {
+        }
+    }
+    uint64_t elapsed = bench_now() - start;
+
+    if (reports == 0U) {
+        sim_fatal("No keyboard reports sent");
+    }
+
+    bench_report("scan", BENCH_SCAN_ITERATIONS, elapsed);
+}
+
+// Request and reply of a short vendor request over the HID endpoints
+static void bench_protocol() {
+
+    ykb_protocol_t request;
+    memset(&request, 0, sizeof(request));
+    request.request_and_version = YKB_EXTENDED_REQUEST | YKB_PROTOCOL_VERSION;
+    request.data[0] = YKB_EXT_GET_PROFILE;
+
+    uint8_t packet[64];
+    uint16_t length;
+
+    uint64_t start = bench_now();
+    for (uint32_t i = 0; i < BENCH_PROTOCOL_ITERATIONS; i++) {
+        if (!sim_usb_out(VEND_HID_EPOUT_ADDR, (const uint8_t *)&request,
+                         sizeof(request))) {
+            sim_fatal("Vendor OUT endpoint not armed");
+        }
+        if (!sim_usb_in(VEND_HID_EPIN_ADDR, packet, &length)) {
+            sim_fatal("No reply to request %u", i);
+        }
+        if (packet[0] != VEND_HID_REPORT_ID ||
+            packet[1] != request.request_and_version) {
+            sim_fatal("Unexpected reply %02x %02x", packet[0], packet[1]);
+        }
+    }
+    uint64_t elapsed = bench_now() - start;
+
+    bench_report("protocol", BENCH_PROTOCOL_ITERATIONS, elapsed);
+}
+
+int main() {
+
+    sim_init();
+
+    ERR_H(eeprom_init());
+    ERR_H(setup_fw_update_handler());
+    ERR_H(setup_adc());
+    ERR_H(kb_init());
+    ERR_H(setup_usb());
+
+    if (!sim_usb_configure()) {
+        sim_fatal("USB configuration failed");
+    }
+
+    printf("# ykb-sim-bench %s\n", GIT_HASH);
+
+    bench_scan();
+    bench_protocol();
+
+    return EXIT_SUCCESS;
+}
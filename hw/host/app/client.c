@@ -0,0 +1,264 @@
+#include "ykb_client.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Command line front end of the client library, talking to the device
+// emulator: started by the client, or already listening on a socket.
+//
+//   client -e <emulator> | -s <socket> <command>
+//
+//   settings  prints the settings reply
+//   values    prints the ADC value of every key
+//   bench     request rate one at a time and pipelined, then the throughput
+//             of a firmware upload (the device restarts afterwards)
+
+#define CLIENT_BENCH_REQUESTS 2000U
+// Under 255 packets, the packet number is a byte
+#define CLIENT_BENCH_IMAGE_SIZE (8U * 1024U)
+
+#define CLIENT_REPLY_SIZE 1024U
+
+typedef struct {
+    uint32_t done;
+    uint32_t failed;
+    uint32_t length;
+} client_result_t;
+
+static int fd = -1;
+
+static uint64_t client_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+static void client_done(void *user, int status, const uint8_t *reply,
+                        uint32_t length) {
+    (void)reply;
+
+    client_result_t *result = user;
+    result->done++;
+    result->length = length;
+    if (status) {
+        result->failed++;
+        fprintf(stderr, "client: request failed: Error %d\n", status);
+    }
+}
+
+static int client_spawn(const char *emulator) {
+
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, pair)) {
+        fprintf(stderr, "client: socketpair: %s\n", strerror(errno));
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        fprintf(stderr, "client: fork: %s\n", strerror(errno));
+        return -1;
+    }
+
+    if (pid == 0) {
+        close(pair[0]);
+        char device[16];
+        snprintf(device, sizeof(device), "%d", pair[1]);
+        execl(emulator, emulator, "-f", device, (char *)NULL);
+        fprintf(stderr, "client: %s: %s\n", emulator, strerror(errno));
+        _exit(EXIT_FAILURE);
+    }
+
+    close(pair[1]);
+    return pair[0];
+}
+
+static int client_connect(const char *path) {
+
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "client: socket path too long\n");
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+
+    int sock = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (sock < 0 ||
+        connect(sock, (struct sockaddr *)&address, sizeof(address))) {
+        fprintf(stderr, "client: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    return sock;
+}
+
+static int client_settings(ykb_client_t *client) {
+
+    uint8_t reply[CLIENT_REPLY_SIZE];
+    client_result_t result = {0};
+
+    ykb_client_get(client, YKB_CLIENT_GET_SETTINGS, reply, sizeof(reply),
+                   client_done, &result);
+    int err = ykb_client_wait(client);
+    if (err || result.failed) {
+        return EXIT_FAILURE;
+    }
+
+    for (uint32_t i = 0; i < result.length; i++) {
+        printf("%02x%c", reply[i], i % 16U == 15U ? '\n' : ' ');
+    }
+    printf("\n");
+
+    return EXIT_SUCCESS;
+}
+
+static int client_values(ykb_client_t *client) {
+
+    uint16_t values[CLIENT_REPLY_SIZE / sizeof(uint16_t)];
+    client_result_t result = {0};
+
+    ykb_client_get(client, YKB_CLIENT_GET_VALUES, (uint8_t *)values,
+                   sizeof(values), client_done, &result);
+    int err = ykb_client_wait(client);
+    if (err || result.failed) {
+        return EXIT_FAILURE;
+    }
+
+    for (uint32_t i = 0; i < result.length / sizeof(uint16_t); i++) {
+        printf("%2u %4u\n", i, values[i]);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// Same request over and over, `window` of them in flight
+static int client_bench_requests(ykb_client_t *client, uint8_t window) {
+
+    static uint8_t replies[YKB_CLIENT_WINDOW][CLIENT_REPLY_SIZE];
+    client_result_t result = {0};
+    uint32_t submitted = 0U;
+
+    ykb_client_set_window(client, window);
+
+    uint64_t start = client_now();
+    while (result.done < CLIENT_BENCH_REQUESTS) {
+        while (submitted < CLIENT_BENCH_REQUESTS &&
+               submitted - result.done < window) {
+            ykb_client_get(client, YKB_CLIENT_GET_SETTINGS,
+                           replies[submitted % YKB_CLIENT_WINDOW],
+                           CLIENT_REPLY_SIZE, client_done, &result);
+            submitted++;
+        }
+        if (ykb_client_poll(client, YKB_CLIENT_TIMEOUT_MS)) {
+            return EXIT_FAILURE;
+        }
+    }
+    uint64_t elapsed = client_now() - start;
+
+    printf("requests-w%u %8u %10.1f us/op %u failed\n", window,
+           CLIENT_BENCH_REQUESTS, (double)elapsed / 1000.0 / result.done,
+           result.failed);
+
+    return result.failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static int client_bench_upload(ykb_client_t *client) {
+
+    static uint8_t image[CLIENT_BENCH_IMAGE_SIZE];
+    for (uint32_t i = 0; i < sizeof(image); i++) {
+        image[i] = (uint8_t)(i * 7U);
+    }
+
+    client_result_t result = {0};
+
+    ykb_client_set_window(client, YKB_CLIENT_WINDOW);
+
+    uint64_t start = client_now();
+    int err = ykb_client_set(client, YKB_CLIENT_FIRMWARE_UPDATE, image,
+                             sizeof(image), client_done, &result);
+    if (!err) {
+        err = ykb_client_wait(client);
+    }
+    uint64_t elapsed = client_now() - start;
+
+    if (err || result.failed) {
+        return EXIT_FAILURE;
+    }
+
+    printf("upload     %8u %10.1f KiB/s\n", CLIENT_BENCH_IMAGE_SIZE,
+           CLIENT_BENCH_IMAGE_SIZE / 1024.0 / (elapsed / 1e9));
+
+    return EXIT_SUCCESS;
+}
+
+static int client_bench(ykb_client_t *client) {
+
+    if (client_bench_requests(client, 1U) ||
+        client_bench_requests(client, YKB_CLIENT_WINDOW) ||
+        client_bench_upload(client)) {
+        return EXIT_FAILURE;
+    }
+
+    const ykb_client_stats_t *stats = &client->stats;
+    printf("# sent %u received %u resends %u crc errors %u unexpected %u\n",
+           stats->packets_sent, stats->packets_received, stats->resends,
+           stats->crc_errors, stats->unexpected);
+
+    return EXIT_SUCCESS;
+}
+
+static int client_usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s -e <emulator> | -s <socket> settings|values|bench\n",
+            program);
+    return EXIT_FAILURE;
+}
+
+int main(int argc, char **argv) {
+
+    if (argc != 4) {
+        return client_usage(argv[0]);
+    }
+
+    if (strcmp(argv[1], "-e") == 0) {
+        fd = client_spawn(argv[2]);
+    } else if (strcmp(argv[1], "-s") == 0) {
+        fd = client_connect(argv[2]);
+    } else {
+        return client_usage(argv[0]);
+    }
+
+    if (fd < 0) {
+        return EXIT_FAILURE;
+    }
+
+    ykb_client_io_t io;
+    ykb_client_io_fd(&io, &fd);
+
+    ykb_client_t client;
+    ykb_client_init(&client, &io);
+
+    int status;
+    if (strcmp(argv[3], "settings") == 0) {
+        status = client_settings(&client);
+    } else if (strcmp(argv[3], "values") == 0) {
+        status = client_values(&client);
+    } else if (strcmp(argv[3], "bench") == 0) {
+        status = client_bench(&client);
+    } else {
+        status = client_usage(argv[0]);
+    }
+
+    close(fd);
+    while (wait(NULL) > 0) {
+    }
+
+    return status;
+}
@@ -0,0 +1,180 @@
+#include "sim.h"
+
+#include "adc.h"
+#include "eeprom.h"
+#include "error_handler.h"
+#include "fw_update_handler.h"
+#include "keyboard.h"
+#include "usb.h"
+#include "usb/usbd_hid.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// The firmware core behind a socket, as a device for host tools. Every packet
+// read from the socket goes to the vendor OUT endpoint, every report of the
+// vendor IN endpoint is written back (report ID included, like hidraw), so
+// requests run through the same USB, transport and handler code as on the
+// keyboard. Scans run in virtual time, 125 us apart, while the host is idle
+// the emulator sleeps until the next request.
+//
+//   emulator <path>   serves one connection on a SOCK_SEQPACKET socket
+//   emulator -f <fd>  uses an already connected socket (e.g. a socketpair)
+//
+// A system reset (firmware update) restarts the emulator on the same
+// connection, the fake flash is not kept.
+
+#define EMULATOR_SCAN_NS 125000U
+#define EMULATOR_SOF_SCANS 8U
+// Waiting for a request while no packet is held
+#define EMULATOR_IDLE_MS 1
+
+#define EMULATOR_RELEASED_VALUE 100U
+
+static int connection = -1;
+static const char *program = NULL;
+
+static uint16_t emulator_source(uint8_t channel, uint32_t conversion) {
+    (void)channel;
+    (void)conversion;
+
+    return EMULATOR_RELEASED_VALUE;
+}
+
+static void emulator_reset() {
+
+    fprintf(stderr, "emulator: reset\n");
+
+    char fd[16];
+    snprintf(fd, sizeof(fd), "%d", connection);
+
+    execl("/proc/self/exe", program, "-f", fd, (char *)NULL);
+    sim_fatal("Unable to restart: %s", strerror(errno));
+}
+
+static int emulator_listen(const char *path) {
+
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        sim_fatal("Socket path too long");
+    }
+    strcpy(address.sun_path, path);
+
+    int server = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (server < 0) {
+        sim_fatal("socket: %s", strerror(errno));
+    }
+
+    unlink(path);
+    if (bind(server, (struct sockaddr *)&address, sizeof(address)) ||
+        listen(server, 1)) {
+        sim_fatal("%s: %s", path, strerror(errno));
+    }
+
+    fprintf(stderr, "emulator: listening on %s\n", path);
+
+    int fd = accept(server, NULL, NULL);
+    if (fd < 0) {
+        sim_fatal("accept: %s", strerror(errno));
+    }
+
+    close(server);
+    unlink(path);
+
+    return fd;
+}
+
+static void emulator_send(const uint8_t *packet, uint16_t length) {
+    if (write(connection, packet, length) != length) {
+        // Host went away
+        exit(EXIT_SUCCESS);
+    }
+}
+
+static void emulator_run() {
+
+    uint8_t request[64];
+    ssize_t request_length = 0;
+    bool held = false;
+
+    uint8_t packet[64];
+    uint16_t length;
+
+    for (uint32_t scan = 0;; scan++) {
+
+        if (!held) {
+            struct pollfd pfd = {.fd = connection, .events = POLLIN};
+            if (poll(&pfd, 1, EMULATOR_IDLE_MS) > 0) {
+                request_length = read(connection, request, sizeof(request));
+                if (request_length <= 0) {
+                    return;
+                }
+                held = true;
+            }
+        }
+
+        // NAKed while the device hasn't taken the previous packet
+        if (held && sim_usb_out(VEND_HID_EPOUT_ADDR, request,
+                                (uint16_t)request_length)) {
+            held = false;
+        }
+
+        while (sim_usb_in(VEND_HID_EPIN_ADDR, packet, &length)) {
+            emulator_send(packet, length);
+        }
+        while (sim_usb_in(HID_EPIN_ADDR, packet, &length)) {
+        }
+        while (sim_usb_in(GAMEPAD_HID_EPIN_ADDR, packet, &length)) {
+        }
+
+        if (scan % EMULATOR_SOF_SCANS == 0U) {
+            sim_usb_sof();
+        }
+
+        sim_advance_ns(EMULATOR_SCAN_NS);
+        kb_handle();
+        fw_update_handler();
+    }
+}
+
+int main(int argc, char **argv) {
+
+    program = argv[0];
+
+    if (argc == 3 && strcmp(argv[1], "-f") == 0) {
+        connection = atoi(argv[2]);
+    } else if (argc == 2 && argv[1][0] != '-') {
+        connection = emulator_listen(argv[1]);
+    } else {
+        fprintf(stderr, "Usage: %s <socket path> | -f <fd>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Kept over the restart of a system reset
+    fcntl(connection, F_SETFD, 0);
+
+    sim_init();
+    sim_set_reset_handler(emulator_reset);
+    sim_adc_set_source(emulator_source);
+
+    ERR_H(eeprom_init());
+    ERR_H(setup_fw_update_handler());
+    ERR_H(setup_adc());
+    ERR_H(kb_init());
+    ERR_H(setup_usb());
+
+    if (!sim_usb_configure()) {
+        sim_fatal("USB configuration failed");
+    }
+
+    emulator_run();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,288 @@
+#include "sim.h"
+
+#include "frame.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Checks the split link framing (frame.h) on its own: encoded frames decode
+// back to their payload, corrupted ones are rejected and the decoder picks up
+// the next frame after any garbage. One line per case: `<case> ok` or the
+// first failure.
+
+// Longest stream of frames and garbage a case feeds at once
+#define FRAME_TEST_STREAM_MAX (FRAME_ENCODED_MAX * 4U)
+
+#define FRAME_TEST_ROUNDS 64U
+
+typedef struct {
+
+    uint32_t ok;
+    uint32_t errors;
+    // Payload of the last decoded frame
+    uint8_t payload[FRAME_PAYLOAD_MAX];
+    size_t length;
+
+} frame_test_result_t;
+
+static uint32_t random_state = 1U;
+
+static uint8_t frame_test_random() {
+    random_state = random_state * 1103515245U + 12345U;
+    return random_state >> 16;
+}
+
+static void frame_test_fill(uint8_t *payload, size_t length, uint8_t round) {
+    for (size_t i = 0; i < length; i++) {
+        switch (round % 4U) {
+        case 0U:
+            payload[i] = 0U;
+            break;
+        case 1U:
+            payload[i] = 0xFFU;
+            break;
+        case 2U:
+            // Zeros spaced out, the COBS codes vary
+            payload[i] = i % (round % 7U + 1U) ? (uint8_t)(i + 1U) : 0U;
+            break;
+        default:
+            payload[i] = frame_test_random();
+            break;
+        }
+    }
+}
+
+static void frame_test_feed(frame_decoder_t *decoder, const uint8_t *stream,
+                            size_t length, frame_test_result_t *result) {
+    for (size_t i = 0; i < length; i++) {
+        size_t payload_length;
+        switch (frame_decoder_push(decoder, stream[i], &payload_length)) {
+        case FRAME_DECODE_OK:
+            result->ok++;
+            memcpy(result->payload, decoder->buffer, payload_length);
+            result->length = payload_length;
+            break;
+        case FRAME_DECODE_ERROR:
+            result->errors++;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static bool frame_test_fail(const char *name, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static bool frame_test_fail(const char *name, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    printf("%-20s FAIL: ", name);
+    vprintf(format, args);
+    printf("\n");
+    va_end(args);
+    return false;
+}
+
+// Every payload length, each with zeros, no zeros and random content
+static bool frame_test_round_trip() {
+
+    const char *name = "round-trip";
+    uint8_t payload[FRAME_PAYLOAD_MAX];
+    uint8_t frame[FRAME_ENCODED_MAX];
+
+    for (size_t length = 0U; length <= FRAME_PAYLOAD_MAX; length++) {
+        for (uint8_t round = 0U; round < 8U; round++) {
+            frame_test_fill(payload, length, round);
+
+            size_t size = frame_encode(payload, length, frame);
+            if (size == 0U || size > FRAME_ENCODED_MAX) {
+                return frame_test_fail(name, "length %zu encoded to %zu",
+                                       length, size);
+            }
+            if (memchr(frame, FRAME_DELIMITER, size - 1U) ||
+                frame[size - 1U] != FRAME_DELIMITER) {
+                return frame_test_fail(name, "length %zu misplaced delimiter",
+                                       length);
+            }
+
+            frame_decoder_t decoder;
+            frame_decoder_reset(&decoder);
+            frame_test_result_t result = {0};
+            frame_test_feed(&decoder, frame, size, &result);
+
+            if (result.ok != 1U || result.errors != 0U ||
+                result.length != length ||
+                memcmp(result.payload, payload, length) != 0) {
+                return frame_test_fail(name, "length %zu round %u decoded "
+                                             "%u ok %u errors %zu bytes",
+                                       length, round, result.ok,
+                                       result.errors, result.length);
+            }
+        }
+    }
+
+    uint8_t oversized[FRAME_PAYLOAD_MAX + 1U] = {0};
+    if (frame_encode(oversized, sizeof(oversized), frame) != 0U) {
+        return frame_test_fail(name, "oversized payload encoded");
+    }
+
+    printf("%-20s ok\n", name);
+    return true;
+}
+
+// Every single bit flip of a frame, a flip to zero splits it in two
+static bool frame_test_corruption() {
+
+    const char *name = "corruption";
+    uint8_t payload[24];
+    uint8_t frame[FRAME_ENCODED_MAX];
+
+    for (uint8_t round = 0U; round < 4U; round++) {
+        frame_test_fill(payload, sizeof(payload), round);
+        size_t size = frame_encode(payload, sizeof(payload), frame);
+
+        for (size_t i = 0; i < size - 1U; i++) {
+            for (uint8_t bit = 0U; bit < 8U; bit++) {
+                uint8_t corrupted[FRAME_ENCODED_MAX];
+                memcpy(corrupted, frame, size);
+                corrupted[i] ^= 1U << bit;
+
+                frame_decoder_t decoder;
+                frame_decoder_reset(&decoder);
+                frame_test_result_t result = {0};
+                frame_test_feed(&decoder, corrupted, size, &result);
+
+                if (result.ok != 0U || result.errors == 0U) {
+                    return frame_test_fail(name,
+                                           "round %u byte %zu bit %u: "
+                                           "%u ok %u errors",
+                                           round, i, bit, result.ok,
+                                           result.errors);
+                }
+            }
+        }
+    }
+
+    printf("%-20s ok\n", name);
+    return true;
+}
+
+// Garbage, an overlong frame and a truncated one, each dropped as a single
+// frame, followed by a good one which has to come through
+static bool frame_test_resync() {
+
+    const char *name = "resync";
+    uint8_t payload[32];
+    uint8_t frame[FRAME_ENCODED_MAX];
+    uint8_t stream[FRAME_TEST_STREAM_MAX];
+
+    for (uint8_t round = 0U; round < FRAME_TEST_ROUNDS; round++) {
+        frame_test_fill(payload, sizeof(payload), round);
+        size_t size = frame_encode(payload, sizeof(payload), frame);
+
+        size_t length = 0U;
+
+        // Idle line
+        stream[length++] = FRAME_DELIMITER;
+        stream[length++] = FRAME_DELIMITER;
+
+        switch (round % 3U) {
+        case 0U: {
+            // Noise, terminated by the next delimiter
+            size_t noise = frame_test_random() % FRAME_ENCODED_MAX + 1U;
+            for (size_t i = 0; i < noise; i++) {
+                stream[length++] = frame_test_random() | 0x01U;
+            }
+            stream[length++] = FRAME_DELIMITER;
+            break;
+        }
+        case 1U:
+            // Longer than any frame
+            memset(&stream[length], 0x5A, FRAME_ENCODED_MAX + 8U);
+            length += FRAME_ENCODED_MAX + 8U;
+            stream[length++] = FRAME_DELIMITER;
+            break;
+        default: {
+            // Lost tail, the cut frame takes the next one down with it
+            size_t cut = frame_test_random() % (size - 1U) + 1U;
+            memcpy(&stream[length], frame, cut);
+            length += cut;
+            memcpy(&stream[length], frame, size);
+            length += size;
+            break;
+        }
+        }
+
+        memcpy(&stream[length], frame, size);
+        length += size;
+
+        frame_decoder_t decoder;
+        frame_decoder_reset(&decoder);
+        frame_test_result_t result = {0};
+        frame_test_feed(&decoder, stream, length, &result);
+
+        if (result.ok != 1U || result.errors != 1U ||
+            result.length != sizeof(payload) ||
+            memcmp(result.payload, payload, sizeof(payload)) != 0) {
+            return frame_test_fail(name, "round %u: %u ok %u errors", round,
+                                   result.ok, result.errors);
+        }
+    }
+
+    printf("%-20s ok\n", name);
+    return true;
+}
+
+// Frames back to back, as the UART DMA delivers them
+static bool frame_test_stream() {
+
+    const char *name = "stream";
+    uint8_t payloads[FRAME_TEST_ROUNDS][16];
+    uint8_t frame[FRAME_ENCODED_MAX];
+
+    frame_decoder_t decoder;
+    frame_decoder_reset(&decoder);
+
+    for (uint8_t round = 0U; round < FRAME_TEST_ROUNDS; round++) {
+        size_t length = round % sizeof(payloads[0]) + 1U;
+        frame_test_fill(payloads[round], length, round);
+        size_t size = frame_encode(payloads[round], length, frame);
+
+        frame_test_result_t result = {0};
+        frame_test_feed(&decoder, frame, size, &result);
+
+        if (result.ok != 1U || result.errors != 0U ||
+            result.length != length ||
+            memcmp(result.payload, payloads[round], length) != 0) {
+            return frame_test_fail(name, "frame %u: %u ok %u errors", round,
+                                   result.ok, result.errors);
+        }
+    }
+
+    printf("%-20s ok\n", name);
+    return true;
+}
+
+int main() {
+
+    sim_init();
+
+    printf("# ykb-sim-frame-test %s\n", GIT_HASH);
+
+    uint32_t failed = 0U;
+
+    failed += !frame_test_round_trip();
+    failed += !frame_test_corruption();
+    failed += !frame_test_resync();
+    failed += !frame_test_stream();
+
+    if (failed) {
+        printf("%u failed\n", failed);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,667 @@
+#include "sim.h"
+
+#include "adc.h"
+#include "capture.h"
+#include "eeprom.h"
+#include "error_handler.h"
+#include "fw_update_handler.h"
+#include "keyboard.h"
+#include "keys.h"
+#include "predict.h"
+#include "usb.h"
+#include "usb/usbd_hid.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Feeds an ADC trace through the firmware's scan (thresholds, race mode,
+// predictive actuation, SOCD...) and checks the keyboard reports it sends
+// against the strokes in the trace.
+//
+// A trace is either a text file, one frame per line: `<time_us> <value of
+// every key in scan order>`, '#' starts a comment, or a `.bin` dump of
+// `capture_frame_t`s as read by YKB_EXT_CAPTURE_READ. `synthetic` generates
+// one instead.
+//
+// A stroke is the trace's value of a key staying above the reference level
+// (percentage of the key's travel in the trace). Every stroke is expected to
+// be reported as exactly one press:
+// - latency: report time minus the time the stroke reached the reference
+// - missed: strokes which were never reported
+// - chatter: reported presses beyond one per stroke, or without a stroke
+// - early, confirmed, false: predictive actuations, as counted by the firmware
+// - saved_us: scans the confirmed ones were ahead, times the frame period
+//
+// Each configuration runs in its own process, so the firmware starts from
+// scratch for every one of them.
+
+extern kb_state_t kb_state;
+
+#define REPLAY_CONFIG_MAX 2U
+
+// Release level of a stroke, below the reference
+#define REPLAY_HYSTERESIS 10U
+
+// Keys moving less than this in the trace are only noise. They're calibrated
+// to the largest travel of the others.
+#define REPLAY_TRAVEL_MIN 100U
+
+// Reported presses are matched to strokes this far around them
+#define REPLAY_MATCH_LEAD_US 20000U
+#define REPLAY_MATCH_GRACE_US 20000U
+
+// Synthetic trace
+#define REPLAY_PERIOD_US 125U
+#define REPLAY_REST_VALUE 100U
+#define REPLAY_TRAVEL_VALUE 800U
+#define REPLAY_NOISE 4U
+
+typedef struct {
+
+    const char *name;
+    kb_mode mode;
+    uint8_t threshold;
+    uint8_t predictive_actuation;
+
+} replay_config_t;
+
+typedef struct {
+
+    uint8_t key_index;
+    uint32_t start; // us
+    uint32_t end;
+    bool reported;
+
+} replay_stroke_t;
+
+typedef struct {
+
+    uint32_t frames;
+    uint32_t strokes;
+    uint32_t presses;
+    uint32_t matched;
+    uint32_t chatter;
+    int64_t latency_sum; // us
+    int32_t latency_min;
+    int32_t latency_max;
+    uint64_t handle_ns;
+    // Predictive actuation, saved is the scans saved times the frame period
+    uint32_t predict_early;
+    uint32_t predict_confirmed;
+    uint32_t predict_false;
+    double predict_saved_us;
+
+} replay_result_t;
+
+static capture_frame_t *frames = NULL;
+static uint32_t frame_count = 0U;
+
+static uint16_t min_values[KB_KEY_COUNT];
+static uint16_t max_values[KB_KEY_COUNT];
+
+static replay_stroke_t *strokes = NULL;
+static uint32_t stroke_count = 0U;
+
+static const char *trace = NULL;
+static uint32_t synthetic_strokes = 200U;
+static uint32_t seed = 1U;
+static uint8_t reference = 50U;
+static bool verbose = false;
+
+static void replay_usage() {
+    fprintf(stderr,
+            "usage: replay [-v] [-r reference] [-n strokes] [-s seed]\n"
+            "              [-a config] [-b config] <trace | synthetic>\n"
+            "config: comma separated mode=normal|race, threshold=<%%>,\n"
+            "        predict=0|1\n");
+    exit(EXIT_FAILURE);
+}
+
+static void replay_add_frame(const capture_frame_t *frame) {
+
+    static uint32_t capacity = 0U;
+
+    if (frame_count == capacity) {
+        capacity = capacity ? capacity * 2U : 4096U;
+        frames = realloc(frames, capacity * sizeof(capture_frame_t));
+        if (!frames) {
+            sim_fatal("Out of memory");
+        }
+    }
+
+    frames[frame_count++] = *frame;
+}
+
+static void replay_load_text(FILE *file, const char *path) {
+
+    char line[1024];
+    uint32_t line_number = 0U;
+
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+
+        char *cursor = line;
+        char *end;
+        unsigned long time = strtoul(cursor, &end, 10);
+        if (end == cursor) {
+            // Blank line
+            continue;
+        }
+
+        capture_frame_t frame = {.time = time};
+        for (uint8_t i = 0; i < KB_KEY_COUNT; i++) {
+            cursor = end;
+            frame.values[i] = strtoul(cursor, &end, 10);
+            if (end == cursor) {
+                sim_fatal("%s:%u: Expected %u values", path, line_number,
+                          KB_KEY_COUNT);
+            }
+        }
+
+        replay_add_frame(&frame);
+    }
+}
+
+static void replay_load(const char *path) {
+
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        sim_fatal("%s: %s", path, strerror(errno));
+    }
+
+    size_t length = strlen(path);
+    if (length > 4U && strcmp(&path[length - 4U], ".bin") == 0) {
+        capture_frame_t frame;
+        while (fread(&frame, sizeof(frame), 1, file) == 1) {
+            replay_add_frame(&frame);
+        }
+    } else {
+        replay_load_text(file, path);
+    }
+
+    fclose(file);
+
+    for (uint32_t i = 1; i < frame_count; i++) {
+        if ((int32_t)(frames[i].time - frames[i - 1U].time) <= 0) {
+            sim_fatal("%s: Frame %u is not after the previous one", path, i);
+        }
+    }
+}
+
+// Keys which end up in the keyboard report as a single usage
+static bool replay_key_observable(uint8_t key_index) {
+    uint16_t usage = kb_state.keymap[key_index];
+    return usage >= KEY_A && usage <= KEY_RIGHTGUI;
+}
+
+static uint32_t replay_random() {
+    seed = seed * 1103515245U + 12345U;
+    return seed >> 8;
+}
+
+// Strokes one key at a time with ramps of random length and depth, some too
+// shallow for the default threshold, on top of noise on every key
+static void replay_synthesize() {
+
+    capture_frame_t frame = {.time = 0U};
+
+    uint8_t keys[KB_KEY_COUNT];
+    uint8_t key_count = 0U;
+    for (uint8_t i = 0; i < KB_KEY_COUNT; i++) {
+        if (replay_key_observable(i)) {
+            keys[key_count++] = i;
+        }
+    }
+    if (key_count == 0U) {
+        sim_fatal("No key is reported as a plain usage");
+    }
+
+    for (uint32_t stroke = 0; stroke < synthetic_strokes; stroke++) {
+
+        uint8_t key = keys[replay_random() % key_count];
+        uint32_t depth = 30U + replay_random() % 71U; // % of travel
+        uint32_t press = 2000U + replay_random() % 13000U;
+        uint32_t hold = replay_random() % 40000U;
+        uint32_t release = 2000U + replay_random() % 13000U;
+        uint32_t gap = 5000U + replay_random() % 55000U;
+        uint32_t duration = press + hold + release + gap;
+
+        for (uint32_t t = 0; t < duration; t += REPLAY_PERIOD_US) {
+
+            uint32_t travel = 0U;
+            if (t < press) {
+                travel = REPLAY_TRAVEL_VALUE * depth / 100U * t / press;
+            } else if (t < press + hold) {
+                travel = REPLAY_TRAVEL_VALUE * depth / 100U;
+            } else if (t < press + hold + release) {
+                travel = REPLAY_TRAVEL_VALUE * depth / 100U *
+                         (press + hold + release - t) / release;
+            }
+
+            for (uint8_t i = 0; i < KB_KEY_COUNT; i++) {
+                frame.values[i] = REPLAY_REST_VALUE +
+                                  replay_random() % (REPLAY_NOISE + 1U);
+            }
+            frame.values[key] += travel;
+
+            replay_add_frame(&frame);
+            frame.time += REPLAY_PERIOD_US;
+        }
+    }
+}
+
+static void replay_find_strokes() {
+
+    for (uint8_t i = 0; i < KB_KEY_COUNT; i++) {
+        min_values[i] = UINT16_MAX;
+        max_values[i] = 0U;
+    }
+    for (uint32_t f = 0; f < frame_count; f++) {
+        for (uint8_t i = 0; i < KB_KEY_COUNT; i++) {
+            uint16_t value = frames[f].values[i];
+            min_values[i] = value < min_values[i] ? value : min_values[i];
+            max_values[i] = value > max_values[i] ? value : max_values[i];
+        }
+    }
+
+    uint16_t travel = 0U;
+    for (uint8_t i = 0; i < KB_KEY_COUNT; i++) {
+        if (max_values[i] - min_values[i] > travel) {
+            travel = max_values[i] - min_values[i];
+        }
+    }
+    if (travel < REPLAY_TRAVEL_MIN) {
+        sim_fatal("No key travels in the trace");
+    }
+
+    strokes = calloc(frame_count, sizeof(replay_stroke_t));
+    if (!strokes && frame_count) {
+        sim_fatal("Out of memory");
+    }
+
+    uint8_t release = reference > REPLAY_HYSTERESIS
+                          ? reference - REPLAY_HYSTERESIS
+                          : 0U;
+
+    for (uint8_t i = 0; i < KB_KEY_COUNT; i++) {
+
+        if ((uint16_t)(max_values[i] - min_values[i]) < REPLAY_TRAVEL_MIN) {
+            max_values[i] = min_values[i] + travel;
+            continue;
+        }
+
+        if (!replay_key_observable(i)) {
+            continue;
+        }
+
+        uint32_t range = max_values[i] - min_values[i];
+        uint32_t press_level = min_values[i] + range * reference / 100U;
+        uint32_t release_level = min_values[i] + range * release / 100U;
+        replay_stroke_t *stroke = NULL;
+
+        for (uint32_t f = 0; f < frame_count; f++) {
+            uint16_t value = frames[f].values[i];
+
+            if (!stroke && value >= press_level) {
+                stroke = &strokes[stroke_count++];
+                stroke->key_index = i;
+                stroke->start = frames[f].time;
+            } else if (stroke && value < release_level) {
+                stroke->end = frames[f].time;
+                stroke = NULL;
+            }
+        }
+        if (stroke) {
+            stroke->end = frames[frame_count - 1U].time;
+        }
+    }
+}
+
+static bool replay_parse_config(char *spec, replay_config_t *config) {
+
+    config->name = strdup(spec);
+    config->mode = KB_MODE_NORMAL;
+    config->threshold = KB_KEY_THRESHOLD_DEFAULT;
+    config->predictive_actuation = 0U;
+
+    for (char *field = strtok(spec, ","); field; field = strtok(NULL, ",")) {
+
+        char *value = strchr(field, '=');
+        if (!value) {
+            return false;
+        }
+        *value++ = '\0';
+
+        if (strcmp(field, "mode") == 0) {
+            if (strcmp(value, "normal") == 0) {
+                config->mode = KB_MODE_NORMAL;
+            } else if (strcmp(value, "race") == 0) {
+                config->mode = KB_MODE_RACE;
+            } else {
+                return false;
+            }
+        } else if (strcmp(field, "threshold") == 0) {
+            int threshold = atoi(value);
+            if (threshold < 1 || threshold > 100) {
+                return false;
+            }
+            config->threshold = threshold;
+        } else if (strcmp(field, "predict") == 0) {
+            config->predictive_actuation = atoi(value) != 0;
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Conversions follow the scan order, one per key
+static const capture_frame_t *current_frame = NULL;
+static uint32_t frame_conversion = 0U;
+
+static uint16_t replay_source(uint8_t channel, uint32_t conversion) {
+    (void)channel;
+
+    if (!current_frame) {
+        return 0U;
+    }
+
+    return current_frame->values[(conversion - frame_conversion) %
+                                 KB_KEY_COUNT];
+}
+
+static kb_key_mask_t replay_decode_report(const uint8_t *report) {
+
+    kb_key_mask_t pressed = 0U;
+
+    for (uint8_t i = 0; i < KB_KEY_COUNT; i++) {
+        if (!replay_key_observable(i)) {
+            continue;
+        }
+
+        uint16_t usage = kb_state.keymap[i];
+        if (usage >= KEY_LEFTCONTROL) {
+            if (report[0] & (1U << (usage - KEY_LEFTCONTROL))) {
+                pressed |= KB_KEY_BIT(i);
+            }
+            continue;
+        }
+        for (uint8_t j = 2; j < HID_BUFFER_SIZE; j++) {
+            if (report[j] == usage) {
+                pressed |= KB_KEY_BIT(i);
+            }
+        }
+    }
+
+    return pressed;
+}
+
+// False for chatter
+static bool replay_match_press(replay_result_t *result, uint8_t key_index,
+                               uint32_t time) {
+
+    for (uint32_t s = 0; s < stroke_count; s++) {
+        replay_stroke_t *stroke = &strokes[s];
+
+        if (stroke->key_index != key_index || stroke->reported ||
+            time + REPLAY_MATCH_LEAD_US < stroke->start ||
+            time > stroke->end + REPLAY_MATCH_GRACE_US) {
+            continue;
+        }
+
+        stroke->reported = true;
+
+        int32_t latency = (int32_t)(time - stroke->start);
+        if (result->matched == 0U || latency < result->latency_min) {
+            result->latency_min = latency;
+        }
+        if (result->matched == 0U || latency > result->latency_max) {
+            result->latency_max = latency;
+        }
+        result->latency_sum += latency;
+        result->matched++;
+        return true;
+    }
+
+    result->chatter++;
+    return false;
+}
+
+static uint64_t replay_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+static void replay_run(const replay_config_t *config,
+                       replay_result_t *result) {
+
+    sim_init();
+
+    ERR_H(eeprom_init());
+    ERR_H(setup_fw_update_handler());
+    ERR_H(setup_adc());
+    ERR_H(kb_init());
+    ERR_H(setup_usb());
+
+    if (!sim_usb_configure()) {
+        sim_fatal("USB configuration failed");
+    }
+
+    // After the init, the keymap tells which keys can be observed
+    if (strcmp(trace, "synthetic") == 0) {
+        replay_synthesize();
+    } else {
+        replay_load(trace);
+    }
+    if (frame_count == 0U) {
+        sim_fatal("Empty trace");
+    }
+
+    replay_find_strokes();
+    result->strokes = stroke_count;
+
+    kb_settings_t settings = kb_state.settings;
+    settings.mode = config->mode;
+    settings.predictive_actuation = config->predictive_actuation;
+    kb_set_settings(&settings);
+
+    uint8_t thresholds[KB_KEY_COUNT];
+    memset(thresholds, config->threshold, sizeof(thresholds));
+    kb_set_thresholds(thresholds);
+    kb_calibrate(min_values, max_values);
+
+    sim_adc_set_source(replay_source);
+
+    // The scan is only due a tick after boot
+    uint64_t base = sim_now_ns() + 1000000U;
+    kb_key_mask_t reported = 0U;
+    uint8_t report[64];
+    uint16_t length;
+
+    for (uint32_t f = 0; f < frame_count; f++) {
+
+        uint64_t time = base + (uint64_t)(frames[f].time - frames[0].time) *
+                                   1000U;
+        if (time > sim_now_ns()) {
+            sim_advance_ns(time - sim_now_ns());
+        }
+
+        current_frame = &frames[f];
+        frame_conversion = sim_adc_get_conversions();
+
+        uint64_t start = replay_now();
+        kb_handle();
+        fw_update_handler();
+        result->handle_ns += replay_now() - start;
+        result->frames++;
+
+        while (sim_usb_in(VEND_HID_EPIN_ADDR, report, &length)) {
+        }
+        while (sim_usb_in(GAMEPAD_HID_EPIN_ADDR, report, &length)) {
+        }
+        if (!sim_usb_in(HID_EPIN_ADDR, report, &length)) {
+            continue;
+        }
+
+        // Back on the trace's clock
+        uint32_t report_time =
+            frames[0].time + (uint32_t)((sim_now_ns() - base) / 1000U);
+
+        kb_key_mask_t pressed = replay_decode_report(report);
+        kb_key_mask_t changed = pressed ^ reported;
+        reported = pressed;
+
+        for (uint8_t i = 0; i < KB_KEY_COUNT; i++) {
+            if (!(changed & KB_KEY_BIT(i))) {
+                continue;
+            }
+
+            bool press = pressed & KB_KEY_BIT(i);
+            bool matched = true;
+            if (press) {
+                result->presses++;
+                matched = replay_match_press(result, i, report_time);
+            }
+            if (verbose) {
+                printf("%10u %-20s %-7s key %2u usage 0x%02x%s\n",
+                       report_time, config->name, press ? "press" : "release",
+                       i, kb_state.keymap[i], matched ? "" : " chatter");
+            }
+        }
+    }
+
+    // One scan per frame
+    double period = frame_count > 1U ? (double)(frames[frame_count - 1U].time -
+                                                frames[0].time) /
+                                           (frame_count - 1U)
+                                     : 0.0;
+
+    const predict_stats_t *stats = predict_get_stats();
+    result->predict_early = stats->early;
+    result->predict_confirmed = stats->confirmed;
+    result->predict_false = stats->false_actuations;
+    result->predict_saved_us = stats->scans_saved * period;
+}
+
+static void replay_report(const replay_config_t *config,
+                          const replay_result_t *result) {
+
+    double latency_avg =
+        result->matched ? (double)result->latency_sum / result->matched : 0.0;
+
+    printf("%-20s %8u %8u %8u %8.1f %8d %8d %10.1f %8u %9u %8u %10.1f\n",
+           config->name, result->presses, result->strokes - result->matched,
+           result->chatter, latency_avg,
+           result->matched ? result->latency_min : 0,
+           result->matched ? result->latency_max : 0,
+           result->frames ? (double)result->handle_ns / result->frames : 0.0,
+           result->predict_early, result->predict_confirmed,
+           result->predict_false, result->predict_saved_us);
+}
+
+int main(int argc, char **argv) {
+
+    replay_config_t configs[REPLAY_CONFIG_MAX];
+    uint8_t config_count = 0U;
+    int option;
+
+    while ((option = getopt(argc, argv, "va:b:r:n:s:h")) != -1) {
+        switch (option) {
+
+        case 'v':
+            verbose = true;
+            break;
+
+        case 'a':
+        case 'b':
+            if (config_count == REPLAY_CONFIG_MAX ||
+                !replay_parse_config(optarg, &configs[config_count++])) {
+                replay_usage();
+            }
+            break;
+
+        case 'r':
+            reference = atoi(optarg);
+            if (reference < 1U || reference > 100U) {
+                replay_usage();
+            }
+            break;
+
+        case 'n':
+            synthetic_strokes = strtoul(optarg, NULL, 10);
+            break;
+
+        case 's':
+            seed = strtoul(optarg, NULL, 10);
+            break;
+
+        default:
+            replay_usage();
+        }
+    }
+
+    if (optind != argc - 1) {
+        replay_usage();
+    }
+    trace = argv[optind];
+
+    if (config_count == 0U) {
+        char spec[] = "mode=normal";
+        replay_parse_config(spec, &configs[config_count++]);
+    }
+
+    replay_result_t *results =
+        mmap(NULL, sizeof(replay_result_t) * REPLAY_CONFIG_MAX,
+             PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (results == MAP_FAILED) {
+        sim_fatal("Unable to map results: %s", strerror(errno));
+    }
+    memset(results, 0, sizeof(replay_result_t) * REPLAY_CONFIG_MAX);
+
+    printf("# ykb-replay %s %s reference %u%%\n", GIT_HASH, trace, reference);
+    fflush(stdout);
+
+    for (uint8_t i = 0; i < config_count; i++) {
+
+        pid_t pid = fork();
+        if (pid < 0) {
+            sim_fatal("fork: %s", strerror(errno));
+        }
+
+        if (pid == 0) {
+            replay_run(&configs[i], &results[i]);
+            fflush(stdout);
+            _exit(EXIT_SUCCESS);
+        }
+
+        int status;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+            sim_fatal("Replay of %s failed", configs[i].name);
+        }
+    }
+
+    printf("# frames %u strokes %u, latencies in us\n", results[0].frames,
+           results[0].strokes);
+    printf("%-20s %8s %8s %8s %8s %8s %8s %10s %8s %9s %8s %10s\n", "config",
+           "presses", "missed", "chatter", "lat_avg", "lat_min", "lat_max",
+           "ns/frame", "early", "confirmed", "false", "saved_us");
+    for (uint8_t i = 0; i < config_count; i++) {
+        replay_report(&configs[i], &results[i]);
+    }
+
+    return EXIT_SUCCESS;
+}
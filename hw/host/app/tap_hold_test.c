@@ -0,0 +1,317 @@
+#include "sim.h"
+
+#include "keys.h"
+#include "tap_hold.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Feeds scripted key events through the tap-hold resolver and checks the
+// order of the events it emits, one line per case: `<case> ok` or what was
+// emitted instead. Exits with a failure if any case fails.
+//
+// Every step is an event (or a call of the task) followed by the number of
+// events emitted so far, so a decision taken too early or too late fails
+// at the step it happened at, not only at the end.
+
+#define TAP_HOLD_TEST_STEPS_MAX (TAP_HOLD_BUFFER_LEN + 8U)
+#define TAP_HOLD_TEST_EMITS_MAX (TAP_HOLD_BUFFER_LEN + 8U)
+
+// Keys of the mock keymap
+#define KEY_INDEX_MT 0U // Shift when held, A when tapped
+#define KEY_INDEX_B 1U
+#define KEY_INDEX_C 2U
+#define KEY_INDEX_LT 3U // Layer 1 when held, D when tapped
+
+#define ACTION_MT_TAP KEY_A
+#define ACTION_MT_HOLD KEY_MODS(KB_MOD_SHIFT)
+#define ACTION_LT_HOLD KEY_MO(1)
+
+typedef enum {
+    STEP_PRESS = 0U,
+    STEP_RELEASE,
+    STEP_TASK,
+} step_type;
+
+typedef struct {
+    step_type type;
+    uint8_t key_index;
+    uint32_t time; // ms
+    uint8_t emitted;
+} step_t;
+
+typedef struct {
+    uint8_t key_index;
+    bool pressed;
+    uint16_t action;
+} emit_t;
+
+typedef struct {
+    const char *name;
+    tap_hold_policy policy;
+    uint8_t step_count;
+    step_t steps[TAP_HOLD_TEST_STEPS_MAX];
+    uint8_t emit_count;
+    emit_t emits[TAP_HOLD_TEST_EMITS_MAX];
+} test_case_t;
+
+#define PRESS(key, time, emitted) {STEP_PRESS, key, time, emitted}
+#define RELEASE(key, time, emitted) {STEP_RELEASE, key, time, emitted}
+#define TASK(time, emitted) {STEP_TASK, 0U, time, emitted}
+
+#define EMIT_PRESS(key, action) {key, true, action}
+#define EMIT_RELEASE(key) {key, false, KEY_NOKEY}
+
+#define STEPS(...)                                                             \
+    .step_count = sizeof((step_t[]){__VA_ARGS__}) / sizeof(step_t),            \
+    .steps = {__VA_ARGS__}
+#define EMITS(...)                                                             \
+    .emit_count = sizeof((emit_t[]){__VA_ARGS__}) / sizeof(emit_t),            \
+    .emits = {__VA_ARGS__}
+
+static const test_case_t test_cases[] = {
+    {
+        .name = "tap",
+        .policy = TAP_HOLD_POLICY_DEFAULT,
+        STEPS(PRESS(KEY_INDEX_MT, 0, 0), TASK(150, 0),
+              RELEASE(KEY_INDEX_MT, 199, 2)),
+        EMITS(EMIT_PRESS(KEY_INDEX_MT, ACTION_MT_TAP),
+              EMIT_RELEASE(KEY_INDEX_MT)),
+    },
+    {
+        .name = "term-task",
+        .policy = TAP_HOLD_POLICY_DEFAULT,
+        STEPS(PRESS(KEY_INDEX_MT, 0, 0), TASK(199, 0), TASK(200, 1),
+              RELEASE(KEY_INDEX_MT, 300, 2)),
+        EMITS(EMIT_PRESS(KEY_INDEX_MT, ACTION_MT_HOLD),
+              EMIT_RELEASE(KEY_INDEX_MT)),
+    },
+    {
+        // Next event is already past the term, without the task running
+        .name = "term-event",
+        .policy = TAP_HOLD_POLICY_DEFAULT,
+        STEPS(PRESS(KEY_INDEX_MT, 0, 0), PRESS(KEY_INDEX_B, 250, 2),
+              RELEASE(KEY_INDEX_B, 260, 3), RELEASE(KEY_INDEX_MT, 270, 4)),
+        EMITS(EMIT_PRESS(KEY_INDEX_MT, ACTION_MT_HOLD),
+              EMIT_PRESS(KEY_INDEX_B, KEY_B), EMIT_RELEASE(KEY_INDEX_B),
+              EMIT_RELEASE(KEY_INDEX_MT)),
+    },
+    {
+        .name = "default-nested",
+        .policy = TAP_HOLD_POLICY_DEFAULT,
+        STEPS(PRESS(KEY_INDEX_MT, 0, 0), PRESS(KEY_INDEX_B, 10, 0),
+              RELEASE(KEY_INDEX_B, 20, 0), RELEASE(KEY_INDEX_MT, 30, 4)),
+        EMITS(EMIT_PRESS(KEY_INDEX_MT, ACTION_MT_TAP),
+              EMIT_PRESS(KEY_INDEX_B, KEY_B), EMIT_RELEASE(KEY_INDEX_B),
+              EMIT_RELEASE(KEY_INDEX_MT)),
+    },
+    {
+        .name = "permissive-nested",
+        .policy = TAP_HOLD_POLICY_PERMISSIVE_HOLD,
+        STEPS(PRESS(KEY_INDEX_MT, 0, 0), PRESS(KEY_INDEX_B, 10, 0),
+              RELEASE(KEY_INDEX_B, 20, 3), RELEASE(KEY_INDEX_MT, 30, 4)),
+        EMITS(EMIT_PRESS(KEY_INDEX_MT, ACTION_MT_HOLD),
+              EMIT_PRESS(KEY_INDEX_B, KEY_B), EMIT_RELEASE(KEY_INDEX_B),
+              EMIT_RELEASE(KEY_INDEX_MT)),
+    },
+    {
+        // Tap-hold key released before the other one, a roll
+        .name = "permissive-interleaved",
+        .policy = TAP_HOLD_POLICY_PERMISSIVE_HOLD,
+        STEPS(PRESS(KEY_INDEX_MT, 0, 0), PRESS(KEY_INDEX_B, 10, 0),
+              RELEASE(KEY_INDEX_MT, 20, 3), RELEASE(KEY_INDEX_B, 30, 4)),
+        EMITS(EMIT_PRESS(KEY_INDEX_MT, ACTION_MT_TAP),
+              EMIT_PRESS(KEY_INDEX_B, KEY_B), EMIT_RELEASE(KEY_INDEX_MT),
+              EMIT_RELEASE(KEY_INDEX_B)),
+    },
+    {
+        // Release of a key pressed before the tap-hold one doesn't count
+        .name = "permissive-earlier-key",
+        .policy = TAP_HOLD_POLICY_PERMISSIVE_HOLD,
+        STEPS(PRESS(KEY_INDEX_B, 0, 1), PRESS(KEY_INDEX_MT, 10, 1),
+              RELEASE(KEY_INDEX_B, 20, 1), RELEASE(KEY_INDEX_MT, 30, 4)),
+        EMITS(EMIT_PRESS(KEY_INDEX_B, KEY_B),
+              EMIT_PRESS(KEY_INDEX_MT, ACTION_MT_TAP),
+              EMIT_RELEASE(KEY_INDEX_B), EMIT_RELEASE(KEY_INDEX_MT)),
+    },
+    {
+        .name = "other-key-press",
+        .policy = TAP_HOLD_POLICY_HOLD_ON_OTHER_KEY_PRESS,
+        STEPS(PRESS(KEY_INDEX_MT, 0, 0), PRESS(KEY_INDEX_B, 10, 2),
+              RELEASE(KEY_INDEX_B, 20, 3), RELEASE(KEY_INDEX_MT, 30, 4)),
+        EMITS(EMIT_PRESS(KEY_INDEX_MT, ACTION_MT_HOLD),
+              EMIT_PRESS(KEY_INDEX_B, KEY_B), EMIT_RELEASE(KEY_INDEX_B),
+              EMIT_RELEASE(KEY_INDEX_MT)),
+    },
+    {
+        .name = "other-key-interleaved",
+        .policy = TAP_HOLD_POLICY_HOLD_ON_OTHER_KEY_PRESS,
+        STEPS(PRESS(KEY_INDEX_MT, 0, 0), PRESS(KEY_INDEX_B, 10, 2),
+              RELEASE(KEY_INDEX_MT, 20, 3), RELEASE(KEY_INDEX_B, 30, 4)),
+        EMITS(EMIT_PRESS(KEY_INDEX_MT, ACTION_MT_HOLD),
+              EMIT_PRESS(KEY_INDEX_B, KEY_B), EMIT_RELEASE(KEY_INDEX_MT),
+              EMIT_RELEASE(KEY_INDEX_B)),
+    },
+    {
+        // Second tap-hold key stops the replay of the buffer again
+        .name = "chained",
+        .policy = TAP_HOLD_POLICY_DEFAULT,
+        STEPS(PRESS(KEY_INDEX_MT, 0, 0), PRESS(KEY_INDEX_LT, 10, 0),
+              PRESS(KEY_INDEX_C, 20, 0), RELEASE(KEY_INDEX_MT, 30, 1),
+              RELEASE(KEY_INDEX_C, 40, 1), TASK(210, 5),
+              RELEASE(KEY_INDEX_LT, 220, 6)),
+        EMITS(EMIT_PRESS(KEY_INDEX_MT, ACTION_MT_TAP),
+              EMIT_PRESS(KEY_INDEX_LT, ACTION_LT_HOLD),
+              EMIT_PRESS(KEY_INDEX_C, KEY_C), EMIT_RELEASE(KEY_INDEX_MT),
+              EMIT_RELEASE(KEY_INDEX_C), EMIT_RELEASE(KEY_INDEX_LT)),
+    },
+};
+
+static const test_case_t *current_case;
+static emit_t emitted[TAP_HOLD_TEST_EMITS_MAX];
+static uint8_t emitted_count;
+
+static uint16_t test_get_action(uint8_t key_index) {
+    switch (key_index) {
+    case KEY_INDEX_MT:
+        return KEY_MT(KB_MOD_SHIFT, KEY_A);
+    case KEY_INDEX_B:
+        return KEY_B;
+    case KEY_INDEX_C:
+        return KEY_C;
+    case KEY_INDEX_LT:
+        return KEY_LT(1, KEY_D);
+    default:
+        return KEY_NOKEY;
+    }
+}
+
+static void test_emit(uint8_t key_index, bool pressed, uint16_t action) {
+    if (emitted_count >= TAP_HOLD_TEST_EMITS_MAX) {
+        sim_fatal("%s: more than %u events emitted", current_case->name,
+                  TAP_HOLD_TEST_EMITS_MAX);
+    }
+    emitted[emitted_count++] = (emit_t){key_index, pressed, action};
+}
+
+static void print_emitted() {
+    printf("  emitted:");
+    for (uint8_t i = 0; i < emitted_count; i++) {
+        printf(" %u%c%04x", emitted[i].key_index,
+               emitted[i].pressed ? '+' : '-', emitted[i].action);
+    }
+    printf("\n");
+}
+
+static bool run_case(const test_case_t *test) {
+
+    current_case = test;
+    emitted_count = 0U;
+
+    tap_hold_init(test_get_action, test_emit);
+    tap_hold_configure(TAP_HOLD_TERM_DEFAULT, test->policy);
+
+    for (uint8_t i = 0; i < test->step_count; i++) {
+        const step_t *step = &test->steps[i];
+        uint32_t time = step->time * 1000U;
+
+        if (step->type == STEP_TASK) {
+            tap_hold_task(time);
+        } else {
+            key_event_t event = {
+                .key_index = step->key_index,
+                .pressed = step->type == STEP_PRESS,
+                .time = time,
+            };
+            tap_hold_event(&event);
+        }
+
+        if (emitted_count != step->emitted) {
+            printf("%-24s FAIL at step %u: %u emitted, expected %u\n",
+                   test->name, i, emitted_count, step->emitted);
+            print_emitted();
+            return false;
+        }
+    }
+
+    for (uint8_t i = 0; i < test->emit_count; i++) {
+        const emit_t *expected = &test->emits[i];
+        if (i >= emitted_count || emitted[i].key_index != expected->key_index ||
+            emitted[i].pressed != expected->pressed ||
+            emitted[i].action != expected->action) {
+            printf("%-24s FAIL at event %u: expected %u%c%04x\n", test->name,
+                   i, expected->key_index, expected->pressed ? '+' : '-',
+                   expected->action);
+            print_emitted();
+            return false;
+        }
+    }
+
+    printf("%-24s ok\n", test->name);
+    return true;
+}
+
+// Undecided key with the buffer filling up behind it. The event filling the
+// last slot decides it as a hold, then everything buffered is replayed in
+// order.
+static bool run_buffer_full() {
+
+    static test_case_t test = {
+        .name = "buffer-full",
+        .policy = TAP_HOLD_POLICY_DEFAULT,
+    };
+
+    uint8_t steps = 0U;
+    uint8_t emits = 0U;
+
+    test.steps[steps++] = (step_t)PRESS(KEY_INDEX_MT, 0, 0);
+    test.emits[emits++] = (emit_t)EMIT_PRESS(KEY_INDEX_MT, ACTION_MT_HOLD);
+
+    for (uint8_t i = 0; i < TAP_HOLD_BUFFER_LEN; i++) {
+        bool pressed = i % 2U == 0U;
+        uint8_t expected = i == TAP_HOLD_BUFFER_LEN - 1U ? emits + 1U : 0U;
+
+        test.steps[steps++] =
+            pressed ? (step_t)PRESS(KEY_INDEX_B, i + 1U, expected)
+                    : (step_t)RELEASE(KEY_INDEX_B, i + 1U, expected);
+        test.emits[emits++] = pressed
+                                  ? (emit_t)EMIT_PRESS(KEY_INDEX_B, KEY_B)
+                                  : (emit_t)EMIT_RELEASE(KEY_INDEX_B);
+    }
+
+    // Passes straight through once decided
+    test.steps[steps++] = (step_t)PRESS(KEY_INDEX_C, 30, emits + 1U);
+    test.emits[emits++] = (emit_t)EMIT_PRESS(KEY_INDEX_C, KEY_C);
+    test.steps[steps++] = (step_t)RELEASE(KEY_INDEX_MT, 40, emits + 1U);
+    test.emits[emits++] = (emit_t)EMIT_RELEASE(KEY_INDEX_MT);
+
+    test.step_count = steps;
+    test.emit_count = emits;
+
+    return run_case(&test);
+}
+
+int main() {
+
+    sim_init();
+
+    printf("# ykb-sim-tap-hold-test %s\n", GIT_HASH);
+
+    uint32_t failed = 0U;
+
+    for (size_t i = 0; i < sizeof(test_cases) / sizeof(test_cases[0]); i++) {
+        if (!run_case(&test_cases[i])) {
+            failed++;
+        }
+    }
+    if (!run_buffer_full()) {
+        failed++;
+    }
+
+    if (failed) {
+        printf("%u failed\n", failed);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
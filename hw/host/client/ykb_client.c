@@ -0,0 +1,423 @@
+#include "ykb_client.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t ykb_client_now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000U + (uint64_t)ts.tv_nsec / 1000000U;
+}
+
+static inline ykb_client_request_t *ykb_client_at(ykb_client_t *client,
+                                                  uint8_t position) {
+    return &client->queue[(client->head + position) % YKB_CLIENT_QUEUE_LEN];
+}
+
+void ykb_client_init(ykb_client_t *client, const ykb_client_io_t *io) {
+    memset(client, 0, sizeof(ykb_client_t));
+    client->io = *io;
+    client->window = YKB_CLIENT_WINDOW;
+}
+
+void ykb_client_set_window(ykb_client_t *client, uint8_t window) {
+    if (window == 0U) {
+        window = 1U;
+    }
+    client->window = window < YKB_CLIENT_WINDOW ? window : YKB_CLIENT_WINDOW;
+}
+
+static ykb_client_request_t *
+ykb_client_push(ykb_client_t *client, uint8_t request, uint32_t packet_number,
+                const void *data, uint8_t size) {
+
+    if (client->count == YKB_CLIENT_QUEUE_LEN ||
+        size > YKB_PROTOCOL_DATA_LENGTH) {
+        return NULL;
+    }
+
+    ykb_client_request_t *entry = ykb_client_at(client, client->count++);
+    memset(entry, 0, sizeof(ykb_client_request_t));
+
+    entry->packet.request_and_version = request | YKB_PROTOCOL_VERSION;
+    entry->packet.packet_number = packet_number;
+    entry->packet.packet_size = size;
+    if (size) {
+        memcpy(entry->packet.data, data, size);
+    }
+    entry->packet.crc = ykb_crc16(entry->packet.data, size);
+    entry->reply_packet = packet_number;
+
+    client->stats.requests++;
+
+    return entry;
+}
+
+int ykb_client_submit(ykb_client_t *client, uint8_t request,
+                      uint32_t packet_number, const void *data, uint8_t size,
+                      uint8_t *reply, uint32_t reply_capacity,
+                      ykb_client_callback callback, void *user) {
+
+    ykb_client_request_t *entry =
+        ykb_client_push(client, request, packet_number, data, size);
+    if (!entry) {
+        return YKB_CLIENT_ERR_FULL;
+    }
+
+    entry->reply = reply;
+    entry->reply_capacity = reply ? reply_capacity : 0U;
+    entry->callback = callback;
+    entry->user = user;
+
+    return 0;
+}
+
+int ykb_client_get(ykb_client_t *client, uint8_t request, uint8_t *reply,
+                   uint32_t reply_capacity, ykb_client_callback callback,
+                   void *user) {
+    return ykb_client_submit(client, request, 0U, NULL, 0U, reply,
+                             reply_capacity, callback, user);
+}
+
+int ykb_client_ext(ykb_client_t *client, uint8_t ext_request,
+                   const void *data, uint8_t size, uint8_t *reply,
+                   uint32_t reply_capacity, ykb_client_callback callback,
+                   void *user) {
+
+    uint8_t buff[YKB_PROTOCOL_DATA_LENGTH] = {ext_request};
+
+    if (size > sizeof(buff) - 1U) {
+        return YKB_CLIENT_ERR_OVERFLOW;
+    }
+    if (size) {
+        memcpy(&buff[1], data, size);
+    }
+
+    return ykb_client_submit(client, YKB_CLIENT_EXTENDED, 0U, buff,
+                             size + 1U, reply, reply_capacity, callback,
+                             user);
+}
+
+int ykb_client_set(ykb_client_t *client, uint8_t request, const void *data,
+                   uint32_t size, ykb_client_callback callback, void *user) {
+
+    if (size < YKB_PROTOCOL_DATA_LENGTH) {
+        return ykb_client_submit(client, request, 0U, data, size, NULL, 0U,
+                                 callback, user);
+    }
+
+    if (client->transfer_active) {
+        return YKB_CLIENT_ERR_BUSY;
+    }
+
+    client->transfer_data = data;
+    client->transfer_size = size;
+    client->transfer_offset = 0U;
+    client->transfer_chunk = 0U;
+    client->transfer_request = request;
+    client->transfer_callback = callback;
+    client->transfer_user = user;
+    client->transfer_active = true;
+
+    return 0;
+}
+
+// Every chunk is queued once, the one after the data is the short last one
+static void ykb_client_queue_transfer(ykb_client_t *client) {
+
+    while (client->transfer_active &&
+           client->transfer_offset <= client->transfer_size &&
+           client->count < YKB_CLIENT_QUEUE_LEN) {
+
+        uint32_t size = client->transfer_size - client->transfer_offset;
+        if (size > YKB_PROTOCOL_DATA_LENGTH) {
+            size = YKB_PROTOCOL_DATA_LENGTH;
+        }
+
+        ykb_client_request_t *entry = ykb_client_push(
+            client, client->transfer_request, client->transfer_chunk,
+            client->transfer_data + client->transfer_offset, size);
+        entry->transfer = true;
+
+        client->transfer_chunk++;
+        // Past the end once the short chunk is queued
+        client->transfer_offset += size < YKB_PROTOCOL_DATA_LENGTH
+                                       ? size + 1U
+                                       : YKB_PROTOCOL_DATA_LENGTH;
+    }
+}
+
+static void ykb_client_finish_transfer(ykb_client_t *client, int status) {
+
+    client->transfer_active = false;
+
+    // Chunks which were not sent yet are dropped, acknowledgements of the
+    // ones in flight are ignored
+    for (uint8_t i = 0; i < client->count; i++) {
+        ykb_client_request_t *entry = ykb_client_at(client, i);
+        if (entry->transfer && entry->state == YKB_CLIENT_REQUEST_QUEUED) {
+            entry->state = YKB_CLIENT_REQUEST_DONE;
+        }
+    }
+
+    if (client->transfer_callback) {
+        client->transfer_callback(client->transfer_user, status, NULL,
+                                  client->transfer_size);
+    }
+}
+
+static void ykb_client_complete(ykb_client_t *client,
+                                ykb_client_request_t *entry, int status) {
+
+    if (entry->state == YKB_CLIENT_REQUEST_SENT) {
+        client->in_flight--;
+    }
+    entry->state = YKB_CLIENT_REQUEST_DONE;
+
+    if (entry->transfer) {
+        if (!client->transfer_active) {
+            return;
+        }
+        bool last = entry->packet.packet_size < YKB_PROTOCOL_DATA_LENGTH;
+        if (status || last) {
+            ykb_client_finish_transfer(client, status);
+        }
+        return;
+    }
+
+    if (entry->callback) {
+        entry->callback(entry->user, status, entry->reply,
+                        entry->reply_length);
+    }
+}
+
+// Sent again from the first missing reply packet, only replies with data
+// can be requested twice
+static void ykb_client_resend(ykb_client_t *client,
+                              ykb_client_request_t *entry, int status) {
+
+    if (!entry->reply || entry->retries >= YKB_CLIENT_RETRIES) {
+        ykb_client_complete(client, entry, status);
+        return;
+    }
+
+    entry->retries++;
+    entry->packet.packet_number = entry->reply_packet;
+    entry->state = YKB_CLIENT_REQUEST_QUEUED;
+    client->in_flight--;
+    client->stats.resends++;
+}
+
+static int ykb_client_send_queued(ykb_client_t *client) {
+
+    for (uint8_t i = 0;
+         i < client->count && client->in_flight < client->window; i++) {
+
+        ykb_client_request_t *entry = ykb_client_at(client, i);
+        if (entry->state != YKB_CLIENT_REQUEST_QUEUED) {
+            continue;
+        }
+
+        if (!client->io.send(client->io.context, &entry->packet)) {
+            return YKB_CLIENT_ERR_IO;
+        }
+
+        if (client->in_flight == 0U) {
+            client->activity_ms = ykb_client_now_ms();
+        }
+
+        entry->state = YKB_CLIENT_REQUEST_SENT;
+        entry->sequence = client->sequence++;
+        client->in_flight++;
+        client->stats.packets_sent++;
+    }
+
+    return 0;
+}
+
+static bool ykb_client_matches(const ykb_client_request_t *entry,
+                               const ykb_protocol_t *packet) {
+
+    if (entry->state != YKB_CLIENT_REQUEST_SENT ||
+        packet->request_and_version != entry->packet.request_and_version ||
+        packet->packet_number != (typeof(packet->packet_number))
+                                     entry->reply_packet) {
+        return false;
+    }
+
+    // The first packet of an extended reply starts with the request
+    bool extended = (packet->request_and_version & 0xF0) ==
+                    YKB_CLIENT_EXTENDED;
+    if (extended && packet->packet_number == 0U) {
+        return packet->data[0] == entry->packet.data[0];
+    }
+
+    return true;
+}
+
+static void ykb_client_handle_packet(ykb_client_t *client,
+                                     const ykb_protocol_t *packet) {
+
+    client->stats.packets_received++;
+
+    ykb_client_request_t *entry = NULL;
+    for (uint8_t i = 0; i < client->count; i++) {
+        ykb_client_request_t *candidate = ykb_client_at(client, i);
+        if (ykb_client_matches(candidate, packet) &&
+            (!entry || candidate->sequence < entry->sequence)) {
+            entry = candidate;
+        }
+    }
+
+    if (!entry) {
+        // Late reply to a resent request
+        client->stats.unexpected++;
+        return;
+    }
+
+    // Requests sent before this one won't get (the rest of) their replies
+    for (uint8_t i = 0; i < client->count; i++) {
+        ykb_client_request_t *earlier = ykb_client_at(client, i);
+        if (earlier->state == YKB_CLIENT_REQUEST_SENT &&
+            earlier->sequence < entry->sequence) {
+            ykb_client_resend(client, earlier, YKB_CLIENT_ERR_TIMEOUT);
+        }
+    }
+
+    if (packet->packet_size > YKB_PROTOCOL_DATA_LENGTH ||
+        ykb_crc16(packet->data, packet->packet_size) != packet->crc) {
+        client->stats.crc_errors++;
+        ykb_client_resend(client, entry, YKB_CLIENT_ERR_IO);
+        return;
+    }
+
+    if (!entry->reply) {
+        ykb_client_complete(client, entry, 0);
+        return;
+    }
+
+    if (entry->reply_length + packet->packet_size > entry->reply_capacity) {
+        ykb_client_complete(client, entry, YKB_CLIENT_ERR_OVERFLOW);
+        return;
+    }
+
+    memcpy(entry->reply + entry->reply_length, packet->data,
+           packet->packet_size);
+    entry->reply_length += packet->packet_size;
+    entry->reply_packet++;
+
+    if (packet->packet_size < YKB_PROTOCOL_DATA_LENGTH ||
+        entry->reply_length == entry->reply_capacity) {
+        ykb_client_complete(client, entry, 0);
+    }
+}
+
+int ykb_client_poll(ykb_client_t *client, int timeout_ms) {
+
+    ykb_client_queue_transfer(client);
+
+    int err = ykb_client_send_queued(client);
+    if (err) {
+        return err;
+    }
+
+    if (client->in_flight == 0U) {
+        return 0;
+    }
+
+    ykb_protocol_t packet;
+    int received = client->io.receive(client->io.context, &packet, timeout_ms);
+
+    if (received < 0) {
+        for (uint8_t i = 0; i < client->count; i++) {
+            ykb_client_request_t *entry = ykb_client_at(client, i);
+            if (entry->state != YKB_CLIENT_REQUEST_DONE) {
+                ykb_client_complete(client, entry, YKB_CLIENT_ERR_IO);
+            }
+        }
+        err = YKB_CLIENT_ERR_IO;
+    } else if (received > 0) {
+        client->activity_ms = ykb_client_now_ms();
+        ykb_client_handle_packet(client, &packet);
+    } else if (ykb_client_now_ms() - client->activity_ms >=
+               YKB_CLIENT_TIMEOUT_MS) {
+        client->activity_ms = ykb_client_now_ms();
+        for (uint8_t i = 0; i < client->count; i++) {
+            ykb_client_request_t *entry = ykb_client_at(client, i);
+            if (entry->state == YKB_CLIENT_REQUEST_SENT) {
+                ykb_client_resend(client, entry, YKB_CLIENT_ERR_TIMEOUT);
+            }
+        }
+    }
+
+    while (client->count &&
+           ykb_client_at(client, 0)->state == YKB_CLIENT_REQUEST_DONE) {
+        client->head = (client->head + 1U) % YKB_CLIENT_QUEUE_LEN;
+        client->count--;
+    }
+
+    return err;
+}
+
+int ykb_client_wait(ykb_client_t *client) {
+
+    while (!ykb_client_idle(client)) {
+        int err = ykb_client_poll(client, YKB_CLIENT_TIMEOUT_MS);
+        if (err) {
+            return err;
+        }
+    }
+
+    return 0;
+}
+
+static bool ykb_client_fd_send(void *context, const ykb_protocol_t *packet) {
+
+    int fd = *(int *)context;
+
+    ssize_t written;
+    do {
+        written = write(fd, packet, sizeof(ykb_protocol_t));
+    } while (written < 0 && errno == EINTR);
+
+    return written == sizeof(ykb_protocol_t);
+}
+
+static int ykb_client_fd_receive(void *context, ykb_protocol_t *packet,
+                                 int timeout_ms) {
+
+    int fd = *(int *)context;
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+
+    int ready = poll(&pfd, 1, timeout_ms);
+    if (ready < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+    if (ready == 0) {
+        return 0;
+    }
+
+    uint8_t report[1U + sizeof(ykb_protocol_t)];
+    ssize_t length = read(fd, report, sizeof(report));
+    if (length <= 0) {
+        return -1;
+    }
+    if (report[0] != YKB_CLIENT_REPORT_ID) {
+        // Not a vendor report
+        return 0;
+    }
+
+    memset(packet, 0, sizeof(ykb_protocol_t));
+    memcpy(packet, &report[1], length - 1);
+
+    return 1;
+}
+
+void ykb_client_io_fd(ykb_client_io_t *io, int *fd) {
+    io->send = ykb_client_fd_send;
+    io->receive = ykb_client_fd_receive;
+    io->context = fd;
+}
@@ -0,0 +1,182 @@
+#ifndef YKB_CLIENT_H
+#define YKB_CLIENT_H
+
+#include "ykb_protocol.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Host side of the vendor protocol. Requests are queued and kept in flight
+// up to a window, replies are matched to them in order (the device handles
+// requests one after another), reassembled from their packets and handed to
+// the request's callback. Multi-packet replies cut short by the device's TX
+// queue are re-requested from the first missing packet, so they may complete
+// after requests submitted behind them.
+//
+// No threads: everything, callbacks included, runs in `ykb_client_poll`.
+
+#define YKB_CLIENT_ERR_FULL -1701
+#define YKB_CLIENT_ERR_IO -1702
+#define YKB_CLIENT_ERR_TIMEOUT -1703
+#define YKB_CLIENT_ERR_OVERFLOW -1704
+#define YKB_CLIENT_ERR_BUSY -1705
+
+// Base requests, in the order of the device's handler table
+#define YKB_CLIENT_GET_SETTINGS 0x10U
+#define YKB_CLIENT_GET_MAPPINGS 0x20U
+#define YKB_CLIENT_GET_VALUES 0x30U
+#define YKB_CLIENT_GET_THRESHOLDS 0x40U
+#define YKB_CLIENT_SET_SETTINGS 0x50U
+#define YKB_CLIENT_SET_MAPPINGS 0x60U
+#define YKB_CLIENT_SET_THRESHOLDS 0x70U
+#define YKB_CLIENT_FIRMWARE_UPDATE 0x80U
+#define YKB_CLIENT_BOOTLOADER_UPDATE 0x90U
+// `data[0]` is the extended request (see interface_handler.h)
+#define YKB_CLIENT_EXTENDED 0xA0U
+
+// Report ID in front of every packet from the device, as on the IN endpoint
+#define YKB_CLIENT_REPORT_ID 0x01U
+
+#ifndef YKB_CLIENT_QUEUE_LEN
+#define YKB_CLIENT_QUEUE_LEN 32U
+#endif // YKB_CLIENT_QUEUE_LEN
+
+// Requests sent without their reply yet
+#ifndef YKB_CLIENT_WINDOW
+#define YKB_CLIENT_WINDOW 4U
+#endif // YKB_CLIENT_WINDOW
+
+#define YKB_CLIENT_TIMEOUT_MS 500
+#define YKB_CLIENT_RETRIES 3U
+
+typedef struct {
+
+    // Sends one request packet, false if the link is gone
+    bool (*send)(void *context, const ykb_protocol_t *packet);
+
+    // Next packet from the device (report ID removed). 1 if received,
+    // 0 if nothing came in `timeout_ms`, negative if the link is gone.
+    int (*receive)(void *context, ykb_protocol_t *packet, int timeout_ms);
+
+    void *context;
+
+} ykb_client_io_t;
+
+// `status` is 0 or YKB_CLIENT_ERR_*, `reply` is the caller's reply buffer
+typedef void (*ykb_client_callback)(void *user, int status,
+                                    const uint8_t *reply, uint32_t length);
+
+typedef enum {
+    YKB_CLIENT_REQUEST_QUEUED = 0U,
+    YKB_CLIENT_REQUEST_SENT = 1U,
+    YKB_CLIENT_REQUEST_DONE = 2U,
+} ykb_client_request_state;
+
+typedef struct {
+
+    ykb_protocol_t packet;
+
+    // Reply is complete once `reply_capacity` bytes or a short packet came
+    uint8_t *reply;
+    uint32_t reply_capacity;
+    uint32_t reply_length;
+    // Next reply packet, the request is resent with it after a cut
+    uint32_t reply_packet;
+
+    ykb_client_callback callback;
+    void *user;
+
+    ykb_client_request_state state;
+    // Order of sending, replies come in the same order
+    uint32_t sequence;
+    // Chunk of the current transfer
+    bool transfer;
+    uint8_t retries;
+
+} ykb_client_request_t;
+
+typedef struct {
+
+    uint32_t requests;
+    uint32_t packets_sent;
+    uint32_t packets_received;
+    uint32_t resends;
+    uint32_t crc_errors;
+    // Packets not matching any request in flight
+    uint32_t unexpected;
+
+} ykb_client_stats_t;
+
+typedef struct {
+
+    ykb_client_io_t io;
+
+    ykb_client_request_t queue[YKB_CLIENT_QUEUE_LEN];
+    uint8_t head;
+    uint8_t count;
+    uint8_t in_flight;
+    uint8_t window;
+    uint32_t sequence;
+    // Of the last packet from the device, or the first send after it
+    uint64_t activity_ms;
+
+    // Set request longer than a packet (e.g. a firmware image), chunks are
+    // queued as there is room
+    const uint8_t *transfer_data;
+    uint32_t transfer_size;
+    uint32_t transfer_offset;
+    uint32_t transfer_chunk;
+    uint8_t transfer_request;
+    bool transfer_active;
+    ykb_client_callback transfer_callback;
+    void *transfer_user;
+
+    ykb_client_stats_t stats;
+
+} ykb_client_t;
+
+void ykb_client_init(ykb_client_t *client, const ykb_client_io_t *io);
+
+// 1 sends one request at a time, capped at YKB_CLIENT_WINDOW
+void ykb_client_set_window(ykb_client_t *client, uint8_t window);
+
+// Queues a single packet request. `reply` may be NULL for requests whose
+// reply is only an acknowledgement.
+int ykb_client_submit(ykb_client_t *client, uint8_t request,
+                      uint32_t packet_number, const void *data, uint8_t size,
+                      uint8_t *reply, uint32_t reply_capacity,
+                      ykb_client_callback callback, void *user);
+
+int ykb_client_get(ykb_client_t *client, uint8_t request, uint8_t *reply,
+                   uint32_t reply_capacity, ykb_client_callback callback,
+                   void *user);
+
+// Split into packets like the device expects: full ones, then a shorter
+// last one. Longer than a packet (mappings, firmware and bootloader images)
+// it's a transfer, only one runs at a time and `data` has to stay valid
+// until the callback. The callback is called once, for the last packet or
+// the first failure.
+int ykb_client_set(ykb_client_t *client, uint8_t request, const void *data,
+                   uint32_t size, ykb_client_callback callback, void *user);
+
+int ykb_client_ext(ykb_client_t *client, uint8_t ext_request,
+                   const void *data, uint8_t size, uint8_t *reply,
+                   uint32_t reply_capacity, ykb_client_callback callback,
+                   void *user);
+
+// Sends what the window allows and handles at most one packet from the
+// device, waiting up to `timeout_ms` for it
+int ykb_client_poll(ykb_client_t *client, int timeout_ms);
+
+// Polls until every request and the transfer are done
+int ykb_client_wait(ykb_client_t *client);
+
+static inline bool ykb_client_idle(const ykb_client_t *client) {
+    return client->count == 0U && !client->transfer_active;
+}
+
+// Packets over a file descriptor, e.g. a SOCK_SEQPACKET socket to the device
+// emulator. Sent as they are, received with the report ID in front.
+void ykb_client_io_fd(ykb_client_io_t *io, int *fd);
+
+#endif // YKB_CLIENT_H
@@ -0,0 +1,73 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include "hal_gpio.h"
+#include "usb/usbd_def.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Host simulation of the firmware core (`make sim`). The HAL drivers the core
+// uses are replaced by the mocks in hw/host/src, everything above them is the
+// firmware's own code. Single threaded: "interrupts" (USB events, DMA
+// completion) are run by the simulation in between calls into the firmware.
+
+typedef uint16_t (*sim_adc_source)(uint8_t channel, uint32_t conversion);
+typedef void (*sim_reset_handler)();
+
+// Maps the fake flash, resets the clock and all peripherals
+void sim_init();
+
+// Reports a broken invariant (of the firmware or of the simulation) and exits
+__attribute__((noreturn, format(printf, 1, 2))) void
+sim_fatal(const char *format, ...);
+
+// Called by NVIC_SystemReset, which is fatal if there is none or it returns
+void sim_set_reset_handler(sim_reset_handler handler);
+
+// Virtual clock behind systick_get_tick and systick_get_us, only moves when
+// advanced
+void sim_advance_ns(uint64_t ns);
+uint64_t sim_now_ns();
+
+// Value of every conversion, `conversion` counts them from `sim_init`. The
+// default source returns 0.
+void sim_adc_set_source(sim_adc_source source);
+// Added to the clock by every conversion
+void sim_adc_set_conversion_time(uint32_t ns);
+uint32_t sim_adc_get_conversions();
+
+// Output level of a pin, as last written by gpio_digital_write
+bool sim_gpio_get(const gpio_t *port, uint8_t num);
+uint32_t sim_gpio_get_writes();
+
+// Fake flash at FLASH_BASE. Erased like the real one (0xFF), only erased
+// double words can be programmed.
+void sim_flash_erase_all();
+uint32_t sim_flash_get_programs();
+
+// Split link UART. `sim_uart_rx` is written to the RX DMA ring,
+// `sim_uart_tx` takes bytes transmitted since the last call.
+void sim_uart_rx(const uint8_t *data, size_t length);
+size_t sim_uart_tx(uint8_t *buffer, size_t size);
+
+// Virtual USB host. The device is driven through the USBD_LL_* callbacks the
+// PCD would call, so the core and class code run unchanged.
+
+// Bus reset, SET_ADDRESS and SET_CONFIGURATION
+bool sim_usb_configure();
+
+// Control transfer. For IN requests `data` receives up to `*length` bytes
+// and `*length` is set to the amount returned. False if the request stalled.
+bool sim_usb_control(const uint8_t setup[8], uint8_t *data, uint16_t *length);
+
+void sim_usb_sof();
+
+// IN token, false (NAK) if nothing is armed on the endpoint
+bool sim_usb_in(uint8_t ep_addr, uint8_t *buffer, uint16_t *length);
+
+// OUT packet, false (NAK) if the endpoint isn't armed
+bool sim_usb_out(uint8_t ep_addr, const uint8_t *data, uint16_t length);
+
+#endif // SIM_H
@@ -0,0 +1,281 @@
+#ifndef STM32WBXX_H
+#define STM32WBXX_H
+
+// Host stand-in for the CMSIS device header. Peripherals are plain structs in
+// RAM, so the inline HAL functions and macros work on them like on the
+// registers. Only what the simulated sources use is here.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define __IO volatile
+#define __I volatile const
+#define __O volatile
+
+#define __PACKED __attribute__((packed))
+#define __ALIGN_BEGIN
+#define __ALIGN_END
+#define __STATIC_INLINE static inline
+#define __WEAK __attribute__((weak))
+
+#define SET_BIT(REG, BIT) ((REG) |= (BIT))
+#define CLEAR_BIT(REG, BIT) ((REG) &= ~(BIT))
+#define READ_BIT(REG, BIT) ((REG) & (BIT))
+#define CLEAR_REG(REG) ((REG) = (0x0))
+#define WRITE_REG(REG, VAL) ((REG) = (VAL))
+#define READ_REG(REG) ((REG))
+#define MODIFY_REG(REG, CLEARMASK, SETMASK)                                    \
+    WRITE_REG((REG), (((READ_REG(REG)) & (~(CLEARMASK))) | (SETMASK)))
+#define POSITION_VAL(VAL) (__builtin_ctz(VAL))
+#define ATOMIC_SET_BIT(REG, BIT) SET_BIT(REG, BIT)
+#define ATOMIC_CLEAR_BIT(REG, BIT) CLEAR_BIT(REG, BIT)
+
+// Single threaded, the simulation calls the "interrupts" itself
+static inline void __disable_irq() {}
+static inline void __enable_irq() {}
+static inline uint32_t __get_PRIMASK() { return 0U; }
+static inline void __set_PRIMASK(uint32_t primask) { (void)primask; }
+static inline void __DSB() {}
+static inline void __ISB() {}
+static inline void __NOP() {}
+static inline void __WFI() {}
+
+void NVIC_SystemReset();
+
+typedef enum {
+    SysTick_IRQn = -1,
+    ADC1_IRQn = 18,
+    USB_LP_IRQn = 20,
+    USART1_IRQn = 36,
+    DMA1_Channel1_IRQn = 11,
+    DMA1_Channel2_IRQn = 12,
+} IRQn_Type;
+
+typedef struct {
+    __IO uint32_t CR;
+    __IO uint32_t ICSCR;
+    __IO uint32_t CFGR;
+    __IO uint32_t AHB1ENR;
+    __IO uint32_t AHB2ENR;
+    __IO uint32_t APB1ENR1;
+    __IO uint32_t APB2ENR;
+} RCC_TypeDef;
+
+typedef struct {
+    __IO uint32_t MODER;
+    __IO uint32_t OTYPER;
+    __IO uint32_t OSPEEDR;
+    __IO uint32_t PUPDR;
+    __IO uint32_t IDR;
+    __IO uint32_t ODR;
+    __IO uint32_t BSRR;
+    __IO uint32_t LCKR;
+    __IO uint32_t AFR[2];
+    __IO uint32_t BRR;
+} GPIO_TypeDef;
+
+typedef struct {
+    __IO uint32_t ISR;
+    __IO uint32_t IER;
+    __IO uint32_t CR;
+    __IO uint32_t CFGR;
+    __IO uint32_t CFGR2;
+    __IO uint32_t SMPR1;
+    __IO uint32_t SMPR2;
+    __IO uint32_t SQR1;
+    __IO uint32_t SQR2;
+    __IO uint32_t SQR3;
+    __IO uint32_t SQR4;
+    __IO uint32_t DR;
+} ADC_TypeDef;
+
+typedef struct {
+    __IO uint32_t CCR;
+    __IO uint32_t CNDTR;
+    __IO uint32_t CPAR;
+    __IO uint32_t CMAR;
+} DMA_Channel_TypeDef;
+
+typedef struct {
+    __IO uint32_t ISR;
+    __IO uint32_t IFCR;
+} DMA_TypeDef;
+
+typedef struct {
+    __IO uint32_t CCR;
+} DMAMUX_Channel_TypeDef;
+
+typedef struct {
+    __IO uint32_t CSR;
+    __IO uint32_t CFR;
+} DMAMUX_ChannelStatus_TypeDef;
+
+typedef struct {
+    __IO uint32_t RGCR;
+} DMAMUX_RequestGen_TypeDef;
+
+typedef struct {
+    __IO uint32_t RGSR;
+    __IO uint32_t RGCFR;
+} DMAMUX_RequestGenStatus_TypeDef;
+
+typedef struct {
+    __IO uint32_t CR1;
+    __IO uint32_t CR2;
+    __IO uint32_t CR3;
+    __IO uint32_t BRR;
+    __IO uint32_t GTPR;
+    __IO uint32_t RTOR;
+    __IO uint32_t RQR;
+    __IO uint32_t ISR;
+    __IO uint32_t ICR;
+    __IO uint32_t RDR;
+    __IO uint32_t TDR;
+    __IO uint32_t PRESC;
+} USART_TypeDef;
+
+typedef struct {
+    __IO uint32_t ACR;
+    __IO uint32_t RESERVED;
+    __IO uint32_t KEYR;
+    __IO uint32_t OPTKEYR;
+    __IO uint32_t SR;
+    __IO uint32_t CR;
+    __IO uint32_t ECCR;
+} FLASH_TypeDef;
+
+typedef struct {
+    __IO uint16_t EP0R;
+    __IO uint16_t CNTR;
+    __IO uint16_t ISTR;
+    __IO uint16_t FNR;
+    __IO uint16_t DADDR;
+    __IO uint16_t BTABLE;
+} USB_TypeDef;
+
+extern RCC_TypeDef sim_rcc;
+extern GPIO_TypeDef sim_gpio[6];
+extern ADC_TypeDef sim_adc1;
+extern DMA_TypeDef sim_dma[2];
+extern DMA_Channel_TypeDef sim_dma_channel[14];
+extern DMAMUX_Channel_TypeDef sim_dmamux_channel[14];
+extern USART_TypeDef sim_usart1;
+extern USART_TypeDef sim_lpuart1;
+extern FLASH_TypeDef sim_flash;
+extern USB_TypeDef sim_usb;
+
+#define RCC (&sim_rcc)
+#define GPIOA (&sim_gpio[0])
+#define GPIOB (&sim_gpio[1])
+#define GPIOC (&sim_gpio[2])
+#define GPIOD (&sim_gpio[3])
+#define GPIOE (&sim_gpio[4])
+#define GPIOH (&sim_gpio[5])
+#define ADC1 (&sim_adc1)
+#define DMA1 (&sim_dma[0])
+#define DMA2 (&sim_dma[1])
+#define DMA1_Channel1 (&sim_dma_channel[0])
+#define DMA1_Channel2 (&sim_dma_channel[1])
+#define DMA1_Channel3 (&sim_dma_channel[2])
+#define DMA1_Channel4 (&sim_dma_channel[3])
+#define DMA1_Channel5 (&sim_dma_channel[4])
+#define DMA1_Channel6 (&sim_dma_channel[5])
+#define DMA1_Channel7 (&sim_dma_channel[6])
+#define DMAMUX1 (&sim_dmamux_channel[0])
+#define USART1 (&sim_usart1)
+#define LPUART1 (&sim_lpuart1)
+#define FLASH (&sim_flash)
+#define USB (&sim_usb)
+
+// Register bits, same values as on the MCU
+#define RCC_CFGR_SW_Pos (0U)
+#define RCC_CFGR_SWS_Pos (2U)
+#define RCC_AHB1ENR_DMA1EN (0x1UL << 0U)
+#define RCC_AHB1ENR_DMA2EN (0x1UL << 1U)
+#define RCC_AHB1ENR_DMAMUX1EN (0x1UL << 2U)
+#define RCC_CSR_BORRSTF (0x1UL << 27U)
+#define RCC_CSR_SFTRSTF (0x1UL << 28U)
+#define RCC_CSR_IWDGRSTF (0x1UL << 29U)
+#define RCC_CSR_WWDGRSTF (0x1UL << 30U)
+
+#define ADC_ISR_ADRDY (0x1UL << 0U)
+#define ADC_ISR_EOSMP (0x1UL << 1U)
+#define ADC_ISR_EOC (0x1UL << 2U)
+#define ADC_ISR_EOS (0x1UL << 3U)
+#define ADC_ISR_OVR (0x1UL << 4U)
+#define ADC_CR_ADEN (0x1UL << 0U)
+#define ADC_CR_ADDIS (0x1UL << 1U)
+#define ADC_CR_ADSTART (0x1UL << 2U)
+#define ADC_CR_JADSTART (0x1UL << 3U)
+#define ADC_CR_ADSTP (0x1UL << 4U)
+#define ADC_CR_ADVREGEN (0x1UL << 28U)
+#define ADC_CR_DEEPPWD (0x1UL << 29U)
+#define ADC_CR_ADCAL (0x1UL << 31U)
+#define ADC_CFGR_EXTSEL_0 (0x1UL << 6U)
+#define ADC_CFGR_EXTSEL_1 (0x1UL << 7U)
+#define ADC_CFGR_EXTSEL_2 (0x1UL << 8U)
+#define ADC_CFGR_EXTSEL_3 (0x1UL << 9U)
+
+#define DMA_CCR_EN (0x1UL << 0U)
+#define DMA_CCR_TCIE (0x1UL << 1U)
+#define DMA_CCR_HTIE (0x1UL << 2U)
+#define DMA_CCR_TEIE (0x1UL << 3U)
+#define DMA_CCR_DIR (0x1UL << 4U)
+#define DMA_CCR_CIRC (0x1UL << 5U)
+#define DMA_CCR_PINC (0x1UL << 6U)
+#define DMA_CCR_MINC (0x1UL << 7U)
+#define DMA_CCR_PSIZE_0 (0x1UL << 8U)
+#define DMA_CCR_PSIZE_1 (0x1UL << 9U)
+#define DMA_CCR_PSIZE (0x3UL << 8U)
+#define DMA_CCR_MSIZE_0 (0x1UL << 10U)
+#define DMA_CCR_MSIZE_1 (0x1UL << 11U)
+#define DMA_CCR_MSIZE (0x3UL << 10U)
+#define DMA_CCR_PL_0 (0x1UL << 12U)
+#define DMA_CCR_PL_1 (0x1UL << 13U)
+#define DMA_CCR_PL (0x3UL << 12U)
+#define DMA_CCR_MEM2MEM (0x1UL << 14U)
+
+#define FLASH_CR_PG (0x1UL << 0U)
+#define FLASH_CR_PER (0x1UL << 1U)
+#define FLASH_CR_STRT (0x1UL << 16U)
+#define FLASH_CR_FSTPG (0x1UL << 18U)
+#define FLASH_CR_LOCK (0x1UL << 31U)
+
+#define USART_CR1_UE (0x1UL << 0U)
+#define USART_CR1_RE (0x1UL << 2U)
+#define USART_CR1_TE (0x1UL << 3U)
+#define USART_CR1_IDLEIE (0x1UL << 4U)
+#define USART_CR1_TCIE (0x1UL << 6U)
+#define USART_CR1_PS (0x1UL << 9U)
+#define USART_CR1_PCE (0x1UL << 10U)
+#define USART_CR1_M0 (0x1UL << 12U)
+#define USART_CR1_OVER8 (0x1UL << 15U)
+#define USART_CR1_M1 (0x1UL << 28U)
+#define USART_CR1_FIFOEN (0x1UL << 29U)
+#define USART_CR2_STOP_0 (0x1UL << 12U)
+#define USART_CR2_STOP_1 (0x1UL << 13U)
+#define USART_CR2_ABREN (0x1UL << 20U)
+#define USART_CR2_ABRMODE_0 (0x1UL << 21U)
+#define USART_CR2_ABRMODE_1 (0x1UL << 22U)
+#define USART_CR2_ABRMODE (0x3UL << 21U)
+#define USART_CR3_DMAR (0x1UL << 6U)
+#define USART_CR3_DMAT (0x1UL << 7U)
+#define USART_CR3_RTSE (0x1UL << 8U)
+#define USART_CR3_CTSE (0x1UL << 9U)
+#define USART_CR3_ONEBIT (0x1UL << 11U)
+#define USART_CR3_RXFTCFG_0 (0x1UL << 25U)
+#define USART_CR3_RXFTCFG_1 (0x1UL << 26U)
+#define USART_CR3_RXFTCFG_2 (0x1UL << 27U)
+#define USART_CR3_TXFTCFG_0 (0x1UL << 29U)
+#define USART_CR3_TXFTCFG_1 (0x1UL << 30U)
+#define USART_CR3_TXFTCFG_2 (0x1UL << 31U)
+
+// The fake flash is mapped at the same address as on the MCU, see sim.h
+#define FLASH_BASE 0x08000000UL
+#define FLASH_SIZE 0x100000UL
+#define OTP_AREA_BASE 0x1FFF7000UL
+#define OTP_AREA_END_ADDR 0x1FFF73FFUL
+#define UID_BASE 0x1FFF7590UL
+
+#endif // STM32WBXX_H
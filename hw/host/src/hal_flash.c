@@ -0,0 +1,119 @@
+#include "hal_flash.h"
+
+#include "sim.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include <sys/mman.h>
+
+// Flash is read through plain pointers to its MCU addresses (eeprom_get,
+// memory_map.h), so the fake one is mapped right there. Same for the page
+// with the unique device ID.
+
+#define SIM_UID_PAGE (UID_BASE & ~0xFFFUL)
+#define SIM_UID_PAGE_SIZE 0x1000UL
+
+static bool mapped = false;
+static bool unlocked = false;
+static uint32_t programs = 0U;
+
+static void *sim_flash_map_at(uintptr_t address, size_t size) {
+
+    void *mem = mmap((void *)address, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (mem != (void *)address) {
+        sim_fatal("Unable to map 0x%08lx", (unsigned long)address);
+    }
+
+    return mem;
+}
+
+void sim_flash_map() {
+
+    if (!mapped) {
+        sim_flash_map_at(FLASH_BASE, FLASH_SIZE);
+        uint8_t *uid = sim_flash_map_at(SIM_UID_PAGE, SIM_UID_PAGE_SIZE);
+        for (size_t i = 0; i < 12U; i++) {
+            uid[(UID_BASE - SIM_UID_PAGE) + i] = (uint8_t)(0x51U + i);
+        }
+        mapped = true;
+    }
+
+    sim_flash_erase_all();
+    unlocked = false;
+    programs = 0U;
+}
+
+void sim_flash_erase_all() { memset((void *)FLASH_BASE, 0xFF, FLASH_SIZE); }
+
+uint32_t sim_flash_get_programs() { return programs; }
+
+hal_err flash_unlock() {
+    unlocked = true;
+
+    return OK;
+}
+
+hal_err flash_lock() {
+    unlocked = false;
+
+    return OK;
+}
+
+hal_err flash_erase(flash_page start_page, uint32_t page_amount,
+                    uint32_t *page_error) {
+
+    if (page_error) {
+        *page_error = 0xFFFFFFFFU;
+    }
+
+    if (!unlocked) {
+        return ERR_FLASH_WFOP_ERRFLAG;
+    }
+
+    if ((start_page - FLASH_BASE) % FLASH_PAGE_SIZE != 0U) {
+        return ERR_FLASH_PAGE_ERASE_NOTAPAGE;
+    }
+
+    uint32_t page = flash_get_page(start_page);
+    if (page + page_amount > FLASH_PAGE_NB) {
+        if (page_error) {
+            *page_error = page;
+        }
+        return ERR_FLASH_PAGE_ERASE_NOTAPAGE;
+    }
+
+    memset((void *)(uintptr_t)start_page, 0xFF,
+           (size_t)page_amount * FLASH_PAGE_SIZE);
+
+    return OK;
+}
+
+hal_err flash_program(flash_typeprogram typeprogram, uint32_t address,
+                      uint64_t data) {
+
+    if (!IS_ADDR_ALIGNED_64BITS(address)) {
+        return ERR_FLASH_PROGRAM_ADDRNOTALIGNED;
+    }
+
+    if (!IS_FLASH_PROGRAM_ADDRESS(address)) {
+        return ERR_FLASH_PROGRAM_NOTPROGRAMADDR;
+    }
+
+    // Fast programming isn't used by the firmware
+    if (typeprogram != FLASH_TYPEPROGRAM_DOUBLEWORD) {
+        return ERR_FLASH_PROGRAM_ADDRNOTFASTPROG;
+    }
+
+    volatile uint64_t *target = (volatile uint64_t *)(uintptr_t)address;
+
+    // PROGERR on the MCU
+    if (!unlocked || *target != UINT64_MAX) {
+        return ERR_FLASH_WFOP_ERRFLAG;
+    }
+
+    *target = data;
+    programs++;
+
+    return OK;
+}
@@ -0,0 +1,42 @@
+#include "hal_gpio.h"
+
+#include "sim.h"
+
+// Levels are kept in ODR, modes and speeds in their registers like on the MCU
+
+static uint32_t writes = 0U;
+
+void sim_gpio_reset() { writes = 0U; }
+
+bool sim_gpio_get(const gpio_t *port, uint8_t num) {
+    return READ_BIT(port->ODR, 1UL << num) != 0U;
+}
+
+uint32_t sim_gpio_get_writes() { return writes; }
+
+void gpio_turn_on_port(gpio_t *port) { (void)port; }
+
+void gpio_turn_off_port(gpio_t *port) { (void)port; }
+
+void gpio_set_mode(gpio_pin_t pin, gpio_mode mode) {
+    MODIFY_REG(pin.gpio->MODER, 0x3UL << (pin.num * 2U),
+               (uint32_t)mode << (pin.num * 2U));
+}
+
+void gpio_set_speed(gpio_pin_t pin, gpio_speed speed) {
+    MODIFY_REG(pin.gpio->OSPEEDR, 0x3UL << (pin.num * 2U),
+               (uint32_t)speed << (pin.num * 2U));
+}
+
+void gpio_digital_write(gpio_pin_t pin, bool val) {
+    if (val) {
+        SET_BIT(pin.gpio->ODR, 1UL << pin.num);
+    } else {
+        CLEAR_BIT(pin.gpio->ODR, 1UL << pin.num);
+    }
+    writes++;
+}
+
+bool gpio_digital_read(gpio_pin_t pin) {
+    return READ_BIT(pin.gpio->IDR, 1UL << pin.num) != 0U;
+}
@@ -0,0 +1,119 @@
+#include "hal_uart.h"
+
+#include "hal_dma.h"
+#include "sim.h"
+
+#include <string.h>
+
+// A single UART (the split link). DMA transfers complete as soon as they're
+// started, TX bytes are kept until taken by `sim_uart_tx`.
+
+#define SIM_UART_TX_LOG_SIZE 4096U
+
+static uint8_t tx_log[SIM_UART_TX_LOG_SIZE];
+static size_t tx_log_length = 0U;
+
+static dma_handle_t *rx_dma = NULL;
+static uint8_t *rx_buffer = NULL;
+static uint16_t rx_size = 0U;
+
+void sim_uart_reset() {
+    tx_log_length = 0U;
+    rx_dma = NULL;
+    rx_buffer = NULL;
+    rx_size = 0U;
+}
+
+void sim_uart_rx(const uint8_t *data, size_t length) {
+
+    if (!rx_dma) {
+        return;
+    }
+
+    // Circular, CNDTR counts down to 1 and reloads
+    for (size_t i = 0; i < length; i++) {
+        uint32_t remaining = dma_get_remaining(rx_dma);
+        rx_buffer[rx_size - remaining] = data[i];
+        WRITE_REG(rx_dma->instance->CNDTR,
+                  remaining == 1U ? rx_size : remaining - 1U);
+    }
+}
+
+size_t sim_uart_tx(uint8_t *buffer, size_t size) {
+
+    size_t length = tx_log_length < size ? tx_log_length : size;
+    memcpy(buffer, tx_log, length);
+    memmove(tx_log, &tx_log[length], tx_log_length - length);
+    tx_log_length -= length;
+
+    return length;
+}
+
+hal_err dma_init(dma_handle_t *handle) {
+    handle->state = HAL_DMA_STATE_READY;
+
+    return OK;
+}
+
+hal_err uart_init(uart_handle_t *handle, const uart_init_t *init) {
+
+    if (!handle || !init) {
+        return ERR_UART_INIT_ARGNULL;
+    }
+
+    handle->instance = init->instance;
+    handle->init = *init;
+    handle->state = HAL_UART_STATE_READY;
+    handle->rx_state = HAL_UART_STATE_READY;
+
+    return OK;
+}
+
+hal_err uart_fifo_disable(uart_handle_t *handle) {
+    handle->fifo_enabled = false;
+
+    return OK;
+}
+
+hal_err uart_transmit_dma(uart_handle_t *handle, dma_handle_t *dma,
+                          const uint8_t *tx_buffer, uint16_t buffer_size) {
+    (void)dma;
+
+    if (handle->state != HAL_UART_STATE_READY) {
+        return ERR_UART_TXDMA_BUSY;
+    }
+
+    if (!tx_buffer || buffer_size == 0U) {
+        return ERR_UART_TX_BADARGS;
+    }
+
+    if (tx_log_length + buffer_size > SIM_UART_TX_LOG_SIZE) {
+        sim_fatal("UART TX log full");
+    }
+
+    memcpy(&tx_log[tx_log_length], tx_buffer, buffer_size);
+    tx_log_length += buffer_size;
+
+    return OK;
+}
+
+hal_err uart_receive_dma(uart_handle_t *handle, dma_handle_t *dma,
+                         uint8_t *buffer, uint16_t buffer_size) {
+
+    if (handle->rx_state != HAL_UART_STATE_READY) {
+        return ERR_UART_RXDMA_BUSY;
+    }
+
+    if (!buffer || buffer_size == 0U) {
+        return ERR_UART_RX_BADARGS;
+    }
+
+    handle->rx_state = HAL_UART_STATE_BUSY_RX;
+
+    rx_dma = dma;
+    rx_buffer = buffer;
+    rx_size = buffer_size;
+    WRITE_REG(dma->instance->CNDTR, buffer_size);
+
+    return OK;
+}
@@ -0,0 +1,129 @@
+#include "sim.h"
+
+#include "error_handler.h"
+#include "hal_clock.h"
+#include "hal_cortex.h"
+#include "hal_iwdg.h"
+#include "hal_systick.h"
+#include "stack_usage.h"
+#include "stm32wbxx.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+RCC_TypeDef sim_rcc;
+GPIO_TypeDef sim_gpio[6];
+ADC_TypeDef sim_adc1;
+DMA_TypeDef sim_dma[2];
+DMA_Channel_TypeDef sim_dma_channel[14];
+DMAMUX_Channel_TypeDef sim_dmamux_channel[14];
+USART_TypeDef sim_usart1;
+USART_TypeDef sim_lpuart1;
+FLASH_TypeDef sim_flash;
+USB_TypeDef sim_usb;
+
+static uint64_t now_ns = 0U;
+static sim_reset_handler reset_handler = NULL;
+
+// Defined by the mocks
+void sim_flash_map();
+void sim_adc_reset();
+void sim_gpio_reset();
+void sim_uart_reset();
+
+void sim_init() {
+
+    memset(&sim_rcc, 0, sizeof(sim_rcc));
+    memset(sim_gpio, 0, sizeof(sim_gpio));
+    memset(&sim_adc1, 0, sizeof(sim_adc1));
+    memset(sim_dma, 0, sizeof(sim_dma));
+    memset(sim_dma_channel, 0, sizeof(sim_dma_channel));
+    memset(sim_dmamux_channel, 0, sizeof(sim_dmamux_channel));
+    memset(&sim_usart1, 0, sizeof(sim_usart1));
+    memset(&sim_lpuart1, 0, sizeof(sim_lpuart1));
+    memset(&sim_flash, 0, sizeof(sim_flash));
+    memset(&sim_usb, 0, sizeof(sim_usb));
+
+    now_ns = 0U;
+
+    sim_flash_map();
+    sim_adc_reset();
+    sim_gpio_reset();
+    sim_uart_reset();
+}
+
+void sim_fatal(const char *format, ...) {
+
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "sim: ");
+    vfprintf(stderr, format, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+
+    exit(EXIT_FAILURE);
+}
+
+void sim_advance_ns(uint64_t ns) { now_ns += ns; }
+
+uint64_t sim_now_ns() { return now_ns; }
+
+hal_err systick_init() { return OK; }
+
+void systick_delay(uint32_t ms) { sim_advance_ns((uint64_t)ms * 1000000U); }
+
+uint32_t systick_get_tick() { return (uint32_t)(now_ns / 1000000U); }
+
+uint32_t systick_get_us() { return (uint32_t)(now_ns / 1000U); }
+
+void cortex_nvic_enable(IRQn_Type irqn) { (void)irqn; }
+
+void cortex_nvic_disable(IRQn_Type irqn) { (void)irqn; }
+
+hal_err cortex_nvic_set_priority(IRQn_Type irqn, uint32_t preempt_priority,
+                                 uint32_t sub_priority) {
+    (void)irqn;
+    (void)preempt_priority;
+    (void)sub_priority;
+
+    return OK;
+}
+
+void sim_set_reset_handler(sim_reset_handler handler) {
+    reset_handler = handler;
+}
+
+hal_err iwdg_init(iwdg_prescaler prescaler, uint16_t reload) {
+    (void)prescaler;
+    (void)reload;
+
+    return OK;
+}
+
+void iwdg_refresh() {}
+
+void iwdg_freeze_in_debug() {}
+
+uint32_t clock_get_reset_flags() { return 0U; }
+
+void clock_clear_reset_flags() {}
+
+void NVIC_SystemReset() {
+    if (reset_handler) {
+        reset_handler();
+    }
+    sim_fatal("System reset");
+}
+
+// The host stack isn't painted
+stack_usage_t stack_get_usage() { return (stack_usage_t){0}; }
+
+void setup_error_handler() {}
+
+void error_handler(hal_err error_code) {
+    if (error_code != OK) {
+        sim_fatal("Error %d", error_code);
+    }
+}
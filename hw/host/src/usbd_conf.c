@@ -0,0 +1,371 @@
+#include "usb/usbd_conf.h"
+
+#include "hal_pcd.h"
+#include "hal_usb.h"
+#include "sim.h"
+#include "usb/usbd_core.h"
+#include "usb/usbd_hid.h"
+
+#include <string.h>
+
+// Virtual PCD. Endpoints are armed by the USBD_LL_* calls of the stack and
+// emptied/filled by the simulated host, which then calls back into the stack
+// like the PCD interrupt handler does (see usbd_conf.c of the firmware).
+
+#define SIM_USB_EP_COUNT 8U
+#define SIM_USB_MAX_PACKET 64U
+// Control transfers stop after this many packets, a stuck transfer otherwise
+// loops forever
+#define SIM_USB_CONTROL_PACKET_LIMIT 256U
+
+typedef struct {
+
+    uint16_t mps;
+    bool stalled;
+    bool armed;
+
+    // IN: packet being sent, rest of the transfer after it
+    uint8_t packet[SIM_USB_MAX_PACKET];
+    uint16_t packet_length;
+    uint8_t *xfer_buff;
+    uint32_t xfer_remaining;
+
+    // OUT: reception buffer
+    uint32_t xfer_length;
+    uint32_t xfer_count;
+
+} sim_usb_ep_t;
+
+static USBD_HandleTypeDef *device = NULL;
+static PCD_HandleTypeDef hpcd_sim;
+
+static sim_usb_ep_t in_eps[SIM_USB_EP_COUNT];
+static sim_usb_ep_t out_eps[SIM_USB_EP_COUNT];
+
+static inline sim_usb_ep_t *sim_usb_get_ep(uint8_t ep_addr) {
+
+    uint8_t index = ep_addr & 0x7FU;
+    if (index >= SIM_USB_EP_COUNT) {
+        sim_fatal("Invalid endpoint 0x%02x", ep_addr);
+    }
+
+    return (ep_addr & 0x80U) ? &in_eps[index] : &out_eps[index];
+}
+
+// Next packet of the armed IN transfer
+static void sim_usb_load_packet(sim_usb_ep_t *ep) {
+
+    ep->packet_length = ep->xfer_remaining < ep->mps
+                            ? (uint16_t)ep->xfer_remaining
+                            : ep->mps;
+    if (ep->packet_length) {
+        memcpy(ep->packet, ep->xfer_buff, ep->packet_length);
+    }
+    ep->xfer_buff += ep->packet_length;
+    ep->xfer_remaining -= ep->packet_length;
+}
+
+USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev) {
+
+    memset(in_eps, 0, sizeof(in_eps));
+    memset(out_eps, 0, sizeof(out_eps));
+
+    memset(&hpcd_sim, 0, sizeof(hpcd_sim));
+    hpcd_sim.Instance = USB;
+    hpcd_sim.pData = pdev;
+    pdev->pData = &hpcd_sim;
+
+    device = pdev;
+
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_DeInit(USBD_HandleTypeDef *pdev) {
+    UNUSED(pdev);
+
+    device = NULL;
+
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_Start(USBD_HandleTypeDef *pdev) {
+    UNUSED(pdev);
+
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_Stop(USBD_HandleTypeDef *pdev) {
+    UNUSED(pdev);
+
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_OpenEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr,
+                                  uint8_t ep_type, uint16_t ep_mps) {
+    UNUSED(pdev);
+    UNUSED(ep_type);
+
+    if (ep_mps > SIM_USB_MAX_PACKET) {
+        sim_fatal("Endpoint 0x%02x max packet %u", ep_addr, ep_mps);
+    }
+
+    sim_usb_ep_t *ep = sim_usb_get_ep(ep_addr);
+    memset(ep, 0, sizeof(*ep));
+    ep->mps = ep_mps;
+
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_CloseEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr) {
+    UNUSED(pdev);
+
+    sim_usb_ep_t *ep = sim_usb_get_ep(ep_addr);
+    ep->armed = false;
+    ep->mps = 0U;
+
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_FlushEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr) {
+    UNUSED(pdev);
+
+    sim_usb_get_ep(ep_addr)->armed = false;
+
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_StallEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr) {
+    UNUSED(pdev);
+
+    sim_usb_get_ep(ep_addr)->stalled = true;
+
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_ClearStallEP(USBD_HandleTypeDef *pdev,
+                                        uint8_t ep_addr) {
+    UNUSED(pdev);
+
+    sim_usb_get_ep(ep_addr)->stalled = false;
+
+    return USBD_OK;
+}
+
+uint8_t USBD_LL_IsStallEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr) {
+    UNUSED(pdev);
+
+    return sim_usb_get_ep(ep_addr)->stalled;
+}
+
+USBD_StatusTypeDef USBD_LL_SetUSBAddress(USBD_HandleTypeDef *pdev,
+                                         uint8_t dev_addr) {
+    UNUSED(pdev);
+
+    WRITE_REG(USB->DADDR, dev_addr);
+
+    return USBD_OK;
+}
+
+// Control IN transfers complete packet by packet, the stack continues them,
+// the others complete once everything is sent
+USBD_StatusTypeDef USBD_LL_Transmit(USBD_HandleTypeDef *pdev, uint8_t ep_addr,
+                                    uint8_t *pbuf, uint32_t size) {
+    UNUSED(pdev);
+
+    sim_usb_ep_t *ep = sim_usb_get_ep(ep_addr | 0x80U);
+    if (ep->armed) {
+        sim_fatal("Transmit on busy endpoint 0x%02x", ep_addr | 0x80U);
+    }
+
+    ep->xfer_buff = pbuf;
+    ep->xfer_remaining = (ep_addr & 0x7FU) == 0U && size > ep->mps
+                             ? ep->mps
+                             : size;
+    sim_usb_load_packet(ep);
+    ep->armed = true;
+
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_PrepareReceive(USBD_HandleTypeDef *pdev,
+                                          uint8_t ep_addr, uint8_t *pbuf,
+                                          uint32_t size) {
+    UNUSED(pdev);
+
+    sim_usb_ep_t *ep = sim_usb_get_ep(ep_addr & 0x7FU);
+
+    ep->xfer_buff = pbuf;
+    ep->xfer_length = size;
+    ep->xfer_count = 0U;
+    ep->armed = true;
+
+    return USBD_OK;
+}
+
+uint32_t USBD_LL_GetRxDataSize(USBD_HandleTypeDef *pdev, uint8_t ep_addr) {
+    UNUSED(pdev);
+
+    return sim_usb_get_ep(ep_addr & 0x7FU)->xfer_count;
+}
+
+void USBD_LL_Delay(uint32_t Delay) {
+    sim_advance_ns((uint64_t)Delay * 1000000U);
+}
+
+void *USBD_static_malloc(uint32_t size) {
+    UNUSED(size);
+    static uint32_t mem[(sizeof(USBD_HID_HandleTypeDef) / 4) + 1];
+    return mem;
+}
+
+void USBD_static_free(void *p) { UNUSED(p); }
+
+void hal_usb_enable_interrupts() {}
+
+void hal_usb_disable_interrupts() {}
+
+hal_err USB_DevConnect(USB_TypeDef *USBx) {
+    UNUSED(USBx);
+
+    return OK;
+}
+
+bool sim_usb_in(uint8_t ep_addr, uint8_t *buffer, uint16_t *length) {
+
+    sim_usb_ep_t *ep = sim_usb_get_ep(ep_addr | 0x80U);
+    if (!device || !ep->armed || ep->stalled) {
+        return false;
+    }
+
+    memcpy(buffer, ep->packet, ep->packet_length);
+    *length = ep->packet_length;
+
+    // Last packet of the transfer, unless it's a full one and more follows
+    if (ep->xfer_remaining > 0U) {
+        sim_usb_load_packet(ep);
+        return true;
+    }
+
+    ep->armed = false;
+    USBD_LL_DataInStage(device, ep_addr & 0x7FU, ep->xfer_buff);
+
+    return true;
+}
+
+bool sim_usb_out(uint8_t ep_addr, const uint8_t *data, uint16_t length) {
+
+    sim_usb_ep_t *ep = sim_usb_get_ep(ep_addr & 0x7FU);
+    if (!device || !ep->armed || ep->stalled) {
+        return false;
+    }
+    if (length > ep->mps) {
+        sim_fatal("OUT packet of %u on 0x%02x", length, ep_addr);
+    }
+
+    uint32_t room = ep->xfer_length - ep->xfer_count;
+    uint16_t copied = length < room ? length : (uint16_t)room;
+    if (copied) {
+        memcpy(ep->xfer_buff, data, copied);
+    }
+    ep->xfer_buff += copied;
+    ep->xfer_count += copied;
+
+    // Short packet or full buffer ends the transfer
+    if (length == ep->mps && ep->xfer_count < ep->xfer_length) {
+        return true;
+    }
+
+    ep->armed = false;
+    USBD_LL_DataOutStage(device, ep_addr & 0x7FU, ep->xfer_buff);
+
+    return true;
+}
+
+bool sim_usb_control(const uint8_t setup[8], uint8_t *data, uint16_t *length) {
+
+    if (!device) {
+        return false;
+    }
+
+    bool device_to_host = setup[0] & 0x80U;
+    uint16_t w_length = (uint16_t)(setup[6] | (setup[7] << 8));
+    uint16_t room = length ? *length : 0U;
+    uint16_t transferred = 0U;
+
+    // A SETUP packet clears both EP0 directions
+    sim_usb_ep_t *in_ep = sim_usb_get_ep(0x80U);
+    sim_usb_ep_t *out_ep = sim_usb_get_ep(0x00U);
+    in_ep->armed = out_ep->armed = false;
+    in_ep->stalled = out_ep->stalled = false;
+
+    uint8_t request[8];
+    memcpy(request, setup, sizeof(request));
+    USBD_LL_SetupStage(device, request);
+
+    if (in_ep->stalled || out_ep->stalled) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < SIM_USB_CONTROL_PACKET_LIMIT; i++) {
+
+        uint8_t packet[SIM_USB_MAX_PACKET];
+        uint16_t packet_length;
+
+        if (in_ep->armed) {
+            sim_usb_in(0x80U, packet, &packet_length);
+            if (device_to_host && transferred < room) {
+                uint16_t size = room - transferred < packet_length
+                                    ? room - transferred
+                                    : packet_length;
+                memcpy(&data[transferred], packet, size);
+                transferred += size;
+            }
+        } else if (out_ep->armed) {
+            if (device_to_host || transferred >= w_length) {
+                // Status stage of IN requests
+                sim_usb_out(0x00U, NULL, 0U);
+                break;
+            }
+            packet_length = w_length - transferred < out_ep->mps
+                                ? w_length - transferred
+                                : out_ep->mps;
+            sim_usb_out(0x00U, &data[transferred], packet_length);
+            transferred += packet_length;
+        } else {
+            break;
+        }
+    }
+
+    if (length) {
+        *length = transferred;
+    }
+
+    return true;
+}
+
+bool sim_usb_configure() {
+
+    if (!device) {
+        return false;
+    }
+
+    USBD_LL_SetSpeed(device, USBD_SPEED_FULL);
+    USBD_LL_Reset(device);
+
+    static const uint8_t set_address[8] = {0x00, USB_REQ_SET_ADDRESS, 0x01};
+    static const uint8_t set_configuration[8] = {
+        0x00, USB_REQ_SET_CONFIGURATION, 0x01};
+
+    if (!sim_usb_control(set_address, NULL, NULL) ||
+        !sim_usb_control(set_configuration, NULL, NULL)) {
+        return false;
+    }
+
+    return device->dev_state == USBD_STATE_CONFIGURED;
+}
+
+void sim_usb_sof() {
+    if (device) {
+        USBD_LL_SOF(device);
+    }
+}
@@ -260,4 +260,8 @@ void clock_pll_config(const clock_pll_config_t *config);
 void clock_pll_update_config(clock_pll_config_t *config);
 void clock_pll_enable();
 
+// Reset flags (RCC_CSR_*RSTF), they add up over resets until cleared
+uint32_t clock_get_reset_flags();
+void clock_clear_reset_flags();
+
 #endif // HAL_CLOCK_H
@@ -170,4 +170,10 @@ static inline void dma_mux_enable() {
 hal_err dma_start_it(dma_handle_t *handle, uint32_t source_address,
                      uint32_t destination_address, uint32_t length);
 
+// Data items left in the current transfer, in circular mode it's reloaded on
+// every wrap around
+static inline uint32_t dma_get_remaining(const dma_handle_t *handle) {
+    return READ_REG(handle->instance->CNDTR);
+}
+
 #endif // HAL_DMA_H
@@ -66,6 +66,8 @@ typedef error_t hal_err;
 #define ERR_UART_TX_BADARGS -915
 #define ERR_UART_RX_BUSY -916
 #define ERR_UART_RX_BADARGS -917
+#define ERR_UART_TXDMA_BUSY -918
+#define ERR_UART_RXDMA_BUSY -919
 
 #define ERR_I2C_INIT_ARGNULL -1000
 #define ERR_I2C_INIT_INSTANCENULL -1001
@@ -0,0 +1,37 @@
+#ifndef HAL_IWDG_H
+#define HAL_IWDG_H
+
+#include "hal_err.h"
+
+#include <stdint.h>
+
+#define ERR_IWDG_INIT_BADARGS -1800
+#define ERR_IWDG_INIT_TIMEOUT -1801
+
+// Clocked by the LSI
+#define IWDG_LSI_VALUE 32000U
+#define IWDG_RELOAD_MAX 0x0FFFU
+
+// ms for the registers to be updated, a few LSI cycles
+#define IWDG_UPDATE_TIMEOUT 10U
+
+typedef enum {
+    IWDG_PRESCALER_4 = 0U,
+    IWDG_PRESCALER_8 = 1U,
+    IWDG_PRESCALER_16 = 2U,
+    IWDG_PRESCALER_32 = 3U,
+    IWDG_PRESCALER_64 = 4U,
+    IWDG_PRESCALER_128 = 5U,
+    IWDG_PRESCALER_256 = 6U,
+} iwdg_prescaler;
+
+// Starts the watchdog, it runs until the next reset. The MCU is reset after
+// (`reload` + 1) * 4 << `prescaler` LSI cycles without a refresh.
+hal_err iwdg_init(iwdg_prescaler prescaler, uint16_t reload);
+
+void iwdg_refresh();
+
+// Stops the counter while the core is halted by the debugger
+void iwdg_freeze_in_debug();
+
+#endif // HAL_IWDG_H
@@ -17,4 +17,7 @@ void systick_delay(uint32_t ms);
 
 uint32_t systick_get_tick();
 
+// Microseconds since systick_init, wraps around every ~71 minutes
+uint32_t systick_get_us();
+
 #endif // HAL_SYSTICK_H
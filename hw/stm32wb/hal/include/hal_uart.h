@@ -1,6 +1,7 @@
 #ifndef HAL_UART_H
 #define HAL_UART_H
 
+#include "hal_dma.h"
 #include "hal_err.h"
 #include "hal_gpio.h"
 #include "stm32wbxx.h"
@@ -226,4 +227,14 @@ hal_err uart_transmit(uart_handle_t *handle, const uint8_t *tx_buffer,
 hal_err uart_receive(uart_handle_t *handle, uint8_t *rx_buffer,
                      uint16_t buffer_size, uint32_t timeout);
 
+// DMA channels have to be initialized with the TX/RX request of the instance
+// and their IRQs enabled. `tx_buffer` has to stay valid until the transfer is
+// complete, which is when `handle->state` is HAL_UART_STATE_READY again.
+hal_err uart_transmit_dma(uart_handle_t *handle, dma_handle_t *dma,
+                          const uint8_t *tx_buffer, uint16_t buffer_size);
+// With a circular DMA channel reception never ends, the write position is
+// `buffer_size - dma_get_remaining(dma)`
+hal_err uart_receive_dma(uart_handle_t *handle, dma_handle_t *dma,
+                         uint8_t *rx_buffer, uint16_t buffer_size);
+
 #endif // HAL_UART_H
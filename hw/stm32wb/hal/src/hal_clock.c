@@ -185,3 +185,12 @@ void clock_pll_enable() {
         // Wait for PLL to be ready
     }
 }
+
+uint32_t clock_get_reset_flags() {
+    return READ_BIT(RCC->CSR, RCC_CSR_LPWRRSTF | RCC_CSR_WWDGRSTF |
+                                  RCC_CSR_IWDGRSTF | RCC_CSR_SFTRSTF |
+                                  RCC_CSR_BORRSTF | RCC_CSR_PINRSTF |
+                                  RCC_CSR_OBLRSTF);
+}
+
+void clock_clear_reset_flags() { SET_BIT(RCC->CSR, RCC_CSR_RMVF); }
@@ -37,11 +37,17 @@ hal_err dma_init(dma_handle_t *handle) {
               (DMA_CCR_PL | DMA_CCR_MSIZE | DMA_CCR_PSIZE | DMA_CCR_MINC |
                DMA_CCR_PINC | DMA_CCR_CIRC | DMA_CCR_DIR | DMA_CCR_MEM2MEM));
 
-    tmp |= handle->init.direction | handle->init.peripheralAddrIncrement |
-           handle->init.memoryAddrIncrement | handle->init.peripheral_align |
+    tmp |= handle->init.direction | handle->init.peripheral_align |
            handle->init.memory_align | handle->init.mode |
            handle->init.priority;
 
+    if (handle->init.peripheralAddrIncrement) {
+        tmp |= DMA_CCR_PINC;
+    }
+    if (handle->init.memoryAddrIncrement) {
+        tmp |= DMA_CCR_MINC;
+    }
+
     WRITE_REG(handle->instance->CCR, tmp);
 
     if ((uint32_t)handle->instance < (uint32_t)DMA2_Channel1) {
@@ -135,7 +141,8 @@ hal_err dma_start_it(dma_handle_t *handle, uint32_t source_address,
     handle->state = HAL_DMA_STATE_BUSY;
     handle->error = HAL_DMA_ERROR_NONE;
 
-    dma_disable();
+    // Channel has to be disabled to be reconfigured
+    CLEAR_BIT(handle->instance->CCR, DMA_CCR_EN);
 
     dma_set_config(handle, source_address, destination_address, length);
 
@@ -155,11 +162,12 @@ hal_err dma_start_it(dma_handle_t *handle, uint32_t source_address,
         SET_BIT(handle->dmamux_request_generator->RGCR, DMAMUX_RGxCR_OIE);
     }
 
+    // Same order as the IRQ handlers below: DMA1 channels, then DMA2 ones
     if (handle->dma_base == DMA1) {
-        hal_dma_active_handlers[handle->channel_index] = handle;
+        hal_dma_active_handlers[handle->channel_index >> 2U] = handle;
     }
     if (handle->dma_base == DMA2) {
-        hal_dma_active_handlers[handle->channel_index * 2] = handle;
+        hal_dma_active_handlers[7U + (handle->channel_index >> 2U)] = handle;
     }
 
     SET_BIT(handle->instance->CCR, DMA_CCR_EN);
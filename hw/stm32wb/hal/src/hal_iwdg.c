@@ -0,0 +1,41 @@
+#include "hal_iwdg.h"
+
+#include "hal_bits.h"
+#include "hal_systick.h"
+#include "stm32wbxx.h"
+
+#define IWDG_KEY_RELOAD 0x0000AAAAU
+#define IWDG_KEY_ENABLE 0x0000CCCCU
+#define IWDG_KEY_WRITE_ACCESS_ENABLE 0x00005555U
+
+hal_err iwdg_init(iwdg_prescaler prescaler, uint16_t reload) {
+
+    if (prescaler > IWDG_PRESCALER_256 || reload > IWDG_RELOAD_MAX) {
+        return ERR_IWDG_INIT_BADARGS;
+    }
+
+    // Also starts the LSI
+    WRITE_REG(IWDG->KR, IWDG_KEY_ENABLE);
+
+    WRITE_REG(IWDG->KR, IWDG_KEY_WRITE_ACCESS_ENABLE);
+    WRITE_REG(IWDG->PR, prescaler);
+    WRITE_REG(IWDG->RLR, reload);
+
+    uint32_t tick_start = systick_get_tick();
+
+    while (READ_BIT(IWDG->SR, IWDG_SR_PVU | IWDG_SR_RVU | IWDG_SR_WVU)) {
+        if (systick_get_tick() - tick_start >= IWDG_UPDATE_TIMEOUT) {
+            return ERR_IWDG_INIT_TIMEOUT;
+        }
+    }
+
+    iwdg_refresh();
+
+    return OK;
+}
+
+void iwdg_refresh() { WRITE_REG(IWDG->KR, IWDG_KEY_RELOAD); }
+
+void iwdg_freeze_in_debug() {
+    SET_BIT(DBGMCU->APB1FZR1, DBGMCU_APB1FZR1_DBG_IWDG_STOP);
+}
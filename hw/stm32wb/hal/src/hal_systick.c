@@ -20,6 +20,23 @@ hal_err systick_init() {
 
 uint32_t systick_get_tick() { return tick; }
 
+uint32_t systick_get_us() {
+    uint32_t ms;
+    uint32_t val;
+
+    // Re-read if the tick interrupt happened in between
+    do {
+        ms = tick;
+        val = SysTick->VAL;
+    } while (ms != tick);
+
+    uint32_t load = SysTick->LOAD + 1U;
+    uint32_t period_us = (uint32_t)systick_freq * 1000U;
+
+    return ms * 1000U +
+           (uint32_t)((uint64_t)(load - 1U - val) * period_us / load);
+}
+
 void systick_delay(uint32_t ms) {
     while (ms) {
         if (READ_BIT(SysTick->CTRL, SysTick_CTRL_COUNTFLAG_Msk)) {
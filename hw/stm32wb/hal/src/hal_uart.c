@@ -716,3 +716,94 @@ hal_err uart_transmit(uart_handle_t *handle, const uint8_t *tx_buffer,
     handle->state = HAL_UART_STATE_READY;
     return OK;
 }
+
+static void anyuart_dma_transmit_complete(dma_handle_t *dma) {
+    uart_handle_t *handle = dma->parent;
+
+    ATOMIC_CLEAR_BIT(handle->instance->CR3, USART_CR3_DMAT);
+    handle->tx_xfer_count = 0U;
+    handle->state = HAL_UART_STATE_READY;
+}
+
+static void anyuart_dma_error(dma_handle_t *dma) {
+    uart_handle_t *handle = dma->parent;
+
+    handle->error |= HAL_UART_ERROR_DMA;
+
+    if (handle->state == HAL_UART_STATE_BUSY_TX) {
+        ATOMIC_CLEAR_BIT(handle->instance->CR3, USART_CR3_DMAT);
+        handle->state = HAL_UART_STATE_READY;
+    }
+}
+
+hal_err uart_transmit_dma(uart_handle_t *handle, dma_handle_t *dma,
+                          const uint8_t *tx_buffer, uint16_t buffer_size) {
+
+    if (handle->state != HAL_UART_STATE_READY) {
+        return ERR_UART_TXDMA_BUSY;
+    }
+
+    if (!dma || !tx_buffer || buffer_size == 0U) {
+        return ERR_UART_TX_BADARGS;
+    }
+
+    handle->error = HAL_UART_ERROR_NONE;
+    handle->state = HAL_UART_STATE_BUSY_TX;
+
+    handle->tx_xfer_size = buffer_size;
+    handle->tx_xfer_count = buffer_size;
+
+    dma->parent = handle;
+    dma->xfer_complete_callback = anyuart_dma_transmit_complete;
+    dma->xfer_half_complete_callback = NULL;
+    dma->xfer_error_callback = anyuart_dma_error;
+
+    hal_err err = dma_start_it(dma, (uint32_t)tx_buffer,
+                               (uint32_t)&handle->instance->TDR, buffer_size);
+    if (err) {
+        handle->state = HAL_UART_STATE_READY;
+        return err;
+    }
+
+    WRITE_REG(handle->instance->ICR, USART_ICR_TCCF);
+    ATOMIC_SET_BIT(handle->instance->CR3, USART_CR3_DMAT);
+
+    return OK;
+}
+
+hal_err uart_receive_dma(uart_handle_t *handle, dma_handle_t *dma,
+                         uint8_t *rx_buffer, uint16_t buffer_size) {
+
+    if (handle->rx_state != HAL_UART_STATE_READY) {
+        return ERR_UART_RXDMA_BUSY;
+    }
+
+    if (!dma || !rx_buffer || buffer_size == 0U) {
+        return ERR_UART_RX_BADARGS;
+    }
+
+    handle->error = HAL_UART_ERROR_NONE;
+    handle->rx_state = HAL_UART_STATE_BUSY_RX;
+    handle->reception_type = UART_RECEPTION_TYPE_STANDARD;
+
+    handle->rx_xfer_size = buffer_size;
+    handle->rx_xfer_count = buffer_size;
+
+    dma->parent = handle;
+    dma->xfer_complete_callback = NULL;
+    dma->xfer_half_complete_callback = NULL;
+    dma->xfer_error_callback = anyuart_dma_error;
+
+    hal_err err = dma_start_it(dma, (uint32_t)&handle->instance->RDR,
+                               (uint32_t)rx_buffer, buffer_size);
+    if (err) {
+        handle->rx_state = HAL_UART_STATE_READY;
+        return err;
+    }
+
+    // Overrun would stop the reception, DMA keeps up with the data anyway
+    WRITE_REG(handle->instance->ICR, USART_ICR_ORECF);
+    ATOMIC_SET_BIT(handle->instance->CR3, USART_CR3_DMAR);
+
+    return OK;
+}
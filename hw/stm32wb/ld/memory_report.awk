@@ -0,0 +1,122 @@
+# Flash and RAM used per module, read from the GNU ld map of an image linked
+# with application.ld or bootloader.ld. Largest RAM user first, then the
+# budgets of the linker script.
+#
+#   awk -f memory_report.awk <image>.map
+#
+# Flash covers code, constants and the load image of initialized data, RAM
+# covers initialized data, .bss, the retained area and the shared RAM. Library
+# objects are grouped by archive.
+
+# Not every awk has strtonum
+function hex(text,    value, i) {
+    value = 0;
+    text = tolower(substr(text, 3));
+    for (i = 1; i <= length(text); i++) {
+        value = value * 16 + index("0123456789abcdef", substr(text, i, 1)) - 1;
+    }
+    return value;
+}
+
+function module_name(file) {
+    if (file ~ /\.a\(/) {
+        sub(/\(.*$/, "", file);
+    }
+    sub(/^.*\//, "", file);
+    sub(/\.o$/, "", file);
+    return file;
+}
+
+function account(file, size) {
+    if (!(section in flash_sections) && !(section in ram_sections)) {
+        return;
+    }
+
+    module = file == "" ? "(fill)" : module_name(file);
+    modules[module] = 1;
+
+    if (section in flash_sections) {
+        flash[module] += size;
+        flash_total += size;
+    }
+    if (section in ram_sections) {
+        ram[module] += size;
+        ram_total += size;
+    }
+}
+
+BEGIN {
+    split(".isr_vector .text .rodata .ARM.extab .ARM .preinit_array " \
+          ".init_array .fini_array .data .MB_MEM2", names, " ");
+    for (i in names) {
+        flash_sections[names[i]] = 1;
+    }
+    split(".data .bss .noinit MAPPING_TABLE MB_MEM1 .MB_MEM2", names, " ");
+    for (i in names) {
+        ram_sections[names[i]] = 1;
+    }
+}
+
+/^Linker script and memory map/ {
+    in_map = 1;
+    next;
+}
+
+!in_map {
+    next;
+}
+
+# Symbols assigned by the linker script
+$1 ~ /^0x/ && $3 == "=" {
+    symbols[$2] = hex($1);
+    next;
+}
+
+# Output section, its address may follow on the next line
+/^[._A-Za-z]/ {
+    section = $1;
+    pending = "";
+    next;
+}
+
+# Input section, the name alone on its line when it's long
+/^ [^ ]/ {
+    if (NF == 1) {
+        pending = $1;
+        next;
+    }
+    pending = "";
+    if ($2 ~ /^0x/ && $3 ~ /^0x/) {
+        account($1 == "*fill*" ? "" : $4, hex($3));
+    }
+    next;
+}
+
+pending != "" && NF >= 3 && $1 ~ /^0x/ && $2 ~ /^0x/ {
+    account($3, hex($2));
+    pending = "";
+}
+
+END {
+    printf "%-28s %10s %10s\n", "module", "flash", "ram";
+    fflush();
+    sort = "sort -k3,3nr -k2,2nr";
+    for (module in modules) {
+        if (flash[module] || ram[module]) {
+            printf "%-28s %10d %10d\n", module, flash[module],
+                   ram[module] | sort;
+        }
+    }
+    close(sort);
+    printf "%-28s %10d %10d\n", "total", flash_total, ram_total;
+
+    if ("_Ram_Budget" in symbols) {
+        used = symbols["_ebss"] - symbols["_sdata"];
+        printf "\n.data and .bss %d of %d budget (%d%%)\n", used,
+               symbols["_Ram_Budget"], used * 100 / symbols["_Ram_Budget"];
+    }
+    if ("_Min_Stack_Size" in symbols) {
+        printf "stack budget %d, heap %d\n", symbols["_Min_Stack_Size"],
+               symbols["_Min_Heap_Size"];
+    }
+}
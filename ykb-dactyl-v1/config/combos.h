@@ -0,0 +1,21 @@
+#ifndef CONFIG_COMBOS_H
+#define CONFIG_COMBOS_H
+
+#include "keys.h"
+
+// Combos:
+//
+// Keys are indices in the scan order (see `mappings` in src/keyboard.c), the
+// primary half reaches the keys of the other one with KB_REMOTE_KEY. Pressing
+// all keys of a combo within KB_COMBO_TERM emits its action instead.
+//
+// Example: Escape on the Q and W keys of the left half, on the right one,
+// entry of KB_COMBOS:
+//
+// KB_COMBO2(KEY_ESCAPE, KB_REMOTE_KEY(27), KB_REMOTE_KEY(22)),
+
+#ifndef KB_COMBOS
+#define KB_COMBOS
+#endif // KB_COMBOS
+
+#endif // CONFIG_COMBOS_H
@@ -0,0 +1,22 @@
+#ifndef CONFIG_GAMEPAD_AXES_H
+#define CONFIG_GAMEPAD_AXES_H
+
+// Gamepad axes:
+//
+// Keys are indices in the scan order (see `mappings` in src/keyboard.c),
+// KB_KEY_COUNT for an unused direction. Only keys of the half itself, the
+// calibration of the other one's keys stays there. The axis is the travel of
+// the positive key minus the travel of the negative one. Keys keep their
+// mappings, set them to KEY_NOKEY to only use them as an axis.
+//
+// Example: right stick on the I, J, K and L keys of the right half, entries
+// of KB_GAMEPAD_AXES:
+//
+// KB_GAMEPAD_AXIS(GAMEPAD_AXIS_RX, 13, 23),
+// KB_GAMEPAD_AXIS(GAMEPAD_AXIS_RY, 17, 18),
+
+#ifndef KB_GAMEPAD_AXES
+#define KB_GAMEPAD_AXES
+#endif // KB_GAMEPAD_AXES
+
+#endif // CONFIG_GAMEPAD_AXES_H
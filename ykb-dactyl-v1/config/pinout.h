@@ -14,6 +14,10 @@
 #define PIN_DEBUG_UART_RX PB10
 #define PIN_DEBUG_UART_TX PA2
 
+// USART1, crossed over between the halves
+#define PIN_SPLIT_UART_TX PA9
+#define PIN_SPLIT_UART_RX PA10
+
 // Mux pins, only used in src/keyboard.c
 #define PIN_MUX1_CMN PC0
 #define PIN_MUX1_A PB7
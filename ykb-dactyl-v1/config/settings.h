@@ -33,6 +33,21 @@
 
 #define USB_ENABLED 1
 
+// Reset if the scan loop stalls or keeps running over budget (see watchdog.h)
+#ifndef WATCHDOG_ENABLED
+#define WATCHDOG_ENABLED 1
+#endif // WATCHDOG_ENABLED
+
+// Wired link to the other half, RIGHT is the primary one (see split_link.h)
+#ifndef SPLIT_LINK_ENABLED
+#define SPLIT_LINK_ENABLED 1
+#endif // SPLIT_LINK_ENABLED
+
+// The primary half maps the keys of the other one itself, after its own
+#if defined(RIGHT) && SPLIT_LINK_ENABLED == 1
+#define KB_REMOTE_KEY_COUNT KB_KEY_COUNT
+#endif // RIGHT && SPLIT_LINK_ENABLED
+
 #ifndef DEBUG_UART_ENABLED
 #define DEBUG_UART_ENABLED 1
 #endif // DEBUG_UART_ENABLED
@@ -0,0 +1,20 @@
+#ifndef CONFIG_SOCD_GROUPS_H
+#define CONFIG_SOCD_GROUPS_H
+
+// SOCD groups:
+//
+// Keys are indices in the scan order (see `mappings` in src/keyboard.c), the
+// primary half reaches the keys of the other one with KB_REMOTE_KEY. At most
+// one key of a group is pressed at a time, see `socd_policy`. The travel of
+// remote keys is only known with SPLIT_LINK_ANALOG_ENABLED.
+//
+// Example: snap tap on the A and D keys of the left half, on the right one (W
+// and S are 22 and 23), entry of KB_SOCD_GROUPS:
+//
+// KB_SOCD2(SOCD_POLICY_LAST_INPUT_WINS, KB_REMOTE_KEY(28), KB_REMOTE_KEY(18)),
+
+#ifndef KB_SOCD_GROUPS
+#define KB_SOCD_GROUPS
+#endif // KB_SOCD_GROUPS
+
+#endif // CONFIG_SOCD_GROUPS_H
@@ -1,12 +1,19 @@
 #include "keyboard.h"
 
+#include "combo.h"
+#include "combos.h"
 #include "error_handler.h"
+#include "gamepad.h"
+#include "gamepad_axes.h"
 #include "logging.h"
 #include "mappings.h"
 #include "memory_map.h"
 #include "mux.h"
 #include "pinout.h"
 #include "settings.h"
+#include "socd.h"
+#include "socd_groups.h"
+#include "split_link.h"
 
 #include <stdint.h>
 #include <string.h>
@@ -16,45 +23,49 @@
 
 extern kb_state_t kb_state;
 
-__ALIGN_BEGIN static uint8_t mappings[KB_KEY_COUNT] __ALIGN_END = {
-
-#ifdef LEFT
-
-    // MUX1:
-
-    KEY70, KEY71, KEY72, KEY61, KEY54, KEY50, KEY51, KEY52, KEY53, KEY_NOKEY,
-    KEY60,
-
-    // MUX2:
-
-    KEY40, KEY41, KEY42, KEY43, KEY44, KEY30, KEY31, KEY32, KEY33, KEY34, KEY20,
-    KEY21, KEY22, KEY23, KEY24,
-
-    // MUX3:
+// Keys of the LEFT half, in its scan order
+#define LEFT_MAPPINGS                                                          \
+    /* MUX1: */                                                                \
+    KEY70, KEY71, KEY72, KEY61, KEY54, KEY50, KEY51, KEY52, KEY53, KEY_NOKEY,  \
+    KEY60,                                                                     \
+    /* MUX2: */                                                                \
+    KEY40, KEY41, KEY42, KEY43, KEY44, KEY30, KEY31, KEY32, KEY33, KEY34,      \
+    KEY20, KEY21, KEY22, KEY23, KEY24,                                         \
+    /* MUX3: */                                                                \
+    KEY10, KEY11, KEY12, KEY13, KEY14, KEY00, KEY01, KEY02, KEY03
+
+// Keys of the RIGHT half, in its scan order
+#define RIGHT_MAPPINGS                                                         \
+    /* MUX1: */                                                                \
+    KEY80, KEY81, KEY82, KEY91, KEY104, KEY100, KEY101, KEY102, KEY103,        \
+    KEY_NOKEY, KEY90,                                                          \
+    /* MUX2: */                                                                \
+    KEY110, KEY111, KEY112, KEY113, KEY114, KEY120, KEY121, KEY122, KEY123,    \
+    KEY124, KEY130, KEY131, KEY132, KEY133, KEY134,                            \
+    /* MUX3: */                                                                \
+    KEY140, KEY141, KEY142, KEY143, KEY144, KEY150, KEY151, KEY152, KEY153
 
-    KEY10, KEY11, KEY12, KEY13, KEY14, KEY00, KEY01, KEY02, KEY03,
+// Local keys, then the remote ones of the primary half (KB_REMOTE_KEY)
+__ALIGN_BEGIN static uint16_t mappings[KB_TOTAL_KEY_COUNT] __ALIGN_END = {
 
+#ifdef LEFT
+    LEFT_MAPPINGS,
 #endif // LEFT
 
 #ifdef RIGHT
+    RIGHT_MAPPINGS,
+#if KB_REMOTE_KEY_COUNT > 0
+    LEFT_MAPPINGS,
+#endif // KB_REMOTE_KEY_COUNT
+#endif // RIGHT
 
-    // MUX1:
-
-    KEY80, KEY81, KEY82, KEY91, KEY104, KEY100, KEY101, KEY102, KEY103,
-    KEY_NOKEY, KEY90,
-
-    // MUX2:
-
-    KEY110, KEY111, KEY112, KEY113, KEY114, KEY120, KEY121, KEY122, KEY123,
-    KEY124, KEY130, KEY131, KEY132, KEY133, KEY134,
-
-    // MUX3:
+};
 
-    KEY140, KEY141, KEY142, KEY143, KEY144, KEY150, KEY151, KEY152, KEY153
+static const kb_combo_t combos[] = {KB_COMBOS};
 
-#endif // RIGHT
+static const kb_socd_group_t socd_groups[] = {KB_SOCD_GROUPS};
 
-};
+static const kb_gamepad_axis_t gamepad_axes[] = {KB_GAMEPAD_AXES};
 
 //
 // MUXes
@@ -79,19 +90,19 @@ static gpio_pin_t mux_3_ctrls[4] = {
 };
 
 static mux_t muxes[3] = {
-    (mux_t){
+    {
         .ctrls = mux_1_ctrls,             //
         .common = PIN_MUX1_CMN,           //
         .ctrls_amount = 4,                //
         .channel_amount = MUX1_KEY_COUNT, //
     },                                    //
-    (mux_t){
+    {
         .ctrls = mux_2_ctrls,             //
         .common = PIN_MUX2_CMN,           //
         .channel_amount = MUX2_KEY_COUNT, //
         .ctrls_amount = 4                 //
     },                                    //
-    (mux_t){
+    {
         .ctrls = mux_3_ctrls,             //
         .common = PIN_MUX3_CMN,           //
         .channel_amount = MUX3_KEY_COUNT, //
@@ -215,6 +226,11 @@ hal_err kb_init() {
 
     kb_super_init();
 
+    combo_init(combos, sizeof(combos) / sizeof(kb_combo_t));
+    socd_init(socd_groups, sizeof(socd_groups) / sizeof(kb_socd_group_t));
+    gamepad_init(gamepad_axes,
+                 sizeof(gamepad_axes) / sizeof(kb_gamepad_axis_t));
+
     hal_err err;
 
     LOG_TRACE("Initializing MUXes...");
@@ -225,6 +241,16 @@ hal_err kb_init() {
     }
     LOG_TRACE("MUXes init OK.");
 
+#if defined(SPLIT_LINK_ENABLED) && SPLIT_LINK_ENABLED == 1
+    LOG_TRACE("Initializing split link...");
+    err = split_link_init(KB_REMOTE_KEY_COUNT > 0U);
+    if (err) {
+        LOG_ERROR("Unable to init split link. Error %d", err);
+        return err;
+    }
+    LOG_TRACE("Split link init OK.");
+#endif // SPLIT_LINK_ENABLED
+
     if (!kb_load_state_from_eeprom()) {
         LOG_DEBUG("Failed to load state from EEPROM. Loading defaults...");
         kb_init_default();
@@ -233,6 +259,8 @@ hal_err kb_init() {
 
     memset(kb_state.current_values, 0, sizeof(kb_state.current_values));
 
+    kb_init_profiles();
+
     LOG_INFO("Setup complete.");
 
     return OK;
@@ -249,6 +277,7 @@ bool previously_pressed_keys[KB_KEY_COUNT] = {false};
 void kb_poll_normal() {
 
     uint8_t index = 0;
+    kb_key_mask_t pressed = 0U;
 
     for (uint8_t i = 0; i < 3; i++) {
 
@@ -260,16 +289,15 @@ void kb_poll_normal() {
         for (uint8_t j = 0; j < mux->channel_amount; j++) {
             if (kb_key_pressed_by_threshold(index, mux, j,
                                             &kb_state.current_values[index])) {
-                uint8_t key = kb_state.mappings[index];
 #ifdef DEBUG
                 if (!previously_pressed_keys[index]) {
                     LOG_DEBUG(
                         "Key with index %d (HID code %d) pressed. MUX%d, CH%d",
-                        index, key, i + 1, j);
+                        index, kb_state.keymap[index], i + 1, j);
                     previously_pressed_keys[index] = true;
                 }
 #endif // DEBUG
-                kb_process_key(key);
+                pressed |= KB_KEY_BIT(index);
             }
 #ifdef DEBUG
             else {
@@ -279,12 +307,14 @@ void kb_poll_normal() {
             index++;
         }
     }
+
+    kb_update_keys(pressed);
 }
 
 void kb_poll_race() {
     uint8_t index = 0;
     uint16_t highest_value = 0;
-    uint8_t pressed_key = KEY_NOKEY;
+    uint8_t pressed_index = KB_KEY_COUNT;
 
     for (uint8_t i = 0; i < 3; i++) {
         mux_t *mux = &muxes[i];
@@ -295,19 +325,18 @@ void kb_poll_race() {
         for (uint8_t j = 0; j < mux->channel_amount; j++) {
             if (kb_key_pressed_by_threshold(index, mux, j,
                                             &kb_state.current_values[index])) {
-                uint8_t key = kb_state.mappings[index];
 #ifdef DEBUG
                 if (!previously_pressed_keys[index]) {
                     LOG_DEBUG(
                         "Key with index %d (HID code %d) pressed. MUX%d, CH%d",
-                        key, i + 1, j);
+                        index, kb_state.keymap[index], i + 1, j);
                     previously_pressed_keys[index] = true;
                 }
 #endif // DEBUG
                 uint16_t value = kb_state.current_values[index];
                 if (highest_value < value) {
                     highest_value = value;
-                    pressed_key = key;
+                    pressed_index = index;
                 }
             }
 #ifdef DEBUG
@@ -315,9 +344,11 @@ void kb_poll_race() {
                 previously_pressed_keys[index] = false;
             }
 #endif // DEBUG
+            index++;
         }
     }
-    if (pressed_key != KEY_NOKEY) {
-        kb_process_key(pressed_key);
-    }
+
+    // Only the key pressed the most stays pressed
+    kb_update_keys(pressed_index < KB_KEY_COUNT ? KB_KEY_BIT(pressed_index)
+                                                : 0U);
 }